@@ -0,0 +1,13 @@
+#include "micro_bench.hpp"
+
+// Evaluation::evaluate, the whole static evaluation of a position
+int main(int argc, char* argv[]) {
+    ChessBoard board(12, 0);
+    MoveGen moveGen(board);
+    Evaluation evaluator(board, moveGen);
+    return runMicroBench("evaluate", microBenchIterations(argc, argv, 20000),
+                         [&](const MicroBenchPosition& position) {
+                             board = position.board;
+                             return static_cast<uint64_t>(std::llround(evaluator.evaluate(position.whiteToMove) * 100));
+                         });
+}
@@ -0,0 +1,43 @@
+#include "micro_bench.hpp"
+#include "../src/engine/epd_reader.hpp"
+
+// parseFen + writeFen round trips of the bench positions, or with a file
+// argument ("bench_fen suite.epd") how fast EpdReader streams and parses it
+int main(int argc, char* argv[]) {
+    if (argc > 1 && !std::isdigit(static_cast<unsigned char>(argv[1][0]))) {
+        auto start = std::chrono::steady_clock::now();
+        EpdReader reader(argv[1]);
+        if (!reader.isOpen()) {
+            std::cerr << "Cannot open " << argv[1] << std::endl;
+            return 1;
+        }
+        ChessBoard board(12, 0);
+        FenState state;
+        std::string_view operations;
+        uint64_t positions = 0, checksum = 0;
+        while (reader.nextPosition(board, state, operations)) {
+            positions++;
+            checksum += board[WK] ^ board[BK];
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "EpdReader: " << positions << " positions (" << reader.invalidLines() << " invalid) in "
+                  << static_cast<uint64_t>(seconds * 1000) << " ms, "
+                  << static_cast<uint64_t>(reader.size() / std::max(seconds, 1e-9) / 1e6) << " MB/s, "
+                  << static_cast<uint64_t>(positions / std::max(seconds, 1e-9)) << " positions/s"
+                  << " (checksum " << checksum << ")" << std::endl;
+        return 0;
+    }
+
+    std::vector<std::string> fens = benchPositions();
+    ChessBoard board(12, 0);
+    FenState state;
+    char buffer[MAX_FEN_LENGTH];
+    size_t next = 0;
+    return runMicroBench("parseFen + writeFen", microBenchIterations(argc, argv, 100000),
+                         [&](const MicroBenchPosition&) {
+                             const std::string& fen = fens[next];
+                             next = (next + 1) % fens.size();
+                             parseFen(fen, board, state);
+                             return writeFen(board, state, buffer);
+                         });
+}
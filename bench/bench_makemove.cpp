@@ -0,0 +1,32 @@
+#include "micro_bench.hpp"
+
+// MinimaxSearch::makeMove + unmakeMove of every move in the position, the
+// move list is generated outside the timed part
+int main(int argc, char* argv[]) {
+    ChessBoard board(12, 0);
+    MoveGen moveGen(board);
+    Evaluation evaluator(board, moveGen);
+    MinimaxSearch search(board, moveGen, evaluator);
+
+    std::vector<MicroBenchPosition> positions = microBenchPositions();
+    std::vector<std::vector<Move>> moves;
+    for (const MicroBenchPosition& position : positions) {
+        board = position.board;
+        moves.push_back(moveGen.GenerateMoves(position.whiteToMove));
+    }
+
+    size_t next = 0;
+    return runMicroBench("makeMove/unmakeMove of all moves", microBenchIterations(argc, argv, 200000),
+                         [&](const MicroBenchPosition& position) {
+                             const std::vector<Move>& list = moves[next];
+                             next = (next + 1) % moves.size();
+                             board = position.board;
+                             uint64_t occupied = 0;
+                             for (const Move& move : list) {
+                                 int captured = search.makeMove(move, position.whiteToMove);
+                                 occupied += board[position.whiteToMove ? WK : BK];
+                                 search.unmakeMove(move, position.whiteToMove, captured);
+                             }
+                             return occupied;
+                         });
+}
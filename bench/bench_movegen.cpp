@@ -0,0 +1,12 @@
+#include "micro_bench.hpp"
+
+// MoveGen::GenerateMoves for the side to move
+int main(int argc, char* argv[]) {
+    ChessBoard board(12, 0);
+    MoveGen moveGen(board);
+    return runMicroBench("GenerateMoves", microBenchIterations(argc, argv, 100000),
+                         [&](const MicroBenchPosition& position) {
+                             board = position.board;
+                             return moveGen.GenerateMoves(position.whiteToMove).size();
+                         });
+}
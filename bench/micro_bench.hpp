@@ -0,0 +1,53 @@
+#pragma once
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../src/engine/bench.hpp"
+
+// Shared bits of the micro-benchmarks: each one times a single engine
+// function over the bench positions (src/engine/bench.hpp) and prints
+// calls/second. The checksum is printed so the compiler cannot drop the
+// work, and should not change between runs.
+
+struct MicroBenchPosition {
+    ChessBoard board;
+    bool whiteToMove;
+};
+
+inline std::vector<MicroBenchPosition> microBenchPositions() {
+    std::vector<MicroBenchPosition> positions;
+    for (const std::string& fen : benchPositions()) {
+        ChessBoard board(12, 0);
+        setPositionFromFEN(board, fen);
+        positions.push_back({board, isWhiteturnFen(fen)});
+    }
+    return positions;
+}
+
+// "bench_x [iterations]", the default keeps a run around a second
+inline uint64_t microBenchIterations(int argc, char* argv[], uint64_t fallback) {
+    return argc > 1 ? std::strtoull(argv[1], nullptr, 10) : fallback;
+}
+
+// Runs body(position) iterations times over every position and reports
+template <typename Body>
+int runMicroBench(const char* name, uint64_t iterations, Body body) {
+    std::vector<MicroBenchPosition> positions = microBenchPositions();
+    uint64_t checksum = 0, calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        for (MicroBenchPosition& position : positions) {
+            checksum += body(position);
+            calls++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << calls << " calls in " << static_cast<uint64_t>(seconds * 1000)
+              << " ms, " << static_cast<uint64_t>(calls / std::max(seconds, 1e-9)) << " calls/s, "
+              << static_cast<uint64_t>(seconds * 1e9 / std::max<uint64_t>(calls, 1)) << " ns/call"
+              << " (checksum " << checksum << ", cpu " << Cpu::name(Cpu::path()) << ")" << std::endl;
+    return 0;
+}
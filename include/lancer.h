@@ -0,0 +1,117 @@
+#ifndef LANCER_H
+#define LANCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * C API of liblancer, to embed the engine in another program instead of
+ * running "Lancer-bot" and parsing its output. Plain C so any language
+ * with a C FFI can call it; nothing in here throws.
+ *
+ * An engine is one search with its own board and hash table. Calls on one
+ * engine must not overlap, except lancer_stop. Use one engine per thread.
+ *
+ * Scores are in pawns from white's point of view, like the engine's own
+ * evaluation: +1.5 is a pawn and a half up for white, whoever is to move.
+ * A forced mate found by a search scores +/-LANCER_MATE_SCORE, with the
+ * number of moves in lancer_search_result.mate.
+ *
+ * Additions keep the layout of the structs below and bump
+ * LANCER_API_VERSION. A removal or a layout change would be a new major
+ * version of the library.
+ */
+
+#define LANCER_API_VERSION 1
+
+/* Score of a forced mate, white mates at +LANCER_MATE_SCORE */
+#define LANCER_MATE_SCORE 100.0
+
+/* The only symbols the library exports, it is built with everything else
+ * hidden. LANCER_SHARED is defined for users of the shared library. */
+#if defined(_WIN32) && defined(LANCER_SHARED)
+#if defined(LANCER_BUILD)
+#define LANCER_API __declspec(dllexport)
+#else
+#define LANCER_API __declspec(dllimport)
+#endif
+#elif defined(_WIN32)
+#define LANCER_API
+#else
+#define LANCER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lancer_engine lancer_engine;
+
+typedef enum lancer_status {
+    LANCER_OK = 0,
+    LANCER_BAD_ARGUMENT = 1, /* null pointer */
+    LANCER_BAD_FEN = 2,
+    LANCER_NO_MOVES = 3,     /* nothing to search, the game is over */
+    LANCER_ERROR = 4         /* anything else, see lancer_last_error */
+} lancer_status;
+
+/* All zero searches to depth 5. Otherwise the search stops at whichever
+ * limit it reaches first. */
+typedef struct lancer_limits {
+    int32_t depth;       /* plies, 0 = no limit */
+    uint64_t nodes;      /* 0 = no limit */
+    int64_t movetime_ms; /* 0 = no limit */
+} lancer_limits;
+
+typedef struct lancer_search_result {
+    char bestmove[8];    /* "e2e4", NUL terminated */
+    char pondermove[8];  /* expected reply, "" when there is none */
+    double score;        /* pawns, white's point of view, +/-LANCER_MATE_SCORE for a mate */
+    int32_t mate;        /* moves to mate, > 0 white mates, < 0 black mates, 0 none */
+    int32_t depth;       /* of the last completed iteration */
+    uint64_t nodes;
+    int64_t time_ms;
+} lancer_search_result;
+
+/* LANCER_API_VERSION of the library actually loaded */
+LANCER_API int lancer_api_version(void);
+
+/* hash_mb = 0 takes the default of 16 MB. Returns NULL when out of memory.
+ * The position starts as the initial position. */
+LANCER_API lancer_engine* lancer_create(size_t hash_mb);
+LANCER_API void lancer_destroy(lancer_engine* engine);
+
+/* Forgets what earlier searches stored in the hash table */
+LANCER_API void lancer_clear_hash(lancer_engine* engine);
+
+/* Position for lancer_search and lancer_evaluate. On an error the engine
+ * keeps its previous position. */
+LANCER_API lancer_status lancer_set_position(lancer_engine* engine, const char* fen);
+
+/* limits may be NULL (depth 5) */
+LANCER_API lancer_status lancer_search(lancer_engine* engine, const lancer_limits* limits,
+                                       lancer_search_result* result);
+
+/* Ends a running lancer_search early, it still returns its best move so far.
+ * The only call that may come from another thread. */
+LANCER_API void lancer_stop(lancer_engine* engine);
+
+/* Static evaluation of the position, no search */
+LANCER_API lancer_status lancer_evaluate(lancer_engine* engine, double* score);
+
+/* Scores count positions into scores[0..count). With limits NULL each one
+ * gets the static evaluation, otherwise a search with those limits, where a
+ * forced mate scores +/-LANCER_MATE_SCORE. A FEN
+ * that does not parse, or a position without moves, gets NaN. Returns how
+ * many were scored. The engine's position is left as it was. */
+LANCER_API size_t lancer_evaluate_batch(lancer_engine* engine, const char* const* fens, size_t count,
+                                        const lancer_limits* limits, double* scores);
+
+/* Message of the last call on this engine that failed, "" if none did */
+LANCER_API const char* lancer_last_error(const lancer_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LANCER_H */
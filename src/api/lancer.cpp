@@ -0,0 +1,234 @@
+#include "lancer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include "../engine/board.hpp"
+#include "../engine/movegen.hpp"
+#include "../engine/referee.hpp"
+#include "../engine/search.hpp"
+#include "../eval/evaluation.hpp"
+
+// The C API in include/lancer.h. Every entry point catches whatever the
+// engine throws and turns it into a status, exceptions must not cross into C.
+
+struct lancer_engine {
+    ChessBoard board{ChessBoard(12, 0)};  // the search's working board
+    MoveGen moveGen{board};
+    Evaluation evaluator{board, moveGen};
+    MinimaxSearch search{board, moveGen, evaluator};
+
+    ChessBoard position{ChessBoard(12, 0)};  // set by lancer_set_position
+    bool whiteToMove{true};
+    std::string error;
+
+    lancer_status fail(lancer_status status, std::string message) {
+        error = std::move(message);
+        return status;
+    }
+};
+
+namespace {
+
+constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+constexpr int DEFAULT_DEPTH = 5;
+
+SearchLimits toSearchLimits(const lancer_limits* limits) {
+    SearchLimits searchLimits;
+    if (limits) {
+        searchLimits.depth = limits->depth;
+        searchLimits.nodes = limits->nodes;
+        searchLimits.movetime = limits->movetime_ms;
+    }
+    if (searchLimits.depth <= 0 && searchLimits.nodes == 0 && searchLimits.movetime <= 0) {
+        searchLimits.depth = DEFAULT_DEPTH;
+    }
+    searchLimits.moveOverhead = 0;  // no GUI in between
+    return searchLimits;
+}
+
+void copyMove(char (&out)[8], const Move& move) {
+    // memcpy rather than strncpy / snprintf, both warn about truncation
+    std::string text = moveToString(move);
+    size_t length = std::min(text.size(), sizeof(out) - 1);
+    std::memcpy(out, text.data(), length);
+    out[length] = '\0';
+}
+
+// Search scores in pawns, a mate as LANCER_MATE_SCORE
+double toPawns(double score) {
+    if (std::abs(score) >= MinimaxSearch::MATE_BOUND) {
+        return score > 0 ? LANCER_MATE_SCORE : -LANCER_MATE_SCORE;
+    }
+    return score;
+}
+
+}  // namespace
+
+extern "C" {
+
+int lancer_api_version(void) {
+    return LANCER_API_VERSION;
+}
+
+lancer_engine* lancer_create(size_t hash_mb) {
+    try {
+        auto* engine = new lancer_engine();
+        engine->search.setHashSize(hash_mb ? hash_mb : 16);
+        setPositionFromFEN(engine->position, START_FEN);
+        return engine;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void lancer_destroy(lancer_engine* engine) {
+    delete engine;
+}
+
+void lancer_clear_hash(lancer_engine* engine) {
+    if (engine) {
+        engine->search.clearHash();
+    }
+}
+
+lancer_status lancer_set_position(lancer_engine* engine, const char* fen) {
+    if (!engine || !fen) {
+        return engine ? engine->fail(LANCER_BAD_ARGUMENT, "fen is null") : LANCER_BAD_ARGUMENT;
+    }
+    try {
+        ChessBoard board(12, 0);
+        FenState state;
+        const char* error = nullptr;
+        if (!parseFen(fen, board, state, &error)) {
+            return engine->fail(LANCER_BAD_FEN, std::string("bad fen: ") + (error ? error : "?"));
+        }
+        engine->position = std::move(board);
+        engine->whiteToMove = state.whiteToMove;
+        engine->error.clear();
+        return LANCER_OK;
+    } catch (...) {
+        engine->error = "out of memory";
+        return LANCER_ERROR;
+    }
+}
+
+lancer_status lancer_search(lancer_engine* engine, const lancer_limits* limits, lancer_search_result* result) {
+    if (!engine || !result) {
+        return engine ? engine->fail(LANCER_BAD_ARGUMENT, "result is null") : LANCER_BAD_ARGUMENT;
+    }
+    try {
+        engine->board = engine->position;
+        if (engine->moveGen.GenerateMoves(engine->whiteToMove).empty()) {
+            return engine->fail(LANCER_NO_MOVES, "no moves in this position");
+        }
+        Move best = engine->search.search(engine->whiteToMove, toSearchLimits(limits));
+
+        *result = lancer_search_result{};
+        copyMove(result->bestmove, best);
+        const std::vector<Move>& pv = engine->search.principalVariation();
+        if (pv.size() > 1 && pv[0] == best) {
+            ChessBoard next = engine->board;
+            Referee::play(next, best, engine->whiteToMove);
+            if (Referee::isLegal(next, pv[1], !engine->whiteToMove)) {
+                copyMove(result->pondermove, pv[1]);
+            }
+        }
+        const std::vector<SearchInfo>& lines = engine->search.multiPVLines();
+        if (!lines.empty()) {
+            result->score = toPawns(lines[0].score);
+            result->depth = lines[0].depth;
+            result->time_ms = lines[0].timeMs;
+            if (std::abs(lines[0].score) >= MinimaxSearch::MATE_BOUND) {
+                int plies = static_cast<int>(MinimaxSearch::MATE_SCORE - std::abs(lines[0].score));
+                int moves = std::max(1, (plies - 1) / 2);  // as formatScore counts them
+                result->mate = lines[0].score > 0 ? moves : -moves;
+            }
+        }
+        result->nodes = engine->search.nodeCount();
+        engine->error.clear();
+        return LANCER_OK;
+    } catch (const std::exception& e) {
+        return engine->fail(LANCER_ERROR, e.what());
+    } catch (...) {
+        return engine->fail(LANCER_ERROR, "unknown error");
+    }
+}
+
+void lancer_stop(lancer_engine* engine) {
+    if (engine) {
+        engine->search.stop();
+    }
+}
+
+lancer_status lancer_evaluate(lancer_engine* engine, double* score) {
+    if (!engine || !score) {
+        return engine ? engine->fail(LANCER_BAD_ARGUMENT, "score is null") : LANCER_BAD_ARGUMENT;
+    }
+    try {
+        engine->board = engine->position;
+        *score = engine->evaluator.evaluate(true);
+        engine->error.clear();
+        return LANCER_OK;
+    } catch (const std::exception& e) {
+        return engine->fail(LANCER_ERROR, e.what());
+    } catch (...) {
+        return engine->fail(LANCER_ERROR, "unknown error");
+    }
+}
+
+size_t lancer_evaluate_batch(lancer_engine* engine, const char* const* fens, size_t count,
+                             const lancer_limits* limits, double* scores) {
+    if (!engine || (count > 0 && (!fens || !scores))) {
+        if (engine) engine->fail(LANCER_BAD_ARGUMENT, "fens or scores is null");
+        return 0;
+    }
+    size_t scored = 0;
+    try {
+        SearchLimits searchLimits = toSearchLimits(limits);
+        FenState state;
+        engine->error.clear();
+        for (size_t i = 0; i < count; i++) {
+            scores[i] = std::numeric_limits<double>::quiet_NaN();
+        }
+        for (size_t i = 0; i < count; i++) {
+            const char* error = nullptr;
+            if (!fens[i] || !parseFen(fens[i], engine->board, state, &error)) {
+                engine->error = "position " + std::to_string(i) + ": bad fen: " + (error ? error : "null");
+                continue;
+            }
+            if (!limits) {
+                scores[i] = engine->evaluator.evaluate(true);
+                scored++;
+                continue;
+            }
+            try {
+                if (engine->moveGen.GenerateMoves(state.whiteToMove).empty()) {
+                    engine->error = "position " + std::to_string(i) + ": no moves";
+                    continue;
+                }
+                engine->search.search(state.whiteToMove, searchLimits);
+                const std::vector<SearchInfo>& lines = engine->search.multiPVLines();
+                scores[i] = lines.empty() ? engine->evaluator.evaluate(true) : toPawns(lines[0].score);
+                scored++;
+            } catch (const std::exception& e) {
+                engine->error = "position " + std::to_string(i) + ": " + e.what();
+            }
+        }
+    } catch (...) {
+        // Out of memory building a message, the rest stays NaN. Short
+        // enough not to allocate.
+        engine->error = "out of memory";
+    }
+    return scored;
+}
+
+const char* lancer_last_error(const lancer_engine* engine) {
+    return engine ? engine->error.c_str() : "engine is null";
+}
+
+}  // extern "C"
@@ -3,6 +3,8 @@ DROP TABLE IF EXISTS fen_italian;
 DROP TABLE IF EXISTS fen_queen_gambit;
 DROP TABLE IF EXISTS fen_ruy_lopez;
 DROP TABLE IF EXISTS chess_openings;
+DROP TABLE IF EXISTS book_moves;
+DROP TABLE IF EXISTS book_positions;
 -- Recreate tables with IF NOT EXISTS
 
 CREATE TABLE IF NOT EXISTS fen_italian (
@@ -29,6 +31,29 @@ CREATE TABLE IF NOT EXISTS fen_ruy_lopez (
     fen_notation TEXT
 );
 
+-- Opening book, one row per position. position_key is the engine's 64 bit
+-- Zobrist hash (side to move included) stored as a signed integer. As the
+-- INTEGER PRIMARY KEY it is the rowid, so finding a position is one b-tree
+-- lookup. Filled from the tables above by "Lancer-bot makebook".
+CREATE TABLE IF NOT EXISTS book_positions (
+    position_key INTEGER PRIMARY KEY,
+    fen TEXT NOT NULL,
+    white_wins INTEGER NOT NULL DEFAULT 0,
+    draws INTEGER NOT NULL DEFAULT 0,
+    black_wins INTEGER NOT NULL DEFAULT 0
+);
+
+-- Candidate moves of each book position, move = from * 64 + to
+CREATE TABLE IF NOT EXISTS book_moves (
+    position_key INTEGER NOT NULL,
+    move INTEGER NOT NULL,
+    weight INTEGER NOT NULL DEFAULT 1,
+    white_wins INTEGER NOT NULL DEFAULT 0,
+    draws INTEGER NOT NULL DEFAULT 0,
+    black_wins INTEGER NOT NULL DEFAULT 0,
+    PRIMARY KEY (position_key, move)
+) WITHOUT ROWID;
+
 -- Insert data with conflict resolution
 
 INSERT OR REPLACE INTO chess_openings(opening_id, row, fen_notation) VALUES
@@ -77,6 +102,10 @@ CREATE INDEX IF NOT EXISTS idx_queen_gambit_row ON fen_queen_gambit(row);
 CREATE INDEX IF NOT EXISTS idx_ruy_lopez_row ON fen_ruy_lopez(row);
 CREATE INDEX IF NOT EXISTS idx_CH_row ON chess_openings(row);
 
+-- Covering index for the book probe: the moves of a key, heaviest first,
+-- answered from the index alone
+CREATE INDEX IF NOT EXISTS idx_book_moves_probe ON book_moves(position_key, weight DESC, move);
+
 
 -- Verify the data
 SELECT 'Italian Game' as opening, COUNT(*) as row_count FROM fen_italian
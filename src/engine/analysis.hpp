@@ -0,0 +1,228 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "bitbase.hpp"
+#include "board.hpp"
+#include "epd_reader.hpp"
+#include "movegen.hpp"
+#include "search.hpp"
+#include "../eval/evaluation.hpp"
+
+// Scores a file of positions (FEN or EPD, one per line) with a pool of
+// independent single-threaded searchers. Every worker has its own board, TT
+// and search, so nothing is shared on the search path and throughput grows
+// with the number of cores.
+//
+// Lines are dealt round-robin into one queue per worker while the file is
+// read, as views into the mapped file; the workers parse them. A worker takes from the back of its own queue and, once that is empty,
+// steals from the front of the others, so a queue full of slow positions does
+// not leave the other workers idle at the end.
+class BatchAnalyzer {
+public:
+    struct Options {
+        SearchLimits limits;
+        unsigned threads{1};
+        size_t hashMegabytes{16};  // per worker
+        std::string hashFile;      // persistent hash table shared by the workers, see TranspositionTable
+        bool stats{false};         // search statistics on every result line
+    };
+
+    struct Summary {
+        uint64_t positions{0};
+        uint64_t skipped{0};     // lines that are not a position
+        uint64_t nodes{0};
+        double seconds{0.0};
+        SearchStats stats;       // of all searches
+    };
+
+private:
+    struct Job {
+        uint64_t line;
+        std::string_view text;  // into the EpdReader's mapping
+    };
+
+    // Owner pushes and pops at the back, thieves take the front
+    class WorkQueue {
+    private:
+        std::deque<Job> m_jobs;
+        std::mutex m_mutex;
+
+    public:
+        void push(Job job) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+
+        std::optional<Job> pop() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_jobs.empty()) return std::nullopt;
+            Job job = std::move(m_jobs.back());
+            m_jobs.pop_back();
+            return job;
+        }
+
+        std::optional<Job> steal() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_jobs.empty()) return std::nullopt;
+            Job job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            return job;
+        }
+    };
+
+    // Everything one search needs, built once per worker
+    struct Searcher {
+        ChessBoard board;
+        MoveGen moveGen;
+        Evaluation evaluator;
+        MinimaxSearch search;
+
+        Searcher(size_t hashMegabytes, const std::string& hashFile, const Bitbases* bitbases,
+                 const char** hashFileError)
+            : board(12, 0), moveGen(board), evaluator(board, moveGen), search(board, moveGen, evaluator) {
+            search.setHashSize(hashMegabytes);
+            if (!hashFile.empty()) {
+                search.setHashFile(hashFile, hashFileError);
+            }
+            search.setBitbases(bitbases);
+        }
+    };
+
+    Options m_options;
+    const Bitbases* m_bitbases;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::atomic<size_t> m_pending{0};
+    std::atomic<bool> m_inputDone{false};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::mutex m_outputMutex;
+    std::atomic<uint64_t> m_nodes{0};
+    std::atomic<uint64_t> m_skipped{0};
+    std::atomic<bool> m_hashFileWarned{false};
+    SearchStats m_stats;  // workers add theirs when they are done
+
+    std::optional<Job> nextJob(unsigned worker) {
+        while (true) {
+            if (auto job = m_queues[worker]->pop()) {
+                return job;
+            }
+            for (unsigned i = 1; i < m_queues.size(); i++) {
+                if (auto job = m_queues[(worker + i) % m_queues.size()]->steal()) {
+                    return job;
+                }
+            }
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            if (m_inputDone && m_pending == 0) {
+                return std::nullopt;
+            }
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+
+    void work(unsigned worker, std::ostream& out) {
+        const char* hashFileError = nullptr;
+        Searcher searcher(m_options.hashMegabytes, m_options.hashFile, m_bitbases, &hashFileError);
+        if (hashFileError && !m_hashFileWarned.exchange(true)) {
+            std::lock_guard<std::mutex> lock(m_outputMutex);
+            std::cerr << "Hash file " << m_options.hashFile << " not used, " << hashFileError << ", using memory\n";
+        }
+        SearchStats stats;
+        while (auto job = nextJob(worker)) {
+            FenState state;
+            std::string_view operations;
+            if (!parseEpd(job->text, searcher.board, state, operations)) {
+                m_skipped++;
+                m_pending--;
+                continue;
+            }
+            bool whiteToMove = state.whiteToMove;
+            searcher.search.clearHash();
+
+            std::ostringstream result;
+            result << job->line << ": " << boardToFen(searcher.board, state);
+            try {
+                Move best = searcher.search.search(whiteToMove, m_options.limits);
+                const std::vector<SearchInfo>& lines = searcher.search.multiPVLines();
+                double score = lines.empty() ? 0.0 : lines[0].score;
+                result << " | bestmove " << moveToString(best)
+                       << " | score " << formatScore(score, whiteToMove)
+                       << " | nodes " << searcher.search.nodeCount()
+                       << " | pv";
+                for (const Move& move : searcher.search.principalVariation()) {
+                    result << " " << moveToString(move);
+                }
+                if (m_options.stats) {
+                    result << " | stats " << searcher.search.statistics().toJson();
+                }
+                stats += searcher.search.statistics();
+            } catch (const std::exception& e) {
+                result << " | error " << e.what();
+            }
+            m_nodes += searcher.search.nodeCount();
+            m_pending--;
+
+            std::lock_guard<std::mutex> lock(m_outputMutex);
+            out << result.str() << "\n" << std::flush;
+        }
+
+        std::lock_guard<std::mutex> lock(m_outputMutex);
+        m_stats += stats;
+    }
+
+public:
+    BatchAnalyzer(const Options& options, const Bitbases* bitbases = nullptr)
+        : m_options(options), m_bitbases(bitbases) {
+        m_options.threads = std::max(1u, m_options.threads);
+        for (unsigned i = 0; i < m_options.threads; i++) {
+            m_queues.push_back(std::make_unique<WorkQueue>());
+        }
+    }
+
+    // Reads positions from the file until the end and writes a line per
+    // position to out as soon as it is searched, so results come in
+    // completion order
+    Summary run(EpdReader& reader, std::ostream& out) {
+        auto start = std::chrono::steady_clock::now();
+        Summary summary;
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < m_options.threads; i++) {
+            workers.emplace_back([this, i, &out] { work(i, out); });
+        }
+
+        std::string_view line;
+        uint64_t lines = 0;
+        while (reader.next(line)) {
+            m_pending++;
+            m_queues[lines++ % m_queues.size()]->push({reader.lineNumber(), line});
+            m_wake.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_inputDone = true;
+        }
+        m_wake.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        summary.skipped = m_skipped;
+        summary.positions = lines - summary.skipped;
+        summary.nodes = m_nodes;
+        summary.stats = m_stats;
+        summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return summary;
+    }
+};
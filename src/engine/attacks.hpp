@@ -0,0 +1,214 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include "../utils/cpu.hpp"
+
+// Attack and geometry tables, generated at compile time and shared by every
+// MoveGen, the evaluation and the bitbase generator. Squares are rank * 8 +
+// file like everywhere else, colour 0 is white.
+namespace Attacks {
+
+using Table = std::array<uint64_t, 64>;
+
+enum Direction { NORTH, SOUTH, EAST, WEST, NORTH_EAST, NORTH_WEST, SOUTH_EAST, SOUTH_WEST };
+
+constexpr int FILE_STEP[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+constexpr int RANK_STEP[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+
+// Square one (fileStep, rankStep) jump away, or -1 off the board
+constexpr int offset(int square, int fileStep, int rankStep) {
+    int file = square % 8 + fileStep, rank = square / 8 + rankStep;
+    return file >= 0 && file < 8 && rank >= 0 && rank < 8 ? rank * 8 + file : -1;
+}
+
+constexpr uint64_t jumps(int square, const int (&steps)[8][2]) {
+    uint64_t mask = 0;
+    for (const auto& step : steps) {
+        int to = offset(square, step[0], step[1]);
+        if (to >= 0) mask |= 1ULL << to;
+    }
+    return mask;
+}
+
+constexpr int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int KING_STEPS[8][2] = {{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}};
+
+constexpr uint64_t pawnJumps(int square, int rankStep) {
+    uint64_t mask = 0;
+    for (int fileStep : {-1, 1}) {
+        int to = offset(square, fileStep, rankStep);
+        if (to >= 0) mask |= 1ULL << to;
+    }
+    return mask;
+}
+
+// Squares from `square` in one direction to the edge, the square itself not included
+constexpr uint64_t walk(int square, int direction) {
+    uint64_t mask = 0;
+    for (int to = offset(square, FILE_STEP[direction], RANK_STEP[direction]); to >= 0;
+         to = offset(to, FILE_STEP[direction], RANK_STEP[direction])) {
+        mask |= 1ULL << to;
+    }
+    return mask;
+}
+
+template <typename Fill>
+constexpr Table makeTable(Fill fill) {
+    Table table{};
+    for (int square = 0; square < 64; square++) {
+        table[square] = fill(square);
+    }
+    return table;
+}
+
+inline constexpr Table KNIGHT = makeTable([](int sq) { return jumps(sq, KNIGHT_STEPS); });
+inline constexpr Table KING = makeTable([](int sq) { return jumps(sq, KING_STEPS); });
+
+// PAWN[colour][square]: squares a pawn of that colour on square captures on.
+// The other colour's entry is the squares it is protected from.
+inline constexpr std::array<Table, 2> PAWN = {
+    makeTable([](int sq) { return pawnJumps(sq, 1); }),
+    makeTable([](int sq) { return pawnJumps(sq, -1); }),
+};
+
+// RAY[direction][square]: empty board ray to the edge
+inline constexpr std::array<Table, 8> RAY = [] {
+    std::array<Table, 8> rays{};
+    for (int direction = 0; direction < 8; direction++) {
+        rays[direction] = makeTable([direction](int sq) { return walk(sq, direction); });
+    }
+    return rays;
+}();
+
+// Whole rank / file / diagonal / anti-diagonal through a square, the square included
+inline constexpr Table RANK_MASK = makeTable([](int sq) { return RAY[EAST][sq] | RAY[WEST][sq] | 1ULL << sq; });
+inline constexpr Table FILE_MASK = makeTable([](int sq) { return RAY[NORTH][sq] | RAY[SOUTH][sq] | 1ULL << sq; });
+inline constexpr Table DIAGONAL_MASK =
+    makeTable([](int sq) { return RAY[NORTH_EAST][sq] | RAY[SOUTH_WEST][sq] | 1ULL << sq; });
+inline constexpr Table ANTI_DIAGONAL_MASK =
+    makeTable([](int sq) { return RAY[NORTH_WEST][sq] | RAY[SOUTH_EAST][sq] | 1ULL << sq; });
+
+// BETWEEN[a][b]: squares strictly between two squares on a common line, and
+// LINE[a][b]: the whole line through both. Empty when they don't line up.
+inline constexpr std::array<Table, 64> BETWEEN = [] {
+    std::array<Table, 64> between{};
+    for (int a = 0; a < 64; a++) {
+        for (int direction = 0; direction < 8; direction++) {
+            for (int b = offset(a, FILE_STEP[direction], RANK_STEP[direction]); b >= 0;
+                 b = offset(b, FILE_STEP[direction], RANK_STEP[direction])) {
+                between[a][b] = RAY[direction][a] & ~RAY[direction][b] & ~(1ULL << b);
+            }
+        }
+    }
+    return between;
+}();
+
+inline constexpr std::array<Table, 64> LINE = [] {
+    std::array<Table, 64> line{};
+    for (int a = 0; a < 64; a++) {
+        for (int b = 0; b < 64; b++) {
+            uint64_t bit = 1ULL << b;
+            if (a == b) continue;
+            if (RANK_MASK[a] & bit) line[a][b] = RANK_MASK[a];
+            if (FILE_MASK[a] & bit) line[a][b] = FILE_MASK[a];
+            if (DIAGONAL_MASK[a] & bit) line[a][b] = DIAGONAL_MASK[a];
+            if (ANTI_DIAGONAL_MASK[a] & bit) line[a][b] = ANTI_DIAGONAL_MASK[a];
+        }
+    }
+    return line;
+}();
+
+static_assert(KNIGHT[0] == 0x20400ULL && KING[0] == 0x302ULL && PAWN[1][8] == 0x2ULL);
+static_assert(BETWEEN[0][63] == 0x0040201008040200ULL && LINE[1][8] == LINE[8][1]);
+
+inline uint64_t knight(int square) { return KNIGHT[square]; }
+inline uint64_t king(int square) { return KING[square]; }
+inline uint64_t pawn(bool white, int square) { return PAWN[white ? 0 : 1][square]; }
+
+// Squares a slider on `square` reaches along one full line (RANK_MASK[square] and
+// friends), up to and including the first blocker each way. Upwards the
+// nearest blocker is the lowest bit, downwards the highest.
+inline uint64_t slide(int square, uint64_t line, uint64_t occupied) {
+    uint64_t up = line & ~((2ULL << square) - 1);
+    uint64_t down = line & ((1ULL << square) - 1);
+
+    uint64_t blockers = up & occupied;
+    if (blockers) {
+        up &= (2ULL << std::countr_zero(blockers)) - 1;
+    }
+    blockers = down & occupied;
+    if (blockers) {
+        down &= ~((1ULL << (63 - std::countl_zero(blockers))) - 1);
+    }
+    return up | down;
+}
+
+// PEXT indexed slider attacks, for Cpu::hasPext(). The blockers that matter
+// for a square are on its lines minus the edge squares; PEXT packs them
+// into an index, so each of their occupancies has its own entry.
+struct PextSquare {
+    uint64_t mask;
+    uint32_t offset;
+};
+
+struct PextTable {
+    PextSquare rook[64];
+    PextSquare bishop[64];
+    std::vector<uint64_t> attacks;  // 107648 entries, about 840 KB
+};
+
+// Only built when the tables will be used
+inline const PextTable PEXT = [] {
+    PextTable table{};
+    if (!Cpu::hasPext()) return table;
+
+    constexpr uint64_t RANK_EDGES = 0xFF000000000000FFULL, FILE_EDGES = 0x8181818181818181ULL;
+    auto fill = [&table](PextSquare& entry, uint64_t mask, uint64_t (*attacks)(int, uint64_t), int square) {
+        entry.mask = mask;
+        entry.offset = static_cast<uint32_t>(table.attacks.size());
+        for (uint64_t index = 0; index < 1ULL << std::popcount(mask); index++) {
+            table.attacks.push_back(attacks(square, Cpu::depositGeneric(index, mask)));
+        }
+    };
+    for (int square = 0; square < 64; square++) {
+        uint64_t self = 1ULL << square;
+        fill(table.rook[square],
+             ((RANK_MASK[square] & ~FILE_EDGES) | (FILE_MASK[square] & ~RANK_EDGES)) & ~self,
+             [](int sq, uint64_t occ) {
+                 return slide(sq, RANK_MASK[sq], occ) | slide(sq, FILE_MASK[sq], occ);
+             },
+             square);
+        fill(table.bishop[square],
+             (DIAGONAL_MASK[square] | ANTI_DIAGONAL_MASK[square]) & ~(RANK_EDGES | FILE_EDGES | self),
+             [](int sq, uint64_t occ) {
+                 return slide(sq, DIAGONAL_MASK[sq], occ) | slide(sq, ANTI_DIAGONAL_MASK[sq], occ);
+             },
+             square);
+    }
+    return table;
+}();
+
+inline uint64_t rook(int square, uint64_t occupied) {
+    if (Cpu::hasPext()) {
+        const PextSquare& entry = PEXT.rook[square];
+        return PEXT.attacks[entry.offset + Cpu::pext(occupied, entry.mask)];
+    }
+    return slide(square, RANK_MASK[square], occupied) | slide(square, FILE_MASK[square], occupied);
+}
+
+inline uint64_t bishop(int square, uint64_t occupied) {
+    if (Cpu::hasPext()) {
+        const PextSquare& entry = PEXT.bishop[square];
+        return PEXT.attacks[entry.offset + Cpu::pext(occupied, entry.mask)];
+    }
+    return slide(square, DIAGONAL_MASK[square], occupied) | slide(square, ANTI_DIAGONAL_MASK[square], occupied);
+}
+
+inline uint64_t queen(int square, uint64_t occupied) {
+    return rook(square, occupied) | bishop(square, occupied);
+}
+
+}  // namespace Attacks
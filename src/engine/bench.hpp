@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "movegen.hpp"
+#include "search.hpp"
+#include "../eval/evaluation.hpp"
+
+// Fixed depth searches over a fixed set of positions. Book, bitbases and
+// tablebases stay off and the TT is cleared before every position, so the
+// total node count only depends on the search and evaluation code: it is the
+// signature to compare before and after a change that should not alter the
+// search. Time and nps are for speed comparisons on the same machine.
+
+// The positions main.cpp shows, plus a few more game phases
+inline const std::vector<std::string>& benchPositions() {
+    static const std::vector<std::string> positions = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r1bq1k1r/p3bppp/1pn1pn2/2p5/2B1NB2/3P1N2/PPP2PPP/R2QR1K1 w - - 0 11",
+        "r1bqkbnr/pppp1ppp/2n5/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+        "rnbqkb1r/pp3ppp/2p1pn2/3p4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 0 5",
+        "r1bqk2r/ppp2ppp/3p1n2/n1b1p3/N1B1P3/3P1N2/PPP2PPP/R1BQK2R w KQkq - 2 7",
+        "rnbqkb1r/p4p2/2p1pn1p/1p4p1/P1pPP3/2N2NB1/1P3PPP/R2QKB1R b KQkq - 0 9",
+        "8/1k3p2/pp4p1/3Pp3/6P1/PK6/7P/8 w - - 0 2",
+        "3k4/8/4PK2/8/8/8/8/8 w - - 1 5",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "2r3k1/pp3ppp/4p3/3p4/3P4/P3PN2/1P3PPP/2R3K1 b - - 0 24",
+        "8/8/1p1r1k2/p1pPN1p1/P3KnP1/1P6/8/3R4 b - - 0 40",
+        "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1",
+    };
+    return positions;
+}
+
+struct BenchResult {
+    uint64_t nodes{0};
+    double seconds{0.0};
+    SearchStats stats;  // all positions added up
+
+    uint64_t nps() const {
+        return static_cast<uint64_t>(nodes / std::max(seconds, 1e-9));
+    }
+};
+
+// Searches every bench position to depth, printing a line per position
+inline BenchResult runBench(int depth, std::ostream& out) {
+    ChessBoard board(12, 0);
+    MoveGen moveGen(board);
+    Evaluation evaluator(board, moveGen);
+    MinimaxSearch search(board, moveGen, evaluator);
+    SearchLimits limits;
+    limits.depth = depth;
+
+    BenchResult result;
+    const std::vector<std::string>& positions = benchPositions();
+    for (size_t i = 0; i < positions.size(); i++) {
+        setPositionFromFEN(board, positions[i]);
+        bool whiteToMove = isWhiteturnFen(positions[i]);
+        search.clearHash();
+
+        auto start = std::chrono::steady_clock::now();
+        Move best = search.search(whiteToMove, limits);
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.nodes += search.nodeCount();
+        result.stats += search.statistics();
+
+        out << "Position " << i + 1 << "/" << positions.size() << ": " << positions[i]
+            << "\n  bestmove " << moveToString(best) << " nodes " << search.nodeCount() << "\n";
+    }
+    return result;
+}
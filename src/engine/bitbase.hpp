@@ -0,0 +1,218 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include "board.hpp"
+#include "movegen.hpp"
+#include "../utils/mapped_file.hpp"
+
+// Win / draw / loss bitbases for endgames with up to four pieces, as written
+// by BitbaseGenerator (bitbase_gen.hpp). A table holds every placement of its
+// pieces for both sides to move, 2 bits per position:
+//   index = side * 64^n + sq[0] * 64^(n-1) + ... + sq[n-1]
+// with the pieces ordered white king, black king, then the other white pieces
+// and the other black pieces, strongest first. Files are named after the
+// material, e.g. "KRKP.lbb", and positions with the colours the other way
+// round are probed mirrored.
+
+enum class Wdl : uint8_t {
+    Draw = 0,
+    Win = 1,      // for the side to move
+    Loss = 2,
+    Illegal = 3,  // overlapping pieces, side not to move in check, ...
+};
+
+inline Wdl flipWdl(Wdl wdl) {
+    if (wdl == Wdl::Win) return Wdl::Loss;
+    if (wdl == Wdl::Loss) return Wdl::Win;
+    return wdl;
+}
+
+// Pieces of one table in index order
+struct BitbaseLayout {
+    static constexpr int MAX_PIECES = 4;
+
+    int count{0};
+    int pieces[MAX_PIECES]{};
+
+    // "KRKP" -> WK, BK, WR, BP. Returns false for names we cannot index.
+    bool parse(const std::string& name) {
+        size_t second = name.find('K', 1);
+        if (name.empty() || name[0] != 'K' || second == std::string::npos ||
+            name.size() > MAX_PIECES) {
+            return false;
+        }
+        count = 0;
+        pieces[count++] = WK;
+        pieces[count++] = BK;
+        for (size_t i = 1; i < name.size(); i++) {
+            if (i == second) continue;
+            const char* letter = std::strchr("PNBRQ", name[i]);
+            if (!letter || !*letter) {
+                return false;
+            }
+            int type = static_cast<int>(letter - "PNBRQ");
+            pieces[count++] = (i < second ? WP : BP) + type;
+        }
+        return true;
+    }
+
+    std::string name() const {
+        std::string white = "K", black = "K";
+        for (int i = 2; i < count; i++) {
+            (pieces[i] < BP ? white : black) += "PNBRQ"[pieces[i] % 6];
+        }
+        return white + black;
+    }
+
+    uint64_t positions() const {
+        return 2ULL << (6 * count);
+    }
+};
+
+// Identifies a material combination: 2 bits of count per piece type
+inline uint32_t bitbaseMaterialKey(const int* pieces, int count) {
+    uint32_t key = 0;
+    for (int i = 0; i < count; i++) {
+        key += 1u << (2 * pieces[i]);
+    }
+    return key;
+}
+
+class Bitbases {
+private:
+    static constexpr size_t HEADER_SIZE = 8;  // "LBB1", piece count, padding
+
+    struct Table {
+        BitbaseLayout layout;
+        const uint8_t* data;
+    };
+
+    std::unordered_map<std::string, MappedFile> m_files;
+    std::unordered_map<uint32_t, Table> m_tables;
+    int m_maxPieces{0};
+
+    static Wdl readValue(const uint8_t* data, uint64_t index) {
+        return static_cast<Wdl>((data[index >> 2] >> ((index & 3) * 2)) & 3);
+    }
+
+    // Looks the pieces up in a table laid out exactly like them, in colour
+    // order (no mirroring)
+    Wdl probeDirect(const Table& table, const int* pieces, const int* squares, int count,
+                    bool whiteToMove) const {
+        // Put the squares in the table's piece order. Equal pieces can go in
+        // any order, every permutation is in the table.
+        int ordered[BitbaseLayout::MAX_PIECES];
+        bool used[BitbaseLayout::MAX_PIECES]{};
+        for (int slot = 0; slot < count; slot++) {
+            for (int i = 0; i < count; i++) {
+                if (!used[i] && pieces[i] == table.layout.pieces[slot]) {
+                    used[i] = true;
+                    ordered[slot] = squares[i];
+                    break;
+                }
+            }
+        }
+        uint64_t index = whiteToMove ? 0 : 1;
+        for (int slot = 0; slot < count; slot++) {
+            index = (index << 6) | static_cast<uint64_t>(ordered[slot]);
+        }
+        return readValue(table.data, index);
+    }
+
+public:
+    static constexpr const char* EXTENSION = ".lbb";
+    static constexpr char MAGIC[4] = {'L', 'B', 'B', '1'};
+
+    Bitbases() = default;
+
+    explicit Bitbases(const std::string& directory) {
+        load(directory);
+    }
+
+    // Maps every bitbase file in the directory, returns how many tables are
+    // loaded. A missing directory just leaves the tables empty.
+    int load(const std::string& directory) {
+        std::error_code error;
+        for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+            if (file.path().extension() == EXTENSION) {
+                loadFile(file.path().string());
+            }
+        }
+        return static_cast<int>(m_tables.size());
+    }
+
+    bool loadFile(const std::string& path) {
+        std::string name = std::filesystem::path(path).stem().string();
+        BitbaseLayout layout;
+        if (!layout.parse(name) || m_files.count(name)) {
+            return false;
+        }
+        MappedFile file(path);
+        if (!file.isOpen() || file.size() != HEADER_SIZE + layout.positions() / 4 ||
+            std::memcmp(file.data(), MAGIC, 4) != 0 || file.data()[4] != layout.count) {
+            return false;
+        }
+        m_tables[bitbaseMaterialKey(layout.pieces, layout.count)] = {layout, file.data() + HEADER_SIZE};
+        m_files.emplace(name, std::move(file));
+        m_maxPieces = std::max(m_maxPieces, layout.count);
+        return true;
+    }
+
+    void clear() {
+        m_tables.clear();
+        m_files.clear();
+        m_maxPieces = 0;
+    }
+
+    bool has(const std::string& name) const { return m_files.count(name) > 0; }
+    size_t tableCount() const { return m_tables.size(); }
+    int maxPieces() const { return m_maxPieces; }
+
+    // Probes a position given as a piece list. Returns Wdl::Illegal when no
+    // table covers the material. Bare kings are a draw without a table.
+    Wdl probe(const int* pieces, const int* squares, int count, bool whiteToMove) const {
+        if (count == 2) {
+            return Wdl::Draw;
+        }
+        if (count > m_maxPieces) {
+            return Wdl::Illegal;
+        }
+        auto it = m_tables.find(bitbaseMaterialKey(pieces, count));
+        if (it != m_tables.end()) {
+            return probeDirect(it->second, pieces, squares, count, whiteToMove);
+        }
+
+        // Same material with the colours swapped: mirror the board top to
+        // bottom and probe from the other side
+        int flippedPieces[BitbaseLayout::MAX_PIECES], flippedSquares[BitbaseLayout::MAX_PIECES];
+        for (int i = 0; i < count; i++) {
+            flippedPieces[i] = pieces[i] < BP ? pieces[i] + 6 : pieces[i] - 6;
+            flippedSquares[i] = squares[i] ^ 56;
+        }
+        it = m_tables.find(bitbaseMaterialKey(flippedPieces, count));
+        if (it != m_tables.end()) {
+            return probeDirect(it->second, flippedPieces, flippedSquares, count, !whiteToMove);
+        }
+        return Wdl::Illegal;
+    }
+
+    Wdl probe(const ChessBoard& board, bool whiteToMove) const {
+        int pieces[BitbaseLayout::MAX_PIECES], squares[BitbaseLayout::MAX_PIECES];
+        int count = 0;
+        for (int piece = 0; piece < 12; piece++) {
+            uint64_t bitboard = board[piece];
+            while (bitboard) {
+                if (count == BitbaseLayout::MAX_PIECES) {
+                    return Wdl::Illegal;
+                }
+                pieces[count] = piece;
+                squares[count++] = getLSB(bitboard);
+                bitboard &= bitboard - 1;
+            }
+        }
+        return probe(pieces, squares, count, whiteToMove);
+    }
+};
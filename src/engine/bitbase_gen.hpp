@@ -0,0 +1,450 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "attacks.hpp"
+#include "bitbase.hpp"
+
+// Builds the bitbases of bitbase.hpp by retrograde analysis:
+//
+// 1. Every position is classified by looking at its moves once. Mates and
+//    stalemates are final, moves that leave the table (captures, promotions)
+//    are looked up in the smaller tables, which are generated first. A
+//    position keeps a count of the moves not yet known to lose.
+// 2. Results are then pushed backwards: the predecessors of a lost position
+//    are won, and a predecessor loses once every one of its moves leads to a
+//    won position (its count reaches zero).
+// 3. Whatever is still open after that is a draw.
+//
+// Both passes split the positions between threads. Counts and results are
+// atomics, so two threads reaching the same predecessor need no locks.
+class BitbaseGenerator {
+private:
+    enum State : uint8_t { Unknown = 0, Win, Loss, Draw, Illegal };
+
+    static constexpr uint64_t CHUNK = 1 << 16;
+
+    BitbaseLayout m_layout;
+    Bitbases& m_lookup;
+    unsigned m_threads;
+    uint64_t m_perSide{0};
+
+    std::vector<std::atomic<uint8_t>> m_state;
+    std::vector<std::atomic<uint8_t>> m_remaining;
+
+    static uint64_t attacks(int piece, int square, uint64_t occupied) {
+        switch (piece % 6) {
+            case WP: return Attacks::pawn(piece < BP, square);
+            case WN: return Attacks::knight(square);
+            case WB: return Attacks::bishop(square, occupied);
+            case WR: return Attacks::rook(square, occupied);
+            case WQ: return Attacks::queen(square, occupied);
+            default: return Attacks::king(square);
+        }
+    }
+
+    // One position of the table being generated
+    struct Position {
+        int count;
+        int pieces[BitbaseLayout::MAX_PIECES];
+        int squares[BitbaseLayout::MAX_PIECES];
+        bool whiteToMove;
+
+        uint64_t occupied() const {
+            uint64_t bits = 0;
+            for (int i = 0; i < count; i++) bits |= 1ULL << squares[i];
+            return bits;
+        }
+
+        bool white(int i) const { return pieces[i] < BP; }
+
+        // Is the king of the given colour attacked? skip = a captured piece
+        bool kingAttacked(bool whiteKing, int skip = -1) const {
+            int king = squares[whiteKing ? 0 : 1];
+            uint64_t occ = occupied();
+            if (skip >= 0) occ &= ~(1ULL << squares[skip]);
+            for (int i = 0; i < count; i++) {
+                if (i != skip && white(i) != whiteKing && (attacks(pieces[i], squares[i], occ) & (1ULL << king))) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    Position decode(uint64_t index) const {
+        Position position;
+        position.count = m_layout.count;
+        position.whiteToMove = index < m_perSide;
+        for (int i = m_layout.count - 1; i >= 0; i--) {
+            position.pieces[i] = m_layout.pieces[i];
+            position.squares[i] = static_cast<int>(index & 63);
+            index >>= 6;
+        }
+        return position;
+    }
+
+    uint64_t encode(const Position& position) const {
+        uint64_t index = position.whiteToMove ? 0 : 1;
+        for (int i = 0; i < position.count; i++) {
+            index = (index << 6) | static_cast<uint64_t>(position.squares[i]);
+        }
+        return index;
+    }
+
+    static bool isLegal(const Position& position) {
+        uint64_t seen = 0;
+        for (int i = 0; i < position.count; i++) {
+            uint64_t bit = 1ULL << position.squares[i];
+            if (seen & bit) return false;
+            if (position.pieces[i] % 6 == WP && (bit & 0xFF000000000000FFULL)) return false;
+            seen |= bit;
+        }
+        // The side that just moved cannot be in check
+        return !position.kingAttacked(!position.whiteToMove);
+    }
+
+    // Result for the side to move after a move that leaves this table: the
+    // piece `captured` is gone and / or the piece `mover` became `promoted`
+    Wdl probeAfter(const Position& position, int mover, int captured, int promoted) const {
+        int pieces[BitbaseLayout::MAX_PIECES], squares[BitbaseLayout::MAX_PIECES];
+        int count = 0;
+        for (int i = 0; i < position.count; i++) {
+            if (i == captured) continue;
+            pieces[count] = i == mover && promoted >= 0 ? promoted : position.pieces[i];
+            squares[count++] = position.squares[i];
+        }
+        Wdl wdl = m_lookup.probe(pieces, squares, count, !position.whiteToMove);
+        if (wdl == Wdl::Illegal) {
+            throw std::runtime_error("Missing bitbase for a capture or promotion from " + m_layout.name());
+        }
+        return wdl;
+    }
+
+    // Calls visit(next position or nullptr, wdl of a position outside this
+    // table) for every legal move of the side to move
+    template <typename Visit>
+    void forEachMove(const Position& position, Visit&& visit) const {
+        uint64_t occ = position.occupied();
+        bool white = position.whiteToMove;
+        for (int i = 0; i < position.count; i++) {
+            if (position.white(i) != white) continue;
+            int piece = position.pieces[i];
+            int from = position.squares[i];
+
+            uint64_t own = 0, enemy = 0;
+            for (int j = 0; j < position.count; j++) {
+                (position.white(j) == white ? own : enemy) |= 1ULL << position.squares[j];
+            }
+
+            uint64_t targets;
+            if (piece % 6 == WP) {
+                int push = white ? 8 : -8;
+                targets = Attacks::pawn(white, from) & enemy;
+                if (!(occ & (1ULL << (from + push)))) {
+                    targets |= 1ULL << (from + push);
+                    int startRank = white ? 1 : 6;
+                    if (from / 8 == startRank && !(occ & (1ULL << (from + 2 * push)))) {
+                        targets |= 1ULL << (from + 2 * push);
+                    }
+                }
+            } else {
+                targets = attacks(piece, from, occ) & ~own;
+            }
+
+            while (targets) {
+                int to = getLSB(targets);
+                targets &= targets - 1;
+
+                int captured = -1;
+                for (int j = 0; j < position.count; j++) {
+                    if (position.squares[j] == to) captured = j;
+                }
+                Position next = position;
+                next.squares[i] = to;
+                if (next.kingAttacked(white, captured)) {
+                    continue;
+                }
+
+                bool promotes = piece % 6 == WP && (to / 8 == 0 || to / 8 == 7);
+                if (promotes) {
+                    for (int promoted = WN; promoted <= WQ; promoted++) {
+                        visit(nullptr, probeAfter(next, i, captured, promoted + (white ? 0 : 6)));
+                    }
+                } else if (captured >= 0) {
+                    visit(nullptr, probeAfter(next, i, captured, -1));
+                } else {
+                    next.whiteToMove = !white;
+                    visit(&next, Wdl::Draw);
+                }
+            }
+        }
+    }
+
+    // Positions the side that just moved could have come from without a
+    // capture or promotion
+    template <typename Visit>
+    void forEachPredecessor(const Position& position, Visit&& visit) const {
+        uint64_t occ = position.occupied();
+        bool mover = !position.whiteToMove;
+        for (int i = 0; i < position.count; i++) {
+            if (position.white(i) != mover) continue;
+            int piece = position.pieces[i];
+            int to = position.squares[i];
+
+            uint64_t origins;
+            if (piece % 6 == WP) {
+                int push = mover ? 8 : -8;
+                int from = to - push;
+                origins = 0;
+                if (from >= 8 && from < 56 && !(occ & (1ULL << from))) {
+                    origins |= 1ULL << from;
+                    int doubleRank = mover ? 3 : 4;
+                    if (to / 8 == doubleRank && !(occ & (1ULL << (from - push)))) {
+                        origins |= 1ULL << (from - push);
+                    }
+                }
+            } else {
+                origins = attacks(piece, to, occ) & ~occ;
+            }
+
+            while (origins) {
+                Position previous = position;
+                previous.squares[i] = getLSB(origins);
+                previous.whiteToMove = mover;
+                origins &= origins - 1;
+                visit(previous);
+            }
+        }
+    }
+
+    // Runs work(begin, end) over [0, total) in chunks taken by every thread
+    template <typename Work>
+    void parallelFor(uint64_t total, Work&& work) const {
+        std::atomic<uint64_t> next{0};
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < m_threads; t++) {
+            workers.emplace_back([&] {
+                for (uint64_t begin = next.fetch_add(CHUNK); begin < total; begin = next.fetch_add(CHUNK)) {
+                    work(begin, std::min(total, begin + CHUNK));
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    bool resolve(uint64_t index, State state) {
+        uint8_t expected = Unknown;
+        return m_state[index].compare_exchange_strong(expected, state);
+    }
+
+    std::vector<uint64_t> classify() {
+        std::vector<std::vector<uint64_t>> found(1);
+        std::mutex foundMutex;
+
+        parallelFor(m_layout.positions(), [&](uint64_t begin, uint64_t end) {
+            std::vector<uint64_t> local;
+            for (uint64_t index = begin; index < end; index++) {
+                Position position = decode(index);
+                if (!isLegal(position)) {
+                    m_state[index] = Illegal;
+                    continue;
+                }
+                int legalMoves = 0, open = 0;
+                bool wins = false;
+                forEachMove(position, [&](const Position* next, Wdl wdl) {
+                    legalMoves++;
+                    if (next) {
+                        open++;
+                    } else if (wdl == Wdl::Loss) {
+                        wins = true;
+                    } else if (wdl == Wdl::Draw) {
+                        open++;  // never counted down, the position cannot lose
+                    }
+                });
+
+                State state = Unknown;
+                if (legalMoves == 0) {
+                    state = position.kingAttacked(position.whiteToMove) ? Loss : Draw;
+                } else if (wins) {
+                    state = Win;
+                } else if (open == 0) {
+                    state = Loss;
+                }
+                m_state[index] = state;
+                m_remaining[index] = static_cast<uint8_t>(open);
+                if (state == Win || state == Loss) {
+                    local.push_back(index);
+                }
+            }
+            std::lock_guard<std::mutex> lock(foundMutex);
+            found.push_back(std::move(local));
+        });
+
+        std::vector<uint64_t> frontier;
+        for (auto& list : found) {
+            frontier.insert(frontier.end(), list.begin(), list.end());
+        }
+        return frontier;
+    }
+
+    // One round of backward propagation, returns the newly decided positions
+    std::vector<uint64_t> propagate(const std::vector<uint64_t>& frontier) {
+        std::vector<std::vector<uint64_t>> found;
+        std::mutex foundMutex;
+
+        parallelFor(frontier.size(), [&](uint64_t begin, uint64_t end) {
+            std::vector<uint64_t> local;
+            for (uint64_t k = begin; k < end; k++) {
+                Position position = decode(frontier[k]);
+                bool lost = m_state[frontier[k]] == Loss;
+                forEachPredecessor(position, [&](const Position& previous) {
+                    uint64_t index = encode(previous);
+                    if (m_state[index] != Unknown) {
+                        return;
+                    }
+                    if (lost) {
+                        if (resolve(index, Win)) local.push_back(index);
+                    } else if (m_remaining[index].fetch_sub(1) == 1) {
+                        if (resolve(index, Loss)) local.push_back(index);
+                    }
+                });
+            }
+            std::lock_guard<std::mutex> lock(foundMutex);
+            found.push_back(std::move(local));
+        });
+
+        std::vector<uint64_t> next;
+        for (auto& list : found) {
+            next.insert(next.end(), list.begin(), list.end());
+        }
+        return next;
+    }
+
+    void write(const std::string& path) const {
+        std::vector<uint8_t> packed(m_layout.positions() / 4, 0);
+        for (uint64_t index = 0; index < m_layout.positions(); index++) {
+            uint8_t state = m_state[index];
+            Wdl wdl = state == Win ? Wdl::Win : state == Loss ? Wdl::Loss
+                    : state == Illegal ? Wdl::Illegal : Wdl::Draw;
+            packed[index >> 2] |= static_cast<uint8_t>(static_cast<uint8_t>(wdl) << ((index & 3) * 2));
+        }
+
+        std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        char header[8] = {Bitbases::MAGIC[0], Bitbases::MAGIC[1], Bitbases::MAGIC[2], Bitbases::MAGIC[3],
+                          static_cast<char>(m_layout.count), 0, 0, 0};
+        out.write(header, sizeof(header));
+        out.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(packed.size()));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Cannot write " + temporary);
+        }
+        std::filesystem::rename(temporary, path);
+    }
+
+    BitbaseGenerator(const BitbaseLayout& layout, Bitbases& lookup, unsigned threads)
+        : m_layout(layout), m_lookup(lookup), m_threads(std::max(1u, threads)),
+          m_perSide(layout.positions() / 2),
+          m_state(layout.positions()), m_remaining(layout.positions()) {}
+
+    // Tables reached by a capture or a promotion, in canonical colours
+    static std::vector<std::string> dependencies(const BitbaseLayout& layout) {
+        std::vector<std::string> names;
+        for (int i = 2; i < layout.count; i++) {
+            BitbaseLayout smaller;
+            smaller.count = 0;
+            for (int j = 0; j < layout.count; j++) {
+                if (j != i) smaller.pieces[smaller.count++] = layout.pieces[j];
+            }
+            if (smaller.count > 2) names.push_back(canonicalName(smaller));
+
+            if (layout.pieces[i] % 6 == WP) {
+                for (int promoted = WN; promoted <= WQ; promoted++) {
+                    BitbaseLayout promotedLayout = layout;
+                    promotedLayout.pieces[i] = promoted + (layout.pieces[i] < BP ? 0 : 6);
+                    names.push_back(canonicalName(promotedLayout));
+                }
+            }
+        }
+        return names;
+    }
+
+public:
+    // The stronger side is white in the stored tables: more pieces, then the
+    // stronger pieces ("KRKP" rather than "KPKR")
+    static std::string canonicalName(BitbaseLayout layout) {
+        std::string white = "K", black = "K";
+        for (int i = 2; i < layout.count; i++) {
+            (layout.pieces[i] < BP ? white : black) += "PNBRQ"[layout.pieces[i] % 6];
+        }
+        auto strength = [](std::string side) {
+            std::sort(side.begin() + 1, side.end(), [](char a, char b) {
+                return std::strchr("PNBRQ", a) > std::strchr("PNBRQ", b);
+            });
+            return side;
+        };
+        white = strength(white);
+        black = strength(black);
+        auto rank = [](const std::string& side) {
+            std::string key;
+            for (char c : side.substr(1)) key += static_cast<char>('0' + (std::strchr("PNBRQ", c) - "PNBRQ"));
+            return key;
+        };
+        bool swap = black.size() > white.size() || (black.size() == white.size() && rank(black) > rank(white));
+        return swap ? black + white : white + black;
+    }
+
+    // Generates the named table and everything it depends on into the
+    // directory, skipping tables that already exist. Returns how many tables
+    // were written.
+    static int generate(const std::string& name, const std::string& directory, unsigned threads,
+                        Bitbases& lookup) {
+        BitbaseLayout layout;
+        if (!layout.parse(name) || layout.count < 3) {
+            throw std::runtime_error("Cannot generate a bitbase for " + name);
+        }
+        std::string canonical = canonicalName(layout);
+        if (canonical != name) {
+            return generate(canonical, directory, threads, lookup);
+        }
+        if (lookup.has(name)) {
+            return 0;
+        }
+
+        int written = 0;
+        for (const std::string& dependency : dependencies(layout)) {
+            written += generate(dependency, directory, threads, lookup);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        BitbaseGenerator generator(layout, lookup, threads);
+        std::vector<uint64_t> frontier = generator.classify();
+        int rounds = 0;
+        while (!frontier.empty()) {
+            frontier = generator.propagate(frontier);
+            rounds++;
+        }
+
+        std::filesystem::create_directories(directory);
+        std::string path = (std::filesystem::path(directory) / (name + Bitbases::EXTENSION)).string();
+        generator.write(path);
+        lookup.loadFile(path);
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << layout.positions() << " positions, " << rounds
+                  << " rounds, " << seconds << " s\n";
+        return written + 1;
+    }
+};
@@ -1,257 +1,437 @@
-#include "board.hpp"
-#include <iostream>
-#include <vector>
-
-void setPiece(Bitboard &bitboard, int file, int rank) {
-  int square = rank * 8 + file;
-  bitboard |= (1ULL << square);
-  std::cout << "Setting piece at file " << file << ", rank " << rank
-            << " (square " << square << ")" << std::endl;
-}
-
-void initBoard(ChessBoard &b) {
-
-  // Set up pieces for White
-  setPiece(b[WR], 0, 0); // White Rook on a1
-  setPiece(b[WN], 1, 0); // White Knight on b1
-  setPiece(b[WB], 2, 0); // White Bishop on c1
-  setPiece(b[WQ], 3, 0); // White Queen on d1
-  setPiece(b[WK], 4, 0); // White King on e1
-  setPiece(b[WB], 5, 0); // White Bishop on f1
-  setPiece(b[WN], 6, 0); // White Knight on g1
-  setPiece(b[WR], 7, 0); // White Rook on h1
-  for (int file = 0; file < 8; ++file) {
-    setPiece(b[WP], file, 1); // White Pawns on rank 2
-  }
-
-  // Set up pieces for Black
-  setPiece(b[BR], 0, 7); // Black Rook on a8
-  setPiece(b[BN], 1, 7); // Black Knight on b8
-  setPiece(b[BB], 2, 7); // Black Bishop on c8
-  setPiece(b[BQ], 3, 7); // Black Queen on d8
-  setPiece(b[BK], 4, 7); // Black King on e8
-  setPiece(b[BB], 5, 7); // Black Bishop on f8
-  setPiece(b[BN], 6, 7); // Black Knight on g8
-  setPiece(b[BR], 7, 7); // Black Rook on h8
-  for (int file = 0; file < 8; ++file) {
-    setPiece(b[BP], file, 6); // Black Pawns on rank 7
-  }
-}
-
-
-
-void printBoard(const ChessBoard &pieceBitboards) {
-  char board[64];
-
-  // Fill board with empty squares
-  std::fill(std::begin(board), std::end(board), '.');
-
-  // Map each square to the appropriate piece character
-  for (int i = 0; i < pieceBitboards.size(); ++i) {
-    Bitboard bitboard = pieceBitboards[i];
-
-    for (int square = 0; square < 64; ++square) {
-      if (!((bitboard >> square) & 1ULL)) {
-        continue;
-      }
-
-      switch (i) {
-      case WP:
-        board[square] = 'P';
-        break;
-      case WN:
-        board[square] = 'N';
-        break;
-      case WB:
-        board[square] = 'B';
-        break;
-      case WR:
-        board[square] = 'R';
-        break;
-      case WQ:
-        board[square] = 'Q';
-        break;
-      case WK:
-        board[square] = 'K';
-        break;
-      case BP:
-        board[square] = 'p';
-        break;
-      case BN:
-        board[square] = 'n';
-        break;
-      case BB:
-        board[square] = 'b';
-        break;
-      case BR:
-        board[square] = 'r';
-        break;
-      case BQ:
-        board[square] = 'q';
-        break;
-      case BK:
-        board[square] = 'k';
-        break;
-      }
-    }
-  }
-
-  // Print the board
-  std::cout << "\nChess Board:\n";
-  for (int rank = 7; rank >= 0; --rank) {
-    std::cout << rank + 1 << " "; // Rank label
-    for (int file = 0; file < 8; ++file) {
-      std::cout << board[rank * 8 + file] << " ";
-    }
-    std::cout << std::endl;
-  }
-  std::cout << "  a b c d e f g h\n"; // File labels
-}
-
-void fenToBoard(ChessBoard &board, const std::string &fen) {
-    // Clear the board first
-    for (auto &bitboard : board) {
-        bitboard = 0ULL;
-    }
-    
-    int rank = 7;  // Start from rank 8 (index 7)
-    int file = 0;  // Start from file a (index 0)
-    
-    // Parse piece positions
-    size_t pos = 0;
-    while (pos < fen.length() && fen[pos] != ' ') {
-        char c = fen[pos];
-        
-        if (c == '/') {
-            rank--;
-            file = 0;
-        }
-        else if (isdigit(c)) {
-            file += (c - '0');
-        }
-        else {
-            // Map piece characters to board indices
-            int pieceIndex;
-            switch (c) {
-                case 'P': pieceIndex = WP; break;
-                case 'N': pieceIndex = WN; break;
-                case 'B': pieceIndex = WB; break;
-                case 'R': pieceIndex = WR; break;
-                case 'Q': pieceIndex = WQ; break;
-                case 'K': pieceIndex = WK; break;
-                case 'p': pieceIndex = BP; break;
-                case 'n': pieceIndex = BN; break;
-                case 'b': pieceIndex = BB; break;
-                case 'r': pieceIndex = BR; break;
-                case 'q': pieceIndex = BQ; break;
-                case 'k': pieceIndex = BK; break;
-                default: 
-                    throw std::runtime_error("Invalid FEN character: " + std::string(1, c));
-            }
-            
-            setPiece(board[pieceIndex], file, rank);
-            file++;
-        }
-        pos++;
-    }
-    
-    // Note: Additional FEN fields (active color, castling rights, en passant, etc.)
-    // can be parsed here if needed for future functionality
-}
-
-
-void setPositionFromFEN(ChessBoard &board, const std::string &fen) {
-    // Clear all bitboards first
-    for (auto &bitboard : board) {
-        bitboard = 0ULL;
-    }
-    
-    int rank = 7;  // Start from rank 8 (index 7)
-    int file = 0;  // Start from file a (index 0)
-    
-    // Parse the piece placement part of FEN (before first space)
-    size_t pos = fen.find(' ');
-    std::string piece_placement = fen.substr(0, pos);
-    
-    for (char c : piece_placement) {
-        if (c == '/') {
-            rank--;
-            file = 0;
-        } else if (isdigit(c)) {
-            file += (c - '0');
-        } else {
-            int square = rank * 8 + file;
-            Bitboard mask = 1ULL << square;
-            
-            switch (c) {
-                // White pieces
-                case 'P': board[WP] |= mask; break;
-                case 'N': board[WN] |= mask; break;
-                case 'B': board[WB] |= mask; break;
-                case 'R': board[WR] |= mask; break;
-                case 'Q': board[WQ] |= mask; break;
-                case 'K': board[WK] |= mask; break;
-                
-                // Black pieces
-                case 'p': board[BP] |= mask; break;
-                case 'n': board[BN] |= mask; break;
-                case 'b': board[BB] |= mask; break;
-                case 'r': board[BR] |= mask; break;
-                case 'q': board[BQ] |= mask; break;
-                case 'k': board[BK] |= mask; break;
-            }
-            file++;
-        }
-    }
-}
-
-
-std::string boardToFen(const ChessBoard &board) {
-    std::string fen;
-    char pieceSymbols[12] = {'P','N','B','R','Q','K','p','n','b','r','q','k'};
-    
-    for (int rank = 7; rank >= 0; rank--) {
-        int emptyCount = 0;
-        
-        for (int file = 0; file < 8; file++) {
-            bool pieceFound = false;
-            
-            for (int pieceType = 0; pieceType < 12; pieceType++) {
-                if (board[pieceType] & (1ULL << (rank * 8 + file))) {
-                    if (emptyCount > 0) {
-                        fen += std::to_string(emptyCount);
-                        emptyCount = 0;
-                    }
-                    fen += pieceSymbols[pieceType];
-                    pieceFound = true;
-                    break;
-                }
-            }
-            
-            if (!pieceFound) {
-                emptyCount++;
-            }
-        }
-        
-        if (emptyCount > 0) {
-            fen += std::to_string(emptyCount);
-        }
-        
-        if (rank > 0) {
-            fen += '/';
-        }
-    }
-    
-    // Add standard suffix for initial position
-    fen += " w KQkq - 0 1";
-    return fen;
-}
-
-
-bool isWhiteturnFen(const std::string& fen) {
-    size_t spacePos = fen.find(' ');
-    if (spacePos != std::string::npos && spacePos + 1 < fen.length()) {
-        return fen[spacePos + 1] == 'w';
-    }
-    throw std::runtime_error("Invalid FEN string: missing turn indicator");
-} 
+#include "board.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+void setPiece(Bitboard &bitboard, int file, int rank) {
+  bitboard |= (1ULL << (rank * 8 + file));
+}
+
+void initBoard(ChessBoard &b) {
+
+  // Set up pieces for White
+  setPiece(b[WR], 0, 0); // White Rook on a1
+  setPiece(b[WN], 1, 0); // White Knight on b1
+  setPiece(b[WB], 2, 0); // White Bishop on c1
+  setPiece(b[WQ], 3, 0); // White Queen on d1
+  setPiece(b[WK], 4, 0); // White King on e1
+  setPiece(b[WB], 5, 0); // White Bishop on f1
+  setPiece(b[WN], 6, 0); // White Knight on g1
+  setPiece(b[WR], 7, 0); // White Rook on h1
+  for (int file = 0; file < 8; ++file) {
+    setPiece(b[WP], file, 1); // White Pawns on rank 2
+  }
+
+  // Set up pieces for Black
+  setPiece(b[BR], 0, 7); // Black Rook on a8
+  setPiece(b[BN], 1, 7); // Black Knight on b8
+  setPiece(b[BB], 2, 7); // Black Bishop on c8
+  setPiece(b[BQ], 3, 7); // Black Queen on d8
+  setPiece(b[BK], 4, 7); // Black King on e8
+  setPiece(b[BB], 5, 7); // Black Bishop on f8
+  setPiece(b[BN], 6, 7); // Black Knight on g8
+  setPiece(b[BR], 7, 7); // Black Rook on h8
+  for (int file = 0; file < 8; ++file) {
+    setPiece(b[BP], file, 6); // Black Pawns on rank 7
+  }
+}
+
+
+
+void printBoard(const ChessBoard &pieceBitboards) {
+  char board[64];
+
+  // Fill board with empty squares
+  std::fill(std::begin(board), std::end(board), '.');
+
+  // Map each square to the appropriate piece character
+  for (int i = 0; i < pieceBitboards.size(); ++i) {
+    Bitboard bitboard = pieceBitboards[i];
+
+    for (int square = 0; square < 64; ++square) {
+      if (!((bitboard >> square) & 1ULL)) {
+        continue;
+      }
+
+      switch (i) {
+      case WP:
+        board[square] = 'P';
+        break;
+      case WN:
+        board[square] = 'N';
+        break;
+      case WB:
+        board[square] = 'B';
+        break;
+      case WR:
+        board[square] = 'R';
+        break;
+      case WQ:
+        board[square] = 'Q';
+        break;
+      case WK:
+        board[square] = 'K';
+        break;
+      case BP:
+        board[square] = 'p';
+        break;
+      case BN:
+        board[square] = 'n';
+        break;
+      case BB:
+        board[square] = 'b';
+        break;
+      case BR:
+        board[square] = 'r';
+        break;
+      case BQ:
+        board[square] = 'q';
+        break;
+      case BK:
+        board[square] = 'k';
+        break;
+      }
+    }
+  }
+
+  // Print the board
+  std::cout << "\nChess Board:\n";
+  for (int rank = 7; rank >= 0; --rank) {
+    std::cout << rank + 1 << " "; // Rank label
+    for (int file = 0; file < 8; ++file) {
+      std::cout << board[rank * 8 + file] << " ";
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "  a b c d e f g h\n"; // File labels
+}
+
+namespace {
+
+constexpr char PIECE_SYMBOLS[] = "PNBRQKpnbrqk";
+
+// Piece letter -> piece, -1 for anything else
+constexpr std::array<int8_t, 256> PIECE_OF_SYMBOL = [] {
+    std::array<int8_t, 256> table{};
+    table.fill(-1);
+    for (int piece = 0; piece < 12; piece++) {
+        table[static_cast<unsigned char>(PIECE_SYMBOLS[piece])] = static_cast<int8_t>(piece);
+    }
+    return table;
+}();
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Pops the next space separated field off the front of text
+std::string_view nextField(std::string_view &text) {
+    size_t start = 0;
+    while (start < text.size() && isBlank(text[start])) {
+        start++;
+    }
+    size_t end = start;
+    while (end < text.size() && !isBlank(text[end])) {
+        end++;
+    }
+    std::string_view field = text.substr(start, end - start);
+    text.remove_prefix(end);
+    return field;
+}
+
+bool parseNumber(std::string_view field, int &out) {
+    if (field.empty() || field.size() > 6) {
+        return false;
+    }
+    int value = 0;
+    for (char c : field) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    out = value;
+    return true;
+}
+
+bool fail(const char **error, const char *reason) {
+    if (error) {
+        *error = reason;
+    }
+    return false;
+}
+
+// Placement, side, castling and en passant - the part FEN and EPD share.
+// Castling and en passant may be left out, some tools write "<placement> w".
+bool parsePositionFields(std::string_view &text, ChessBoard &board, FenState &state, const char **error) {
+    std::fill(board.begin(), board.end(), 0ULL);
+    state = FenState();
+
+    std::string_view placement = nextField(text);
+    int rank = 7, file = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) {
+                return fail(error, "rank without 8 squares");
+            }
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) {
+                return fail(error, "rank without 8 squares");
+            }
+        } else {
+            int piece = PIECE_OF_SYMBOL[static_cast<unsigned char>(c)];
+            if (piece < 0 || file > 7) {
+                return fail(error, piece < 0 ? "unknown piece letter" : "rank without 8 squares");
+            }
+            if ((piece == WP || piece == BP) && (rank == 0 || rank == 7)) {
+                return fail(error, "pawn on the first or last rank");
+            }
+            board[piece] |= 1ULL << (rank * 8 + file);
+            file++;
+        }
+    }
+    if (rank != 0 || file != 8) {
+        return fail(error, "placement without 8 ranks");
+    }
+    if (std::popcount(board[WK]) != 1 || std::popcount(board[BK]) != 1) {
+        return fail(error, "each side needs exactly one king");
+    }
+
+    std::string_view side = nextField(text);
+    if (side != "w" && side != "b") {
+        return fail(error, "side to move is not w or b");
+    }
+    state.whiteToMove = side == "w";
+
+    // Look ahead: the optional fields must not swallow EPD operations or clocks
+    std::string_view rest = text;
+    std::string_view castling = nextField(rest);
+    if (castling.empty() || castling.find_first_not_of("KQkq-") != std::string_view::npos) {
+        return true;
+    }
+    if (castling != "-") {
+        for (char c : castling) {
+            const char *right = std::strchr("KQkq", c);
+            if (!right) {
+                return fail(error, "bad castling field");
+            }
+            state.castling |= static_cast<uint8_t>(1 << (right - "KQkq"));
+        }
+    }
+    text = rest;
+
+    std::string_view enPassant = nextField(rest);
+    if (enPassant == "-") {
+        text = rest;
+    } else if (enPassant.size() == 2 && enPassant[0] >= 'a' && enPassant[0] <= 'h' &&
+               enPassant[1] >= '1' && enPassant[1] <= '8') {
+        // The square a pawn of the side that just moved skipped: rank 6 with
+        // white to move, rank 3 with black, the pawn in front of it and the
+        // square it came from empty
+        int square = (enPassant[0] - 'a') + (enPassant[1] - '1') * 8;
+        int forward = state.whiteToMove ? 8 : -8;
+        Bitboard occupied = 0;
+        for (Bitboard pieces : board) {
+            occupied |= pieces;
+        }
+        if (enPassant[1] != (state.whiteToMove ? '6' : '3') ||
+            !(board[state.whiteToMove ? BP : WP] & (1ULL << (square - forward))) ||
+            (occupied & ((1ULL << square) | (1ULL << (square + forward))))) {
+            return fail(error, "en passant square does not fit the position");
+        }
+        state.epSquare = square;
+        text = rest;
+    }
+    return true;
+}
+
+}  // namespace
+
+
+bool parseFen(std::string_view fen, ChessBoard &board, FenState &state, const char **error) {
+    if (!parsePositionFields(fen, board, state, error)) {
+        return false;
+    }
+    std::string_view halfmove = nextField(fen);
+    std::string_view fullmove = nextField(fen);
+    if (!halfmove.empty() && !parseNumber(halfmove, state.halfmoveClock)) {
+        return fail(error, "bad halfmove clock");
+    }
+    if (!fullmove.empty() && !parseNumber(fullmove, state.fullmoveNumber)) {
+        return fail(error, "bad fullmove number");
+    }
+    if (!nextField(fen).empty()) {
+        return fail(error, "text after the FEN");
+    }
+    return true;
+}
+
+
+bool parseEpd(std::string_view line, ChessBoard &board, FenState &state,
+              std::string_view &operations, const char **error) {
+    if (!parsePositionFields(line, board, state, error)) {
+        return false;
+    }
+    // Plenty of "EPD" files are FENs with operations after the clocks
+    std::string_view rest = line;
+    if (parseNumber(nextField(rest), state.halfmoveClock)) {
+        line = rest;
+        if (parseNumber(nextField(rest), state.fullmoveNumber)) {
+            line = rest;
+        }
+    }
+    size_t start = line.find_first_not_of(" \t");
+    operations = start == std::string_view::npos ? std::string_view() : line.substr(start);
+    return true;
+}
+
+
+std::string_view epdOperation(std::string_view operations, std::string_view opcode) {
+    while (!operations.empty()) {
+        // An operation runs up to the next ';' that is not inside quotes
+        size_t end = 0;
+        bool quoted = false;
+        while (end < operations.size() && (quoted || operations[end] != ';')) {
+            quoted ^= operations[end] == '"';
+            end++;
+        }
+        std::string_view operation = operations.substr(0, end);
+        operations.remove_prefix(std::min(end + 1, operations.size()));
+
+        if (nextField(operation) == opcode) {
+            size_t start = operation.find_first_not_of(" \t");
+            if (start == std::string_view::npos) {
+                return {};
+            }
+            std::string_view operand = operation.substr(start, operation.find_last_not_of(" \t") + 1 - start);
+            if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"') {
+                operand = operand.substr(1, operand.size() - 2);
+            }
+            return operand;
+        }
+    }
+    return {};
+}
+
+
+void setPositionFromFEN(ChessBoard &board, const std::string &fen) {
+    FenState state;
+    const char *error = nullptr;
+    if (!parseFen(fen, board, state, &error)) {
+        throw std::runtime_error("Invalid FEN (" + std::string(error) + "): " + fen);
+    }
+}
+
+
+uint8_t castlingFromPlacement(const ChessBoard &board) {
+    uint8_t rights = 0;
+    if (board[WK] & (1ULL << 4)) {
+        if (board[WR] & (1ULL << 7)) rights |= WHITE_OO;
+        if (board[WR] & (1ULL << 0)) rights |= WHITE_OOO;
+    }
+    if (board[BK] & (1ULL << 60)) {
+        if (board[BR] & (1ULL << 63)) rights |= BLACK_OO;
+        if (board[BR] & (1ULL << 56)) rights |= BLACK_OOO;
+    }
+    return rights;
+}
+
+
+uint8_t castlingAfterMove(uint8_t castling, int from, int to) {
+    // Rights lost when something moves from or to the square
+    auto lost = [](int square) -> uint8_t {
+        switch (square) {
+            case 4: return WHITE_OO | WHITE_OOO;
+            case 7: return WHITE_OO;
+            case 0: return WHITE_OOO;
+            case 60: return BLACK_OO | BLACK_OOO;
+            case 63: return BLACK_OO;
+            case 56: return BLACK_OOO;
+            default: return 0;
+        }
+    };
+    return castling & ~(lost(from) | lost(to));
+}
+
+
+size_t writeFen(const ChessBoard &board, const FenState &state, char *out) {
+    // Square -> piece letter first, one pass over the set bits
+    char squares[64] = {};
+    for (int piece = 11; piece >= 0; piece--) {
+        for (Bitboard bitboard = board[piece]; bitboard; bitboard &= bitboard - 1) {
+            squares[std::countr_zero(bitboard)] = PIECE_SYMBOLS[piece];
+        }
+    }
+
+    char *p = out;
+    for (int rank = 7; rank >= 0; rank--) {
+        int emptyCount = 0;
+        for (int file = 0; file < 8; file++) {
+            char symbol = squares[rank * 8 + file];
+            if (!symbol) {
+                emptyCount++;
+                continue;
+            }
+            if (emptyCount > 0) {
+                *p++ = static_cast<char>('0' + emptyCount);
+                emptyCount = 0;
+            }
+            *p++ = symbol;
+        }
+        if (emptyCount > 0) {
+            *p++ = static_cast<char>('0' + emptyCount);
+        }
+        if (rank > 0) {
+            *p++ = '/';
+        }
+    }
+
+    *p++ = ' ';
+    *p++ = state.whiteToMove ? 'w' : 'b';
+    *p++ = ' ';
+    if (!state.castling) {
+        *p++ = '-';
+    }
+    for (int right = 0; right < 4; right++) {
+        if (state.castling & (1 << right)) {
+            *p++ = "KQkq"[right];
+        }
+    }
+    *p++ = ' ';
+    if (state.epSquare >= 0) {
+        *p++ = static_cast<char>('a' + state.epSquare % 8);
+        *p++ = static_cast<char>('1' + state.epSquare / 8);
+    } else {
+        *p++ = '-';
+    }
+    for (int number : {state.halfmoveClock, state.fullmoveNumber}) {
+        *p++ = ' ';
+        p = std::to_chars(p, out + MAX_FEN_LENGTH, number).ptr;
+    }
+    return static_cast<size_t>(p - out);
+}
+
+
+std::string boardToFen(const ChessBoard &board, const FenState &state) {
+    char buffer[MAX_FEN_LENGTH];
+    return std::string(buffer, writeFen(board, state, buffer));
+}
+
+
+bool isWhiteturnFen(const std::string& fen) {
+    std::string_view rest = fen;
+    nextField(rest);
+    std::string_view side = nextField(rest);
+    if (side.empty()) {
+        throw std::runtime_error("Invalid FEN string: missing turn indicator");
+    }
+    return side == "w";
+}
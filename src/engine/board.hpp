@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 
 
 // Add Pieces to the ENUM
@@ -21,8 +22,50 @@ void printBoard(const ChessBoard &pieceBitboards);
 
 void initBoard(ChessBoard &b);
 
+// Castling rights, in the order FEN writes them
+enum CastlingRight : uint8_t { WHITE_OO = 1, WHITE_OOO = 2, BLACK_OO = 4, BLACK_OOO = 8 };
+
+// The FEN fields after the piece placement
+struct FenState {
+    bool whiteToMove{true};
+    uint8_t castling{0};     // CastlingRight bits
+    int epSquare{-1};        // square behind a pawn that just moved two, -1 for none
+    int halfmoveClock{0};
+    int fullmoveNumber{1};
+};
+
+// Longest FEN writeFen can produce, with room to spare
+constexpr size_t MAX_FEN_LENGTH = 128;
+
+// Parses and checks all six FEN fields without allocating, the board has to
+// hold 12 bitboards already. Castling, en passant and the clocks may be left
+// out. On failure returns false, with a reason in error if asked for.
+bool parseFen(std::string_view fen, ChessBoard &board, FenState &state, const char **error = nullptr);
+
+// EPD: the first four FEN fields, optionally the clocks, then operations like
+// 'bm e4; id "test 1";' which come back as a view into line
+bool parseEpd(std::string_view line, ChessBoard &board, FenState &state,
+              std::string_view &operations, const char **error = nullptr);
+
+// Operand of one EPD operation ("bm" -> "e4"), quotes removed, empty if missing
+std::string_view epdOperation(std::string_view operations, std::string_view opcode);
+
+// Throws std::runtime_error for an invalid FEN
 void setPositionFromFEN(ChessBoard &board, const std::string &fen);
 
+// The castling rights the kings and rooks on their home squares still allow,
+// for positions that come without a FEN
+uint8_t castlingFromPlacement(const ChessBoard &board);
+
+// The rights left after a move from -> to: a king or rook leaving its home
+// square, or a rook being taken on it, gives them up
+uint8_t castlingAfterMove(uint8_t castling, int from, int to);
+
+// Writes the FEN into out (MAX_FEN_LENGTH bytes), returns its length
+size_t writeFen(const ChessBoard &board, const FenState &state, char *out);
+
+std::string boardToFen(const ChessBoard &board, const FenState &state = FenState());
+
 bool isWhiteturnFen(const std::string& fen);
 
 
@@ -0,0 +1,337 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "bitbase.hpp"
+#include "board.hpp"
+#include "movegen.hpp"
+#include "referee.hpp"
+#include "search.hpp"
+#include "../eval/evaluation.hpp"
+#include "../utils/mapped_file.hpp"
+#include "../utils/zobrist.hpp"
+
+// Training data from self-play: scored positions with the result of the game
+// they came from, for tuning or training an evaluation.
+//
+// A record is 32 bytes. The board is packed as an occupancy bitboard plus one
+// 4 bit piece code per occupied square, in square order, so the 32 pieces of a
+// full board fit in 16 bytes. A file is a DataFileHeader followed by records,
+// in the order the games finished, the positions of a game together.
+
+// Game result in PackedPosition::flags
+enum class DataResult : uint8_t { BlackWins = 0, Draw = 1, WhiteWins = 2 };
+
+struct PackedPosition {
+    uint64_t occupied;      // squares with a piece
+    uint8_t pieces[16];     // WP .. BK of each occupied square from a1 up, low nibble first
+    int16_t score;          // centipawns from white's point of view, search score
+    uint16_t move;          // Move::raw() the search chose
+    uint8_t flags;          // bit 0 white to move, bits 1-2 DataResult
+    uint8_t halfmoveClock;
+    uint16_t ply;           // plies into the game
+
+    bool whiteToMove() const { return flags & 1; }
+    DataResult result() const { return static_cast<DataResult>((flags >> 1) & 3); }
+
+    static PackedPosition pack(const ChessBoard& board, bool whiteToMove) {
+        PackedPosition packed{};
+        for (int piece = WP; piece <= BK; piece++) {
+            packed.occupied |= board[piece];
+        }
+        int index = 0;
+        for (uint64_t squares = packed.occupied; squares && index < 32; squares &= squares - 1, index++) {
+            uint64_t bit = squares & -squares;
+            int piece = WP;
+            while (!(board[piece] & bit)) piece++;
+            packed.pieces[index / 2] |= static_cast<uint8_t>(piece << (4 * (index % 2)));
+        }
+        packed.flags = whiteToMove ? 1 : 0;
+        return packed;
+    }
+
+    void unpack(ChessBoard& board) const {
+        std::fill(board.begin(), board.end(), 0);
+        int index = 0;
+        for (uint64_t squares = occupied; squares && index < 32; squares &= squares - 1, index++) {
+            int piece = (pieces[index / 2] >> (4 * (index % 2))) & 15;
+            if (piece <= BK) {
+                board[piece] |= squares & -squares;
+            }
+        }
+    }
+};
+
+static_assert(sizeof(PackedPosition) == 32, "training records should stay 32 bytes");
+
+struct DataFileHeader {
+    static constexpr char MAGIC[8] = {'L', 'A', 'N', 'C', 'E', 'R', 'D', 'G'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t reserved[2];
+};
+
+static_assert(sizeof(DataFileHeader) == 32, "training data header layout");
+
+// Streams the records of a data file through a memory mapping, without
+// copying them; the tuner / trainer pulls them one at a time or in chunks
+class DataReader {
+private:
+    MappedFile m_file;
+    const PackedPosition* m_records{nullptr};
+    size_t m_count{0};
+    size_t m_next{0};
+
+public:
+    // False if the file is missing or not one of ours
+    bool open(const std::string& path) {
+        m_records = nullptr;
+        m_count = m_next = 0;
+        if (!m_file.open(path) || m_file.size() < sizeof(DataFileHeader)) {
+            return false;
+        }
+        DataFileHeader header;
+        std::memcpy(&header, m_file.data(), sizeof(header));
+        if (std::memcmp(header.magic, DataFileHeader::MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != DataFileHeader::VERSION || header.recordSize != sizeof(PackedPosition)) {
+            return false;
+        }
+        m_file.adviseSequential();
+        m_records = reinterpret_cast<const PackedPosition*>(m_file.data() + sizeof(DataFileHeader));
+        m_count = (m_file.size() - sizeof(DataFileHeader)) / sizeof(PackedPosition);
+        return true;
+    }
+
+    size_t size() const { return m_count; }
+    size_t remaining() const { return m_count - m_next; }
+    void rewind() { m_next = 0; }
+
+    const PackedPosition* next() {
+        return m_next < m_count ? &m_records[m_next++] : nullptr;
+    }
+
+    // Up to `max` records at once, as a view into the mapping. Returns how many.
+    size_t next(const PackedPosition*& chunk, size_t max) {
+        chunk = m_records + m_next;
+        size_t count = std::min(max, remaining());
+        m_next += count;
+        return count;
+    }
+};
+
+// Plays self-play games on all threads and appends their positions to a
+// data file. Every game starts with a few random legal moves from one of the
+// openings so no two games are alike, then both sides search a fixed number
+// of nodes a move. Positions in check and positions where the search chose a
+// capture are left out: their static evaluation says little about the score.
+class DataGenerator {
+public:
+    struct Options {
+        uint64_t games{1000};
+        unsigned threads{1};
+        uint64_t nodes{5000};       // per move
+        int randomPlies{8};         // random moves at the start of a game
+        int maxPlies{400};          // then a draw
+        uint64_t seed{1};
+        double resignScore{10.0};   // pawns, both sides agree for resignPlies plies
+        int resignPlies{4};
+        size_t hashMegabytes{4};
+        uint64_t reportEvery{1000}; // games, 0 = only the summary
+        std::vector<std::string> openings;  // FEN or EPD lines, the start position if empty
+    };
+
+    struct Summary {
+        uint64_t games{0};
+        uint64_t positions{0};
+        uint64_t results[3]{};  // by DataResult
+        double seconds{0.0};
+
+        double positionsPerSecond() const {
+            return positions / std::max(seconds, 1e-9);
+        }
+    };
+
+private:
+    struct Player {
+        ChessBoard board;
+        MoveGen moveGen;
+        Evaluation evaluator;
+        MinimaxSearch search;
+
+        Player(size_t hashMegabytes, const Bitbases* bitbases)
+            : board(12, 0), moveGen(board), evaluator(board, moveGen), search(board, moveGen, evaluator) {
+            search.setHashSize(hashMegabytes);
+            search.setBitbases(bitbases);
+        }
+    };
+
+    Options m_options;
+    const Bitbases* m_bitbases;
+    std::ofstream& m_output;
+    std::atomic<uint64_t> m_nextGame{0};
+    std::mutex m_mutex;  // output and summary
+    Summary m_summary;
+    std::chrono::steady_clock::time_point m_start;
+
+    static int16_t toCentipawns(double pawns) {
+        return static_cast<int16_t>(std::clamp(std::lround(pawns * 100), -32000L, 32000L));
+    }
+
+    // Plays one game into `records`, returns its result
+    DataResult playGame(uint64_t game, Player& player, std::vector<PackedPosition>& records) {
+        std::mt19937_64 random(m_options.seed * 0x9E3779B97F4A7C15ULL + game);
+        const std::string& fen = m_options.openings[game % m_options.openings.size()];
+
+        ChessBoard board(12, 0);
+        FenState state;
+        std::string_view operations;
+        bool whiteToMove = true;
+        int halfmoves = 0;
+        // Random opening moves, again from the start if they run into the end of the game
+        for (int attempt = 0;; attempt++) {
+            if (!parseEpd(fen, board, state, operations)) {
+                return DataResult::Draw;
+            }
+            whiteToMove = state.whiteToMove;
+            halfmoves = state.halfmoveClock;
+            int ply = 0;
+            for (; ply < m_options.randomPlies; ply++) {
+                std::vector<Move> legal = Referee::legalMoves(board, whiteToMove);
+                if (legal.empty()) break;
+                halfmoves = Referee::play(board, legal[random() % legal.size()], whiteToMove) ? 0 : halfmoves + 1;
+                whiteToMove = !whiteToMove;
+            }
+            if (ply == m_options.randomPlies && !Referee::legalMoves(board, whiteToMove).empty()) break;
+            if (attempt == 10) return DataResult::Draw;
+        }
+
+        player.search.clearHash();
+        std::vector<uint64_t> history{Zobrist::hash(board, whiteToMove)};
+        SearchLimits limits;
+        limits.nodes = m_options.nodes;
+        int resignCount = 0;
+        double lastScore = 0.0;
+        records.clear();
+        for (int ply = 0;; ply++) {
+            std::vector<Move> legal = Referee::legalMoves(board, whiteToMove);
+            bool inCheck = Referee::inCheck(board, whiteToMove);
+            if (legal.empty()) {
+                if (!inCheck) return DataResult::Draw;
+                return whiteToMove ? DataResult::BlackWins : DataResult::WhiteWins;
+            }
+            if (halfmoves >= 100 || ply >= m_options.maxPlies || Referee::insufficientMaterial(board) ||
+                std::count(history.begin(), history.end(), history.back()) >= 3) {
+                return DataResult::Draw;
+            }
+
+            player.board = board;
+            Move best = player.search.search(whiteToMove, limits);
+            const Move* move = Referee::findMove(legal, moveToString(best));
+            if (!move) {
+                move = &legal[random() % legal.size()];  // the search left its king in check
+            }
+            const std::vector<SearchInfo>& lines = player.search.multiPVLines();
+            double score = lines.empty() ? 0.0 : lines[0].score;
+
+            uint64_t target = 1ULL << move->to();
+            bool capture = false;
+            for (int piece = whiteToMove ? BP : WP, last = piece + 6; piece < last; piece++) {
+                capture |= (board[piece] & target) != 0;
+            }
+            if (!inCheck && !capture && !lines.empty()) {
+                PackedPosition record = PackedPosition::pack(board, whiteToMove);
+                record.score = toCentipawns(score);
+                record.move = move->raw();
+                record.halfmoveClock = static_cast<uint8_t>(std::min(halfmoves, 255));
+                record.ply = static_cast<uint16_t>(std::min(ply + m_options.randomPlies, 65535));
+                records.push_back(record);
+            }
+
+            if (ply > 0) {
+                bool bothWinning = std::min(score, lastScore) >= m_options.resignScore;
+                bool bothLosing = std::max(score, lastScore) <= -m_options.resignScore;
+                resignCount = bothWinning || bothLosing ? resignCount + 1 : 0;
+                if (resignCount >= m_options.resignPlies) {
+                    return bothWinning ? DataResult::WhiteWins : DataResult::BlackWins;
+                }
+            }
+            lastScore = score;
+
+            if (Referee::play(board, *move, whiteToMove)) {
+                halfmoves = 0;
+                history.clear();
+            } else {
+                halfmoves++;
+            }
+            whiteToMove = !whiteToMove;
+            history.push_back(Zobrist::hash(board, whiteToMove));
+        }
+    }
+
+    void work(std::ostream& log) {
+        Player player(m_options.hashMegabytes, m_bitbases);
+        std::vector<PackedPosition> records;
+        for (uint64_t game = m_nextGame++; game < m_options.games; game = m_nextGame++) {
+            DataResult result = playGame(game, player, records);
+            for (PackedPosition& record : records) {
+                record.flags |= static_cast<uint8_t>(static_cast<uint8_t>(result) << 1);
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_output.write(reinterpret_cast<const char*>(records.data()),
+                           static_cast<std::streamsize>(records.size() * sizeof(PackedPosition)));
+            m_summary.games++;
+            m_summary.positions += records.size();
+            m_summary.results[static_cast<int>(result)]++;
+            if (m_options.reportEvery && m_summary.games % m_options.reportEvery == 0) {
+                m_summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+                log << m_summary.games << " games, " << m_summary.positions << " positions, "
+                    << static_cast<uint64_t>(m_summary.positionsPerSecond()) << " positions/s" << std::endl;
+            }
+        }
+    }
+
+public:
+    // output: a new file opened in binary mode
+    DataGenerator(const Options& options, std::ofstream& output, const Bitbases* bitbases = nullptr)
+        : m_options(options), m_bitbases(bitbases), m_output(output) {
+        m_options.threads = std::max(1u, m_options.threads);
+        if (m_options.openings.empty()) {
+            m_options.openings.push_back("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        }
+    }
+
+    Summary run(std::ostream& log) {
+        m_start = std::chrono::steady_clock::now();
+        DataFileHeader header{};
+        std::memcpy(header.magic, DataFileHeader::MAGIC, sizeof(header.magic));
+        header.version = DataFileHeader::VERSION;
+        header.recordSize = sizeof(PackedPosition);
+        m_output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < m_options.threads; i++) {
+            workers.emplace_back([this, &log] { work(log); });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        m_output.flush();
+        m_summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        return m_summary;
+    }
+};
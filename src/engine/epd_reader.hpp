@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "board.hpp"
+#include "../utils/mapped_file.hpp"
+
+// Streams the lines of an EPD / FEN file through a memory mapping. Lines are
+// views into the mapping, nothing is copied or allocated, so a file of
+// millions of positions goes by as fast as the pages come in. The views stay
+// valid as long as the reader.
+class EpdReader {
+private:
+    MappedFile m_file;
+    const char* m_pos{nullptr};
+    const char* m_end{nullptr};
+    uint64_t m_lineNumber{0};
+    uint64_t m_invalid{0};
+
+public:
+    EpdReader() = default;
+
+    explicit EpdReader(const std::string& path) {
+        open(path);
+    }
+
+    bool open(const std::string& path) {
+        m_lineNumber = 0;
+        m_invalid = 0;
+        if (!m_file.open(path)) {
+            m_pos = m_end = nullptr;
+            return false;
+        }
+        m_file.adviseSequential();
+        m_pos = reinterpret_cast<const char*>(m_file.data());
+        m_end = m_pos + m_file.size();
+        return true;
+    }
+
+    bool isOpen() const { return m_file.isOpen(); }
+    size_t size() const { return m_file.size(); }
+
+    // Number of the line next() returned last, counting from 1
+    uint64_t lineNumber() const { return m_lineNumber; }
+
+    // Lines nextPosition() skipped because they are not a position
+    uint64_t invalidLines() const { return m_invalid; }
+
+    // Next line that is not empty or a '#' comment, without the line break
+    bool next(std::string_view& line) {
+        while (m_pos < m_end) {
+            const char* newline = static_cast<const char*>(std::memchr(m_pos, '\n', m_end - m_pos));
+            const char* lineEnd = newline ? newline : m_end;
+            line = std::string_view(m_pos, lineEnd - m_pos);
+            m_pos = newline ? newline + 1 : m_end;
+            m_lineNumber++;
+
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string_view::npos && line[start] != '#') {
+                line.remove_prefix(start);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Next line that parses as a position, see parseEpd
+    bool nextPosition(ChessBoard& board, FenState& state, std::string_view& operations) {
+        std::string_view line;
+        while (next(line)) {
+            if (parseEpd(line, board, state, operations)) {
+                return true;
+            }
+            m_invalid++;
+        }
+        return false;
+    }
+};
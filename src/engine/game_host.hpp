@@ -0,0 +1,480 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "board.hpp"
+#include "movegen.hpp"
+#include "referee.hpp"
+#include "search.hpp"
+#include "transposition.hpp"
+#include "../eval/evaluation.hpp"
+#include "../utils/zobrist.hpp"
+
+// Many independent games in one long-lived process, instead of one engine
+// process per game. A game is only its position, its history and (unless
+// the table is shared) its hash table, a few KB plus the table. Searching
+// is done by a fixed pool of workers, each with one MinimaxSearch that
+// loads the position and table of whatever game it serves next.
+//
+// Every "go" gets a deadline: when it arrived plus the game's move time.
+// The requests wait in one queue per worker, most urgent first; new ones are
+// dealt round robin and a worker with nothing to do steals the most urgent
+// request of another queue. A search cannot be paused, so the time slice
+// of a request is what is left of its budget when a worker picks it up:
+// time spent queueing comes out of the search, not on top of the reply.
+class GameHost {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    struct Options {
+        unsigned threads{1};
+        size_t hashPerGame{1};    // MB, every game its own table
+        size_t sharedHash{0};     // MB of one table for all games instead, 0 = per game
+        int64_t movetimeMs{100};  // default budget of a move, request to reply
+        int depth{0};             // depth cap on top of the time, 0 = none
+        int64_t marginMs{2};      // kept back for stopping the search and replying
+    };
+
+    // Sent for every "go" once the move is on the game's board
+    struct Reply {
+        std::string game;
+        Move move;           // Move() if the game was already over
+        std::string result;  // empty while the game goes on, "1-0 checkmate" etc. after it
+        double latencyMs;    // request to reply, queueing included
+        std::string error;   // the request failed (bad_alloc, ...), the game keeps going
+    };
+
+    struct Stats {
+        size_t games{0};
+        uint64_t served{0};
+        uint64_t missedDeadlines{0};
+        double seconds{0.0};  // since the first request
+        double p50Ms{0.0};    // percentiles to within 9%, see LatencyHistogram
+        double p99Ms{0.0};
+        double maxMs{0.0};
+
+        double movesPerSecond() const {
+            return served / std::max(seconds, 1e-9);
+        }
+    };
+
+private:
+    struct Game {
+        ChessBoard board{ChessBoard(12, 0)};
+        bool whiteToMove{true};
+        int halfmoves{0};
+        std::vector<uint64_t> history;  // position keys since the last irreversible move
+        std::vector<Move> moves;
+        std::unique_ptr<TranspositionTable> table;  // nullptr with a shared table
+        int64_t movetimeMs{0};
+        std::atomic<bool> busy{false};  // a "go" is queued or running
+    };
+
+    struct Request {
+        std::string id;
+        std::shared_ptr<Game> game;
+        Clock::time_point arrival;
+        Clock::time_point deadline;
+
+        // std::push_heap keeps the largest on top, we want the earliest deadline
+        bool operator<(const Request& other) const {
+            return deadline > other.deadline;
+        }
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::vector<Request> heap;
+    };
+
+    // Latencies in buckets an eighth of a doubling wide (9% apart) from 1 us
+    // to two minutes, so the host keeps fixed memory and stats() fixed work
+    // however long it runs. A percentile is the upper edge of its bucket.
+    struct LatencyHistogram {
+        static constexpr int STEPS = 8;                 // buckets per doubling
+        static constexpr int BUCKETS = 27 * STEPS + 1;  // 2^27 us, the last takes anything slower
+
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t total{0};
+        double maxMs{0.0};
+
+        static int bucket(double ms) {
+            double us = ms * 1000.0;
+            if (us <= 1.0) {
+                return 0;
+            }
+            return std::min(BUCKETS - 1, static_cast<int>(std::ceil(std::log2(us) * STEPS)));
+        }
+
+        void add(double ms) {
+            counts[bucket(ms)]++;
+            total++;
+            maxMs = std::max(maxMs, ms);
+        }
+
+        double percentile(double p) const {
+            uint64_t rank = std::min(total - 1, static_cast<uint64_t>(p * total));
+            uint64_t seen = 0;
+            for (int i = 0; i < BUCKETS; i++) {
+                seen += counts[i];
+                if (seen > rank) {
+                    return std::min(maxMs, std::exp2(static_cast<double>(i) / STEPS) / 1000.0);
+                }
+            }
+            return maxMs;
+        }
+    };
+
+    struct Worker {
+        ChessBoard board{ChessBoard(12, 0)};
+        MoveGen moveGen{board};
+        Evaluation evaluator{board, moveGen};
+        // Every search runs on the game's or the shared table
+        MinimaxSearch search{board, moveGen, evaluator, 0};
+    };
+
+    Options m_options;
+    std::function<void(const Reply&)> m_onReply;
+    std::unique_ptr<TranspositionTable> m_sharedTable;
+
+    std::mutex m_gamesMutex;
+    std::unordered_map<std::string, std::shared_ptr<Game>> m_games;
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::atomic<size_t> m_nextQueue{0};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    size_t m_pending{0};   // queued, under m_wakeMutex
+    size_t m_inFlight{0};  // queued or running, under m_wakeMutex
+    bool m_stopping{false};
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_statsMutex;
+    LatencyHistogram m_latencies;
+    uint64_t m_missed{0};
+    Clock::time_point m_firstRequest{};
+
+    static double millis(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    std::shared_ptr<Game> find(const std::string& id) {
+        std::lock_guard<std::mutex> lock(m_gamesMutex);
+        auto it = m_games.find(id);
+        return it == m_games.end() ? nullptr : it->second;
+    }
+
+    // The shared table moves on a generation once per move of every game,
+    // on average, instead of on each search. m_gamesMutex held.
+    void updateAging() {
+        if (m_sharedTable) {
+            m_sharedTable->setAgingInterval(static_cast<uint32_t>(m_games.size()));
+        }
+    }
+
+    static void playMove(Game& game, const Move& move) {
+        if (Referee::play(game.board, move, game.whiteToMove)) {
+            game.halfmoves = 0;
+            game.history.clear();
+        } else {
+            game.halfmoves++;
+        }
+        game.whiteToMove = !game.whiteToMove;
+        game.history.push_back(Zobrist::hash(game.board, game.whiteToMove));
+        game.moves.push_back(move);
+    }
+
+    // Empty while the game goes on
+    static std::string result(Game& game, const std::vector<Move>& legal) {
+        if (legal.empty()) {
+            if (!Referee::inCheck(game.board, game.whiteToMove)) return "1/2-1/2 stalemate";
+            return game.whiteToMove ? "0-1 checkmate" : "1-0 checkmate";
+        }
+        if (game.halfmoves >= 100) return "1/2-1/2 50 moves";
+        if (std::count(game.history.begin(), game.history.end(), game.history.back()) >= 3) {
+            return "1/2-1/2 repetition";
+        }
+        if (Referee::insufficientMaterial(game.board)) return "1/2-1/2 insufficient material";
+        return "";
+    }
+
+    // ---- Scheduler ----
+
+    void submit(Request request) {
+        Queue& queue = *m_queues[m_nextQueue++ % m_queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.heap.push_back(std::move(request));
+            std::push_heap(queue.heap.begin(), queue.heap.end());
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_pending++;
+            m_inFlight++;
+        }
+        m_wake.notify_one();
+    }
+
+    bool popFrom(Queue& queue, Request& out) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.heap.empty()) {
+            return false;
+        }
+        std::pop_heap(queue.heap.begin(), queue.heap.end());
+        out = std::move(queue.heap.back());
+        queue.heap.pop_back();
+        return true;
+    }
+
+    // Own queue first, then the queue whose most urgent request is the most
+    // urgent of all. False once the host shuts down.
+    bool take(size_t self, Request& out) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_wakeMutex);
+                m_wake.wait(lock, [this] { return m_pending > 0 || m_stopping; });
+                if (m_pending == 0) {
+                    return false;
+                }
+            }
+            bool found = popFrom(*m_queues[self], out);
+            while (!found) {
+                size_t victim = self;
+                Clock::time_point earliest = Clock::time_point::max();
+                for (size_t i = 0; i < m_queues.size(); i++) {
+                    std::lock_guard<std::mutex> lock(m_queues[i]->mutex);
+                    if (!m_queues[i]->heap.empty() && m_queues[i]->heap.front().deadline < earliest) {
+                        earliest = m_queues[i]->heap.front().deadline;
+                        victim = i;
+                    }
+                }
+                if (earliest == Clock::time_point::max()) {
+                    break;  // another worker got there first
+                }
+                found = popFrom(*m_queues[victim], out);
+            }
+            if (found) {
+                std::lock_guard<std::mutex> lock(m_wakeMutex);
+                m_pending--;
+                return true;
+            }
+        }
+    }
+
+    void serve(Worker& worker, Request& request) {
+        Game& game = *request.game;
+        Reply reply{request.id, Move(), "", 0.0, ""};
+        // One failing request must not take the other games down with it:
+        // it gets an error reply and the worker goes on with the next one
+        try {
+            std::vector<Move> legal = Referee::legalMoves(game.board, game.whiteToMove);
+            reply.result = result(game, legal);
+            if (reply.result.empty()) {
+                worker.board = game.board;
+                worker.search.useHashTable(game.table ? game.table.get() : m_sharedTable.get());
+                SearchLimits limits;
+                limits.moveOverhead = m_options.marginMs;
+                limits.movetime = std::max<int64_t>(
+                    1, std::chrono::duration_cast<std::chrono::milliseconds>(request.deadline - Clock::now()).count());
+                limits.depth = m_options.depth;
+                Move best = worker.search.search(game.whiteToMove, limits);
+                // A pseudo-legal move that leaves the king in check is swapped
+                // for any legal one, the player still gets a move
+                const Move* move = Referee::findMove(legal, moveToString(best));
+                reply.move = move ? *move : legal[0];
+                playMove(game, reply.move);
+                reply.result = result(game, Referee::legalMoves(game.board, game.whiteToMove));
+            }
+        } catch (const std::exception& e) {
+            reply.error = e.what();
+        } catch (...) {
+            reply.error = "unknown error";
+        }
+
+        Clock::time_point done = Clock::now();
+        reply.latencyMs = millis(done - request.arrival);
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_latencies.add(reply.latencyMs);
+            m_missed += done > request.deadline;
+        }
+        game.busy = false;
+        if (m_onReply) {
+            m_onReply(reply);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_inFlight--;
+        }
+        m_wake.notify_all();
+    }
+
+    void work(size_t index) {
+        Worker worker;
+        Request request;
+        while (take(index, request)) {
+            serve(worker, request);
+            request = Request();
+        }
+    }
+
+public:
+    // onReply runs on the worker threads
+    GameHost(const Options& options, std::function<void(const Reply&)> onReply)
+        : m_options(options), m_onReply(std::move(onReply)) {
+        m_options.threads = std::max(1u, m_options.threads);
+        if (m_options.sharedHash > 0) {
+            m_sharedTable = std::make_unique<TranspositionTable>(m_options.sharedHash);
+        }
+        for (unsigned i = 0; i < m_options.threads; i++) {
+            m_queues.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 0; i < m_options.threads; i++) {
+            m_workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    GameHost(const GameHost&) = delete;
+    GameHost& operator=(const GameHost&) = delete;
+
+    // Answers what is queued, then stops the workers
+    ~GameHost() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    // Starts (or restarts) a game. movetimeMs 0 takes the default.
+    bool newGame(const std::string& id, const std::string& fen, int64_t movetimeMs, std::string& error) {
+        auto game = std::make_shared<Game>();
+        FenState state;
+        const char* fenError = nullptr;
+        if (!parseFen(fen, game->board, state, &fenError)) {
+            error = std::string("bad fen: ") + (fenError ? fenError : "?");
+            return false;
+        }
+        game->whiteToMove = state.whiteToMove;
+        game->halfmoves = state.halfmoveClock;
+        game->history.push_back(Zobrist::hash(game->board, game->whiteToMove));
+        game->movetimeMs = movetimeMs > 0 ? movetimeMs : m_options.movetimeMs;
+        if (!m_sharedTable) {
+            game->table = std::make_unique<TranspositionTable>(m_options.hashPerGame);
+        }
+
+        std::lock_guard<std::mutex> lock(m_gamesMutex);
+        auto it = m_games.find(id);
+        if (it != m_games.end() && it->second->busy) {
+            error = "busy";
+            return false;
+        }
+        m_games[id] = std::move(game);
+        updateAging();
+        return true;
+    }
+
+    // The opponent's move, "e2e4"
+    bool play(const std::string& id, const std::string& text, std::string& error) {
+        std::shared_ptr<Game> game = find(id);
+        if (!game) {
+            error = "no such game";
+            return false;
+        }
+        if (game->busy) {
+            error = "busy";
+            return false;
+        }
+        const Move* move = Referee::findMove(Referee::legalMoves(game->board, game->whiteToMove), text);
+        if (!move) {
+            error = "illegal move " + text;
+            return false;
+        }
+        playMove(*game, *move);
+        return true;
+    }
+
+    // Queues a search for the side to move, answered through onReply.
+    // movetimeMs 0 takes the game's budget.
+    bool go(const std::string& id, int64_t movetimeMs, std::string& error) {
+        std::shared_ptr<Game> game = find(id);
+        if (!game) {
+            error = "no such game";
+            return false;
+        }
+        if (game->busy.exchange(true)) {
+            error = "busy";
+            return false;
+        }
+        Request request{id, game, Clock::now(), {}};
+        request.deadline = request.arrival + std::chrono::milliseconds(movetimeMs > 0 ? movetimeMs : game->movetimeMs);
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            if (m_firstRequest == Clock::time_point{}) {
+                m_firstRequest = request.arrival;
+            }
+        }
+        submit(std::move(request));
+        return true;
+    }
+
+    // A game with a search running stays alive until the reply is out
+    bool close(const std::string& id, std::string& error) {
+        std::lock_guard<std::mutex> lock(m_gamesMutex);
+        if (m_games.erase(id) == 0) {
+            error = "no such game";
+            return false;
+        }
+        updateAging();
+        return true;
+    }
+
+    // Moves played in a game so far, empty for an unknown one
+    std::vector<Move> moves(const std::string& id) {
+        std::shared_ptr<Game> game = find(id);
+        return game && !game->busy ? game->moves : std::vector<Move>();
+    }
+
+    // Blocks until every queued search has been answered
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait(lock, [this] { return m_inFlight == 0; });
+    }
+
+    Stats stats() {
+        Stats stats;
+        {
+            std::lock_guard<std::mutex> lock(m_gamesMutex);
+            stats.games = m_games.size();
+        }
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        stats.served = m_latencies.total;
+        stats.missedDeadlines = m_missed;
+        if (m_latencies.total == 0) {
+            return stats;
+        }
+        stats.seconds = millis(Clock::now() - m_firstRequest) / 1000.0;
+        stats.p50Ms = m_latencies.percentile(0.50);
+        stats.p99Ms = m_latencies.percentile(0.99);
+        stats.maxMs = m_latencies.maxMs;
+        return stats;
+    }
+};
@@ -0,0 +1,369 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "movegen.hpp"
+#include "referee.hpp"
+#include "search.hpp"
+#include "../eval/evaluation.hpp"
+#include "../utils/zobrist.hpp"
+
+// Plays two engine configurations against each other in this process, to
+// check that a change makes the engine stronger at a fixed time control
+// and not just faster. Games run on a pool of threads, each thread playing
+// one game at a time with its own pair of searches. Every opening is played
+// twice with the colours swapped. An SPRT decides when enough games have
+// been played.
+//
+// Both sides run the same code, so a configuration is what can be set on a
+// MinimaxSearch: hash size, a fixed depth or node count, time odds, or any
+// setup hook a test build wants to try.
+struct EngineConfig {
+    std::string name{"engine"};
+    size_t hashMegabytes{16};
+    int depth{0};             // fixed depth per move instead of the clock
+    uint64_t nodes{0};        // fixed nodes per move instead of the clock
+    double timeScale{1.0};    // share of the time control this side gets
+    std::function<void(MinimaxSearch&)> setup;
+
+    // "hash=64,depth=6,nodes=20000,time=0.5", unknown keys throw
+    static EngineConfig parse(const std::string& name, const std::string& text) {
+        EngineConfig config;
+        config.name = name;
+        std::istringstream items(text);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (item.empty()) continue;
+            size_t equals = item.find('=');
+            std::string key = item.substr(0, equals);
+            std::string value = equals == std::string::npos ? "" : item.substr(equals + 1);
+            if (key == "hash") config.hashMegabytes = std::stoul(value);
+            else if (key == "depth") config.depth = std::stoi(value);
+            else if (key == "nodes") config.nodes = std::stoull(value);
+            else if (key == "time") config.timeScale = std::stod(value);
+            else if (key == "name") config.name = value;
+            else throw std::invalid_argument("unknown engine option " + key);
+        }
+        return config;
+    }
+};
+
+// Results from A's point of view, with the statistics worked out from them
+struct MatchScore {
+    uint64_t wins{0};
+    uint64_t losses{0};
+    uint64_t draws{0};
+
+    uint64_t games() const { return wins + losses + draws; }
+
+    double score() const {
+        return games() ? (wins + draws * 0.5) / games() : 0.5;
+    }
+
+    // Variance of a single game's result
+    double variance() const {
+        if (!games()) return 0.0;
+        double s = score();
+        return (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / games();
+    }
+
+    static double eloFromScore(double score) {
+        score = std::clamp(score, 1e-6, 1 - 1e-6);
+        return -400.0 * std::log10(1.0 / score - 1.0);
+    }
+
+    static double scoreFromElo(double elo) {
+        return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+    }
+
+    double elo() const { return eloFromScore(score()); }
+
+    // Half width of the 95% confidence interval, in Elo
+    double eloError() const {
+        if (games() < 2) return 0.0;
+        double margin = 1.959964 * std::sqrt(variance() / games());
+        return (eloFromScore(score() + margin) - eloFromScore(score() - margin)) / 2;
+    }
+
+    // Log likelihood ratio of elo1 against elo0, normal approximation of
+    // the trinomial GSPRT
+    double llr(double elo0, double elo1) const {
+        double var = variance();
+        if (games() == 0 || var <= 0.0) return 0.0;
+        double s0 = scoreFromElo(elo0), s1 = scoreFromElo(elo1);
+        return games() * (s1 - s0) * (2 * score() - s0 - s1) / (2 * var);
+    }
+};
+
+class MatchRunner {
+public:
+    struct Options {
+        EngineConfig a;
+        EngineConfig b;
+        uint64_t games{1000};
+        unsigned threads{1};
+        int64_t baseMs{10000};      // per side per game
+        int64_t incrementMs{100};
+        std::vector<std::string> openings;  // FENs, played in order, each twice
+
+        // Adjudication: a side resigns once both engines agree it is at
+        // least resignScore pawns down for resignPlies plies in a row. A game
+        // is a draw once both scores stay within drawScore for drawPlies
+        // plies after drawAfterPly, or at maxPlies.
+        double resignScore{8.0};
+        int resignPlies{6};
+        double drawScore{0.1};
+        int drawPlies{12};
+        int drawAfterPly{80};
+        int maxPlies{400};
+
+        // SPRT on the Elo of A over B, off when elo0 == elo1
+        double elo0{0.0};
+        double elo1{0.0};
+        double alpha{0.05};
+        double beta{0.05};
+
+        uint64_t reportEvery{10};  // games between progress lines
+    };
+
+    enum class Outcome { WhiteWins, BlackWins, Draw };
+
+    struct GameResult {
+        Outcome outcome;
+        std::string reason;
+        int plies;
+    };
+
+    struct Summary {
+        MatchScore score;
+        double seconds{0.0};
+        double llr{0.0};
+        int sprt{0};  // 1 accepted H1 (A stronger by elo1), -1 accepted H0, 0 undecided
+        uint64_t timeLosses{0};
+        uint64_t adjudicated{0};
+
+        double gamesPerMinute() const {
+            return score.games() * 60.0 / std::max(seconds, 1e-9);
+        }
+    };
+
+private:
+    struct Player {
+        ChessBoard board;
+        MoveGen moveGen;
+        Evaluation evaluator;
+        MinimaxSearch search;
+        const EngineConfig& config;
+
+        explicit Player(const EngineConfig& engineConfig)
+            : board(12, 0), moveGen(board), evaluator(board, moveGen), search(board, moveGen, evaluator),
+              config(engineConfig) {
+            search.setHashSize(config.hashMegabytes);
+            if (config.setup) {
+                config.setup(search);
+            }
+        }
+    };
+
+    Options m_options;
+    std::atomic<uint64_t> m_nextGame{0};
+    std::atomic<bool> m_stop{false};
+    std::mutex m_resultMutex;
+    Summary m_summary;
+    uint64_t m_reportedGames{0};  // games in the last score line printed
+    std::chrono::steady_clock::time_point m_start;
+
+    // ---- One game ----
+
+    GameResult playGame(const std::string& fen, Player& white, Player& black) {
+        ChessBoard board(12, 0);
+        FenState state;
+        if (!parseFen(fen, board, state)) {
+            return {Outcome::Draw, "bad opening", 0};
+        }
+        bool whiteToMove = state.whiteToMove;
+        int halfmoves = state.halfmoveClock;
+        std::vector<uint64_t> history{Zobrist::hash(board, whiteToMove)};
+
+        Player* players[2] = {&black, &white};  // indexed by whiteToMove
+        int64_t clock[2];
+        int64_t increment[2];
+        for (int side = 0; side < 2; side++) {
+            double scale = players[side]->config.timeScale;
+            clock[side] = static_cast<int64_t>(m_options.baseMs * scale);
+            increment[side] = static_cast<int64_t>(m_options.incrementMs * scale);
+            players[side]->search.clearHash();
+        }
+
+        int resignCount = 0, drawCount = 0;
+        double lastScore = 0.0;
+        for (int ply = 0;; ply++) {
+            auto lose = [&](const char* reason) {
+                return GameResult{whiteToMove ? Outcome::BlackWins : Outcome::WhiteWins, reason, ply};
+            };
+            std::vector<Move> legal = Referee::legalMoves(board, whiteToMove);
+            if (legal.empty()) {
+                return Referee::inCheck(board, whiteToMove) ? lose("checkmate") : GameResult{Outcome::Draw, "stalemate", ply};
+            }
+            if (halfmoves >= 100) return {Outcome::Draw, "50 moves", ply};
+            if (std::count(history.begin(), history.end(), history.back()) >= 3) {
+                return {Outcome::Draw, "repetition", ply};
+            }
+            if (Referee::insufficientMaterial(board)) return {Outcome::Draw, "insufficient material", ply};
+            if (ply >= m_options.maxPlies) return {Outcome::Draw, "max plies", ply};
+
+            Player& player = *players[whiteToMove];
+            player.board = board;
+            SearchLimits limits;
+            if (player.config.depth > 0 || player.config.nodes > 0) {
+                limits.depth = player.config.depth;
+                limits.nodes = player.config.nodes;
+            } else {
+                limits.wtime = clock[1];
+                limits.btime = clock[0];
+                limits.winc = increment[1];
+                limits.binc = increment[0];
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            Move move = player.search.search(whiteToMove, limits);
+            int64_t spent = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            if (!limits.depth && !limits.nodes) {
+                clock[whiteToMove] -= spent;
+                if (clock[whiteToMove] < 0) {
+                    return lose("time");
+                }
+                clock[whiteToMove] += increment[whiteToMove];
+            }
+
+            auto it = std::find(legal.begin(), legal.end(), move);
+            if (it == legal.end()) {
+                return lose("illegal move");
+            }
+
+            // Adjudication on the scores of both sides' last moves, white's view
+            const std::vector<SearchInfo>& lines = player.search.multiPVLines();
+            double score = lines.empty() ? 0.0 : lines[0].score;
+            if (ply > 0) {
+                bool bothWinning = std::min(score, lastScore) >= m_options.resignScore;
+                bool bothLosing = std::max(score, lastScore) <= -m_options.resignScore;
+                resignCount = bothWinning || bothLosing ? resignCount + 1 : 0;
+                if (resignCount >= m_options.resignPlies) {
+                    return {bothWinning ? Outcome::WhiteWins : Outcome::BlackWins, "adjudicated win", ply};
+                }
+                bool quiet = std::abs(score) <= m_options.drawScore && std::abs(lastScore) <= m_options.drawScore;
+                drawCount = quiet && ply >= m_options.drawAfterPly ? drawCount + 1 : 0;
+                if (drawCount >= m_options.drawPlies) {
+                    return {Outcome::Draw, "adjudicated draw", ply};
+                }
+            }
+            lastScore = score;
+
+            if (Referee::play(board, *it, whiteToMove)) {
+                halfmoves = 0;
+                history.clear();
+            } else {
+                halfmoves++;
+            }
+            whiteToMove = !whiteToMove;
+            history.push_back(Zobrist::hash(board, whiteToMove));
+        }
+    }
+
+    void work(std::ostream& out) {
+        Player a(m_options.a), b(m_options.b);
+        while (!m_stop) {
+            uint64_t game = m_nextGame++;
+            if (game >= m_options.games) break;
+            const std::string& fen = m_options.openings[(game / 2) % m_options.openings.size()];
+            bool aIsWhite = game % 2 == 0;
+            GameResult result = aIsWhite ? playGame(fen, a, b) : playGame(fen, b, a);
+            record(game, result, aIsWhite, out);
+        }
+    }
+
+    void record(uint64_t game, const GameResult& result, bool aIsWhite, std::ostream& out) {
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        MatchScore& score = m_summary.score;
+        if (result.outcome == Outcome::Draw) {
+            score.draws++;
+        } else if ((result.outcome == Outcome::WhiteWins) == aIsWhite) {
+            score.wins++;
+        } else {
+            score.losses++;
+        }
+        m_summary.timeLosses += result.reason == "time";
+        m_summary.adjudicated += result.reason.rfind("adjudicated", 0) == 0;
+        m_summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+
+        if (m_options.elo0 != m_options.elo1) {
+            m_summary.llr = score.llr(m_options.elo0, m_options.elo1);
+            if (m_summary.llr >= upperBound()) m_summary.sprt = 1;
+            if (m_summary.llr <= lowerBound()) m_summary.sprt = -1;
+            if (m_summary.sprt != 0) m_stop = true;
+        }
+
+        if (m_options.reportEvery && score.games() % m_options.reportEvery == 0) {
+            out << "Game " << game + 1 << " " << (aIsWhite ? m_options.a.name : m_options.b.name) << " - "
+                << (aIsWhite ? m_options.b.name : m_options.a.name) << ": "
+                << (result.outcome == Outcome::WhiteWins ? "1-0" : result.outcome == Outcome::BlackWins ? "0-1" : "1/2-1/2")
+                << " (" << result.reason << ", " << result.plies << " plies)\n";
+            report(out);
+            m_reportedGames = score.games();
+        }
+    }
+
+    double lowerBound() const { return std::log(m_options.beta / (1 - m_options.alpha)); }
+    double upperBound() const { return std::log((1 - m_options.beta) / m_options.alpha); }
+
+public:
+    explicit MatchRunner(const Options& options) : m_options(options) {
+        m_options.threads = std::max(1u, m_options.threads);
+        if (m_options.openings.empty()) {
+            m_options.openings.push_back("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        }
+    }
+
+    // One line with the score so far, also printed every reportEvery games
+    void report(std::ostream& out) const {
+        const MatchScore& score = m_summary.score;
+        out << "Score of " << m_options.a.name << " vs " << m_options.b.name << ": +" << score.wins << " -"
+            << score.losses << " =" << score.draws << " [" << score.score() << "] " << score.games() << " games"
+            << ", Elo " << score.elo() << " +/- " << score.eloError()
+            << ", " << m_summary.gamesPerMinute() << " games/min";
+        if (m_options.elo0 != m_options.elo1) {
+            out << ", LLR " << m_summary.llr << " [" << lowerBound() << ", " << upperBound() << "]";
+        }
+        out << std::endl;
+    }
+
+    // Plays until the games are done or the SPRT decides, and ends with the
+    // score line unless the last progress line already was the final score
+    Summary run(std::ostream& out) {
+        m_start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < m_options.threads; i++) {
+            workers.emplace_back([this, &out] { work(out); });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        m_summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        if (m_reportedGames != m_summary.score.games()) {
+            report(out);
+        }
+        return m_summary;
+    }
+};
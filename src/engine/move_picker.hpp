@@ -0,0 +1,143 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "board.hpp"
+#include "movegen.hpp"
+
+// Hands out the moves of a node one at a time, generating them in stages:
+//   1. the TT move, only checked for pseudo-legality
+//   2. captures, best victim / cheapest attacker first (MVV-LVA)
+//   3. the two killers of this ply, if they are quiet and playable here
+//   4. the other quiet moves, by history score
+// Most cut nodes fail high on the TT move or a capture, and then the quiet
+// moves are never generated or scored at all.
+//
+// The moves live in a list the search owns (one per ply), so a node does
+// not allocate once the lists have grown.
+class MovePicker {
+public:
+    enum Stage { TTMove, GenerateCaptures, Captures, Killers, GenerateQuiets, Quiets, Done };
+
+    // Pawn .. king, for MVV-LVA only
+    static constexpr int PIECE_VALUE[6] = {1, 3, 3, 5, 9, 100};
+
+private:
+    MoveGen& m_moveGen;
+    const ChessBoard& m_board;
+    std::vector<Move>& m_moves;
+    std::vector<int>& m_scores;
+    const int (&m_history)[64][64];
+    bool m_isWhite;
+    Move m_ttMove;
+    bool m_hasTTMove;
+    const Move* m_killers;
+    Stage m_stage{TTMove};
+    size_t m_index{0};
+    int m_killerIndex{0};
+
+    // Piece type (0 pawn .. 5 king) on a square, -1 if empty
+    int pieceTypeOn(int square) const {
+        uint64_t bit = 1ULL << square;
+        for (int piece = WP; piece <= BK; piece++) {
+            if (m_board[piece] & bit) return piece % 6;
+        }
+        return -1;
+    }
+
+    bool isKiller(const Move& move) const {
+        return move == m_killers[0] || move == m_killers[1];
+    }
+
+    // Swaps the best scored move left into m_index: a selection sort that
+    // only does as much work as moves get searched
+    Move pickBest() {
+        size_t best = m_index;
+        for (size_t i = m_index + 1; i < m_moves.size(); i++) {
+            if (m_scores[i] > m_scores[best]) best = i;
+        }
+        std::swap(m_moves[m_index], m_moves[best]);
+        std::swap(m_scores[m_index], m_scores[best]);
+        return m_moves[m_index++];
+    }
+
+public:
+    MovePicker(MoveGen& moveGen, const ChessBoard& board, std::vector<Move>& moves, std::vector<int>& scores,
+               const int (&history)[64][64], bool isWhite, const Move* ttMove, const Move* killers)
+        : m_moveGen(moveGen), m_board(board), m_moves(moves), m_scores(scores), m_history(history),
+          m_isWhite(isWhite), m_ttMove(ttMove ? *ttMove : Move()), m_hasTTMove(ttMove != nullptr),
+          m_killers(killers) {}
+
+    Stage stage() const { return m_stage; }
+
+    // Next move to search, false once every move has been handed out
+    bool next(Move& move) {
+        switch (m_stage) {
+            case TTMove:
+                m_stage = GenerateCaptures;
+                if (m_hasTTMove && m_moveGen.isPseudoLegal(m_ttMove, m_isWhite)) {
+                    move = m_ttMove;
+                    return true;
+                }
+                m_hasTTMove = false;
+                [[fallthrough]];
+
+            case GenerateCaptures:
+                m_moves.clear();
+                m_scores.clear();
+                m_moveGen.GenerateCaptures(m_isWhite, m_moves);
+                for (const Move& capture : m_moves) {
+                    int victim = pieceTypeOn(capture.to());
+                    int attacker = pieceTypeOn(capture.from());
+                    m_scores.push_back(PIECE_VALUE[victim] * 8 - attacker);
+                }
+                m_index = 0;
+                m_stage = Captures;
+                [[fallthrough]];
+
+            case Captures:
+                while (m_index < m_moves.size()) {
+                    move = pickBest();
+                    if (!(m_hasTTMove && move == m_ttMove)) return true;
+                }
+                m_stage = Killers;
+                [[fallthrough]];
+
+            case Killers:
+                while (m_killerIndex < 2) {
+                    const Move& killer = m_killers[m_killerIndex++];
+                    if (killer == Move() || (m_hasTTMove && killer == m_ttMove)) continue;
+                    // Quiet here too: a capture was already handed out above
+                    if (pieceTypeOn(killer.to()) < 0 && m_moveGen.isPseudoLegal(killer, m_isWhite)) {
+                        move = killer;
+                        return true;
+                    }
+                }
+                m_stage = GenerateQuiets;
+                [[fallthrough]];
+
+            case GenerateQuiets: {
+                size_t firstQuiet = m_moves.size();
+                m_moveGen.GenerateQuiets(m_isWhite, m_moves);
+                for (size_t i = firstQuiet; i < m_moves.size(); i++) {
+                    m_scores.push_back(m_history[m_moves[i].from()][m_moves[i].to()]);
+                }
+                m_index = firstQuiet;
+                m_stage = Quiets;
+                [[fallthrough]];
+            }
+
+            case Quiets:
+                while (m_index < m_moves.size()) {
+                    move = pickBest();
+                    if (!(m_hasTTMove && move == m_ttMove) && !isKiller(move)) return true;
+                }
+                m_stage = Done;
+                [[fallthrough]];
+
+            case Done:
+                return false;
+        }
+        return false;
+    }
+};
@@ -1,7 +1,7 @@
 #pragma once 
 #include <iostream>
 #include "board.hpp"
-#include <array>
+#include "attacks.hpp"
 
 // For  windows users!
 inline int getLSB(uint64_t b) {
@@ -14,45 +14,89 @@ inline int getLSB(uint64_t b) {
 #endif
 }
 
+inline int getMSB(uint64_t b) {
+#if defined(_MSC_VER)  // If using MSVC
+    unsigned long index;
+    _BitScanReverse64(&index, b);
+    return index;
+#else  // GCC, Clang, etc.
+    return 63 - __builtin_clzll(b);
+#endif
+}
+
+
+// A move packed into 16 bits, in the Polyglot book layout plus our own flags:
+//   bits 0-5 to square, 6-11 from square,
+//   12-15 promotion piece (1 knight .. 4 queen, as in Polyglot) or Castling /
+//   EnPassant
+// Captures are not flagged, the board tells. A move list or TT entry gets
+// half the size of the old from/to/flags/inCheck struct.
+class Move {
+public:
+    enum Flag : uint8_t {
+        Normal = 0,
+        PromoteKnight = 1,  // the promotion flags are the offset of the piece from WP / BP
+        PromoteBishop = 2,
+        PromoteRook = 3,
+        PromoteQueen = 4,
+        Castling = 8,       // king move of two files, the rook goes along
+        EnPassant = 9,      // the captured pawn is behind the target square
+    };
+
+private:
+    uint16_t m_data{0};
+
+public:
+    constexpr Move() = default;
+
+    constexpr Move(int from, int to, Flag flag = Normal)
+        : m_data(static_cast<uint16_t>(to | (from << 6) | (flag << 12))) {}
+
+    static constexpr Move fromRaw(uint16_t raw) {
+        Move move;
+        move.m_data = raw;
+        return move;
+    }
+
+    constexpr int from() const { return (m_data >> 6) & 63; }
+    constexpr int to() const { return m_data & 63; }
+    constexpr Flag flag() const { return static_cast<Flag>(m_data >> 12); }
+    constexpr uint16_t raw() const { return m_data; }
 
-struct Move{
-    uint8_t from;
-    uint8_t to;
-    uint8_t flags;
-    bool inCheck{false};
+    constexpr bool isPromotion() const { return flag() >= PromoteKnight && flag() <= PromoteQueen; }
+    constexpr bool isCastling() const { return flag() == Castling; }
+    constexpr bool isEnPassant() const { return flag() == EnPassant; }
+
+    // Piece the pawn turns into, as an offset from WP / BP (WN - WP .. WQ - WP)
+    constexpr int promotionType() const { return flag(); }
+
+    constexpr bool operator==(const Move& other) const { return m_data == other.m_data; }
 };
 
+static_assert(sizeof(Move) == 2, "moves are packed into 16 bits");
+
+// Long algebraic notation as used by UCI, e.g. "e2e4" or "e7e8q"
+inline std::string moveToString(const Move& move) {
+    std::string str;
+    str += char('a' + move.from() % 8);
+    str += char('1' + move.from() / 8);
+    str += char('a' + move.to() % 8);
+    str += char('1' + move.to() / 8);
+    if (move.isPromotion()) {
+        str += " nbrq"[move.promotionType()];
+    }
+    return str;
+}
+
 
 //Change Class name 
 class MoveGen{
 
 private:
     ChessBoard& board;
-    std::array<uint64_t, 64> king_attacks;
-    std::array<uint64_t, 64> knight_attacks;
     std::vector<Move> moves;
     std::vector<Move> attack_vision;
 
-    uint64_t getRankMask(int square) {
-    /*
-    Rank 1: 0xFF               // 0-7
-    Rank 2: 0xFF00            // 8-15    (0xFF << 8)
-    Rank 3: 0xFF0000          // 16-23   (0xFF << 16)
-    Rank 4: 0xFF000000        // 24-31   (0xFF << 24)
-    Rank 5: 0xFF00000000      // 32-39   (0xFF << 32)
-    Rank 6: 0xFF0000000000    // 40-47   (0xFF << 40)
-    Rank 7: 0xFF000000000000  // 48-55   (0xFF << 48)
-    Rank 8: 0xFF00000000000000// 56-63   (0xFF << 56)
-    */ 
-        return 0xFFULL << (square & 56);  // square & 56 is same as (square / 8) * 8
-    }
-    
-
-    uint64_t getFileMask(int square) {
-        return 0x0101010101010101ULL << (square & 7);
-    }
-
-
     uint64_t getAllPieces(){
         return board[WP] | board[WN] | board[WB] | board[WR] | board[WQ] | board[WK] | 
                board[BP] | board[BN] | board[BB] | board[BR] | board[BQ] | board[BK]; 
@@ -66,11 +110,26 @@ private:
         return board[BP] | board[BN] | board[BB] | board[BR] | board[BQ] | board[BK];
     }
 
-    void GeneratePawnMoves(bool isWhite){
+    // A pawn reaching the last rank comes as four moves, one per piece,
+    // the queen first so it is tried first among equals
+    static void addPawnMove(std::vector<Move>& move, int from, int to) {
+        if (to >= 56 || to < 8) {
+            move.push_back(Move(from, to, Move::PromoteQueen));
+            move.push_back(Move(from, to, Move::PromoteKnight));
+            move.push_back(Move(from, to, Move::PromoteRook));
+            move.push_back(Move(from, to, Move::PromoteBishop));
+        } else {
+            move.push_back(Move(from, to));
+        }
+    }
+
+    void GeneratePawnMoves(bool isWhite, std::vector<Move>& move, bool captures = true, bool quiets = true){
 
         uint64_t pawns = isWhite ? board[WP] : board[BP];
         uint64_t enemies = isWhite ? getBlackPieces() : getWhitePieces();
         uint64_t empty = ~getAllPieces();
+        if (!captures) enemies = 0;
+        if (!quiets) empty = 0;
 
 
         // Bits dont work with negatives 
@@ -105,28 +164,28 @@ private:
         while(SinglePush) {
             int to = getLSB(SinglePush);
             int from = to - direction;
-            moves.push_back({(uint8_t)from, (uint8_t)to, 0});
+            addPawnMove(move, from, to);
             SinglePush &= SinglePush - 1;  // Clear least significant bit
         }
         
         while(doublePush) {
             int to = getLSB(doublePush);
             int from = to - (2 * direction);  // Subtract 2 ranks worth of movement
-            moves.push_back({(uint8_t)from, (uint8_t)to, 0});
+            move.push_back(Move(from, to));
             doublePush &= doublePush - 1; 
         }
 
         while(LeftCapture){
             int to = getLSB(LeftCapture);
             int from = isWhite ? to - 7 : to + 9;  
-            moves.push_back({(uint8_t)from, (uint8_t)to, 0});
+            addPawnMove(move, from, to);
             LeftCapture &= LeftCapture - 1; 
         }
 
         while(RightCaptures){
             int to = getLSB(RightCaptures);
             int from = isWhite ? to - 9 : to + 7;  // Correct diagonal math
-            moves.push_back({(uint8_t)from, (uint8_t)to, 0});
+            addPawnMove(move, from, to);
             RightCaptures &= RightCaptures - 1; 
         }
     }
@@ -145,49 +204,31 @@ private:
         while (LeftCapture) {
             int to = getLSB(LeftCapture);
             int from = isWhite ? to - 7 : to + 9;
-            attack_vision.push_back({ (uint8_t)from, (uint8_t)to, 0 });
+            attack_vision.push_back(Move(from, to));
             LeftCapture &= LeftCapture - 1;
         }
 
         while (RightCaptures) {
             int to = getLSB(RightCaptures);
             int from = isWhite ? to - 9 : to + 7;  // Correct diagonal math
-            attack_vision.push_back({ (uint8_t)from, (uint8_t)to, 0 });
+            attack_vision.push_back(Move(from, to));
             RightCaptures &= RightCaptures - 1;
         }
     }
 
-    void GenerateKnightMoves(bool isWhite, std::vector<Move>& move, bool includeFriendly = false){
+    void GenerateKnightMoves(bool isWhite, std::vector<Move>& move, uint64_t targets){
         uint64_t knight = isWhite ? board[WN] : board[BN];
-        uint64_t friendly = isWhite ? getWhitePieces() : getBlackPieces();
-        // uint64_t empty = ~getAllPieces();
         while(knight) {
             int from = getLSB(knight);
-            uint64_t move_mask = 0ULL;
-                if (from > 15)  { // Up 2
-                if (from % 8 != 0)  move_mask |= 1ULL << (from - 17);  // Left 1
-                if (from % 8 != 7)  move_mask |= 1ULL << (from - 15);  // Right 1
-            }
-            if (from < 48)  { // Down 2
-                if (from % 8 != 0)  move_mask |= 1ULL << (from + 15);  // Left 1
-                if (from % 8 != 7)  move_mask |= 1ULL << (from + 17);  // Right 1
-            }
-            if (from % 8 > 1)  { // Left 2
-                if (from > 7)   move_mask |= 1ULL << (from - 10);  // Up 1
-                if (from < 56)  move_mask |= 1ULL << (from + 6);   // Down 1
-            }
-            if (from % 8 < 6)  { // Right 2
-                if (from > 7)   move_mask |= 1ULL << (from - 6);   // Up 1
-                if (from < 56)  move_mask |= 1ULL << (from + 10);  // Down 1
-            }
-            
-            // Remove moves to squares occupied by friendly pieces
-            if (!includeFriendly) move_mask &= ~friendly;
+            uint64_t move_mask = Attacks::knight(from);
+
+            // Only the target squares the caller asked for
+            move_mask &= targets;
             
             // Add all valid moves to the moves vector
             while (move_mask) {
                 int to = getLSB(move_mask);
-                move.push_back({(uint8_t)from, (uint8_t)to, 0});
+                move.push_back(Move(from, to));
                 move_mask &= move_mask - 1;  // Clear least significant bit
             }
             
@@ -196,67 +237,18 @@ private:
 
     }
     
-    void GenerateRookMoves(bool isWhite, std::vector<Move>& move, bool includeFriendly = false){
+    void GenerateRookMoves(bool isWhite, std::vector<Move>& move, uint64_t targets){
         uint64_t Rook = isWhite ? board[WR] : board[BR];
-        uint64_t friendly = isWhite ? getWhitePieces() : getBlackPieces();
         uint64_t allPieces = getAllPieces();
             while(Rook){
                 int from = getLSB(Rook);
-                uint64_t move_mask = 0ULL;
+                uint64_t move_mask = Attacks::rook(from, allPieces);
 
-                uint64_t rank_mask = getRankMask(from);
-                uint64_t file_mask = getFileMask(from);
-
-                uint64_t blockers = allPieces & rank_mask;
-                
-
-
-                    //Looking right
-                uint64_t possible = rank_mask & (-(1ULL << (from + 1)));
-                blockers = allPieces & rank_mask & possible;
-                if (blockers) {
-                    int blocker = getLSB(blockers);
-                    possible &= ~(rank_mask & (-(1ULL << blocker)));
-                }
-                move_mask |= possible;
-
-
-
-                // Lookign left 
-                possible = rank_mask & ((1ULL << from) - 1);
-                blockers = allPieces & rank_mask;
-                if (blockers) {
-                    int blocker = 63 - getLSB(blockers & possible);
-                    possible &= ~(rank_mask & ((1ULL << (blocker + 1)) - 1));
-                }
-                move_mask |= possible;
-
-
-                blockers = allPieces & file_mask;
-
-                //Look up 
-                possible = file_mask & (-(1ULL << (from + 1)));
-                if(blockers){
-                    int blocker = getLSB(blockers & possible);
-                    possible &= ~(file_mask & (-(1ULL) << blocker));
-                }
-                move_mask |= possible;
-                
-
-             // Look Down (towards decreasing squares along the file)
-                possible = file_mask & ((1ULL << from) - 1);
-                blockers = allPieces & file_mask & possible;
-                if (blockers) {
-                    int blocker = 63 - getLSB(blockers);
-                    possible &= ~(file_mask & ((1ULL << (blocker + 1)) - 1));
-                }
-                move_mask |= possible;
-
-                if (!includeFriendly) move_mask &= ~friendly;
+                move_mask &= targets;
 
                 while (move_mask) {
                     int to = getLSB(move_mask);
-                    move.push_back({(uint8_t)from, (uint8_t)to, 0});
+                    move.push_back(Move(from, to));
                     move_mask &= move_mask - 1;
                 }
         
@@ -264,83 +256,21 @@ private:
             }
     }
 
- void GenerateBishopMoves(bool isWhite, std::vector<Move>& move, bool includeFriendly = false) {
+ void GenerateBishopMoves(bool isWhite, std::vector<Move>& move, uint64_t targets) {
     uint64_t Bishop = isWhite ? board[WB] : board[BB];
-    uint64_t friendly = isWhite ? getWhitePieces() : getBlackPieces();
     uint64_t allPieces = getAllPieces();
     
     while (Bishop) {
         int from = getLSB(Bishop);
-        uint64_t move_mask = 0ULL;
-        
-        // Helper lambda to get diagonal mask
-        auto getDiagonalMask = [](int square) {
-            const uint64_t mainDiagonal = 0x8040201008040201ULL;
-            int diag = (square % 8) - (square / 8);
-            if (diag >= 0) {
-                return mainDiagonal >> (diag * 8);
-            } else {
-                return mainDiagonal << (-diag * 8);
-            }
-        };
-        
-        // Helper lambda to get anti-diagonal mask
-        auto getAntiDiagonalMask = [](int square) {
-            const uint64_t mainAntiDiagonal = 0x0102040810204080ULL;
-            int diag = (square % 8) + (square / 8);
-            if (diag <= 7) {
-                return mainAntiDiagonal >> ((7 - diag) * 8);
-            } else {
-                return mainAntiDiagonal << ((diag - 7) * 8);
-            }
-        };
+        uint64_t move_mask = Attacks::bishop(from, allPieces);
 
-        uint64_t diagonalMask = getDiagonalMask(from);
-        uint64_t antiDiagonalMask = getAntiDiagonalMask(from);
-
-        // Northeast direction (diagonal)
-        uint64_t possible = diagonalMask & (-(1ULL << (from + 1)));
-        uint64_t blockers = allPieces & diagonalMask & possible;
-        if (blockers) {
-            int blocker = getLSB(blockers);
-            possible &= ~(-(1ULL << blocker));
-        }
-        move_mask |= possible;
-
-        // Southwest direction (diagonal)
-        possible = diagonalMask & ((1ULL << from) - 1);
-        blockers = allPieces & diagonalMask & possible;
-        if (blockers) {
-            int blocker = 63 - getLSB(blockers);
-            possible &= ~((1ULL << (blocker + 1)) - 1);
-        }
-        move_mask |= possible;
-
-        // Northwest direction (anti-diagonal)
-        possible = antiDiagonalMask & (-(1ULL << (from + 1)));
-        blockers = allPieces & antiDiagonalMask & possible;
-        if (blockers) {
-            int blocker = getLSB(blockers);
-            possible &= ~(-(1ULL << blocker));
-        }
-        move_mask |= possible;
-
-        // Southeast direction (anti-diagonal)
-        possible = antiDiagonalMask & ((1ULL << from) - 1);
-        blockers = allPieces & antiDiagonalMask & possible;
-        if (blockers) {
-            int blocker = 63 - getLSB(blockers);
-            possible &= ~((1ULL << (blocker + 1)) - 1);
-        }
-        move_mask |= possible;
-
-        // Remove moves to squares occupied by friendly pieces
-        if (!includeFriendly) move_mask &= ~friendly;
+        // Only the target squares the caller asked for
+        move_mask &= targets;
 
         // Add all valid moves to the moves vector
         while (move_mask) {
             int to = getLSB(move_mask);
-            move.push_back({(uint8_t)from, (uint8_t)to, 0});
+            move.push_back(Move(from, to));
             move_mask &= move_mask - 1;
         }
 
@@ -349,124 +279,22 @@ private:
 }
 
 
-void GenerateQueenMoves(bool isWhite, std::vector<Move>& move, bool includeFriendly = false) {
+void GenerateQueenMoves(bool isWhite, std::vector<Move>& move, uint64_t targets) {
     uint64_t Queen = isWhite ? board[WQ] : board[BQ];
-    uint64_t friendly = isWhite ? getWhitePieces() : getBlackPieces();
     uint64_t allPieces = getAllPieces();
     
     while (Queen) {
         int from = getLSB(Queen);
-        uint64_t move_mask = 0ULL;
 
-        // Get masks for all directions
-        uint64_t rank_mask = getRankMask(from);
-        uint64_t file_mask = getFileMask(from);
-        
-        // Reuse the diagonal mask lambdas from bishop moves
-        auto getDiagonalMask = [](int square) {
-            const uint64_t mainDiagonal = 0x8040201008040201ULL;
-            int diag = (square % 8) - (square / 8);
-            if (diag >= 0) {
-                return mainDiagonal >> (diag * 8);
-            } else {
-                return mainDiagonal << (-diag * 8);
-            }
-        };
-        
-        auto getAntiDiagonalMask = [](int square) {
-            const uint64_t mainAntiDiagonal = 0x0102040810204080ULL;
-            int diag = (square % 8) + (square / 8);
-            if (diag <= 7) {
-                return mainAntiDiagonal >> ((7 - diag) * 8);
-            } else {
-                return mainAntiDiagonal << ((diag - 7) * 8);
-            }
-        };
-
-        uint64_t diagonal_mask = getDiagonalMask(from);
-        uint64_t anti_diagonal_mask = getAntiDiagonalMask(from);
-
-        // Rook-like moves (horizontal and vertical)
-        // Looking right
-        uint64_t possible = rank_mask & (-(1ULL << (from + 1)));
-        uint64_t blockers = allPieces & rank_mask & possible;
-        if (blockers) {
-            int blocker = getLSB(blockers);
-            possible &= ~(rank_mask & (-(1ULL << blocker)));
-        }
-        move_mask |= possible;
-
-        // Looking left
-        possible = rank_mask & ((1ULL << from) - 1);
-        blockers = allPieces & rank_mask & possible;
-        if (blockers) {
-            int blocker = 63 - getLSB(blockers);
-            possible &= ~(rank_mask & ((1ULL << (blocker + 1)) - 1));
-        }
-        move_mask |= possible;
-
-        // Looking up
-        possible = file_mask & (-(1ULL << (from + 1)));
-        blockers = allPieces & file_mask & possible;
-        if (blockers) {
-            int blocker = getLSB(blockers & possible);
-            possible &= ~(file_mask & (-(1ULL << blocker)));
-        }
-        move_mask |= possible;
-
-        // Looking down
-        possible = file_mask & ((1ULL << from) - 1);
-        blockers = allPieces & file_mask & possible;
-        if (blockers) {
-            int blocker = 63 - getLSB(blockers);
-            possible &= ~(file_mask & ((1ULL << (blocker + 1)) - 1));
-        }
-        move_mask |= possible;
-
-        // Bishop-like moves (diagonals)
-        // Northeast direction
-        possible = diagonal_mask & (-(1ULL << (from + 1)));
-        blockers = allPieces & diagonal_mask & possible;
-        if (blockers) {
-            int blocker = getLSB(blockers);
-            possible &= ~(-(1ULL << blocker));
-        }
-        move_mask |= possible;
-
-        // Southwest direction
-        possible = diagonal_mask & ((1ULL << from) - 1);
-        blockers = allPieces & diagonal_mask & possible;
-        if (blockers) {
-            int blocker = 63 - getLSB(blockers);
-            possible &= ~((1ULL << (blocker + 1)) - 1);
-        }
-        move_mask |= possible;
-
-        // Northwest direction
-        possible = anti_diagonal_mask & (-(1ULL << (from + 1)));
-        blockers = allPieces & anti_diagonal_mask & possible;
-        if (blockers) {
-            int blocker = getLSB(blockers);
-            possible &= ~(-(1ULL << blocker));
-        }
-        move_mask |= possible;
-
-        // Southeast direction
-        possible = anti_diagonal_mask & ((1ULL << from) - 1);
-        blockers = allPieces & anti_diagonal_mask & possible;
-        if (blockers) {
-            int blocker = 63 - getLSB(blockers);
-            possible &= ~((1ULL << (blocker + 1)) - 1);
-        }
-        move_mask |= possible;
+        uint64_t move_mask = Attacks::queen(from, allPieces);
 
-        // Remove moves to squares occupied by friendly pieces
-        if (!includeFriendly) move_mask &= ~friendly;
+        // Only the target squares the caller asked for
+        move_mask &= targets;
 
         // Add all valid moves to the moves vector
         while (move_mask) {
             int to = getLSB(move_mask);
-            move.push_back({(uint8_t)from, (uint8_t)to, 0});
+            move.push_back(Move(from, to));
             move_mask &= move_mask - 1;
         }
 
@@ -474,74 +302,166 @@ void GenerateQueenMoves(bool isWhite, std::vector<Move>& move, bool includeFrien
     }
 }
 
-    void GenerateKingMoves(bool isWhite, std::vector<Move>& move, bool includeFriendly = false) {
+    void GenerateKingMoves(bool isWhite, std::vector<Move>& move, uint64_t targets) {
     uint64_t King = isWhite ? board[WK] : board[BK];
-    uint64_t friendly = isWhite ? getWhitePieces() : getBlackPieces();
-    
+
     while (King) {
         int from = getLSB(King);
-        uint64_t move_mask = 0ULL;
-        
-        // Generate all possible moves
-        // Right
-        if (from % 8 != 7) {
-            move_mask |= 1ULL << (from + 1);
-            // Up-Right
-            if (from < 56) move_mask |= 1ULL << (from + 9);
-            // Down-Right
-            if (from > 7) move_mask |= 1ULL << (from - 7);
-        }
-        
-        // Left
-        if (from % 8 != 0) {
-            move_mask |= 1ULL << (from - 1);
-            // Up-Left
-            if (from < 56) move_mask |= 1ULL << (from + 7);
-            // Down-Left
-            if (from > 7) move_mask |= 1ULL << (from - 9);
-        }
-        
-        // Up (directly)
-        if (from < 56) move_mask |= 1ULL << (from + 8);
+        uint64_t move_mask = Attacks::king(from);
         
-        // Down (directly)
-        if (from > 7) move_mask |= 1ULL << (from - 8);
-        
-        // Remove moves to squares occupied by friendly pieces
-        if (!includeFriendly) move_mask &= ~friendly;
+        // Only the target squares the caller asked for
+        move_mask &= targets;
         
         // Add all valid moves to the moves vector
         while (move_mask) {
             int to = getLSB(move_mask);
-            move.push_back({(uint8_t)from, (uint8_t)to, 0});
+            move.push_back(Move(from, to));
             move_mask &= move_mask - 1;  // Clear least significant bit
         }
         
         King &= King - 1;  // Clear the current king bit (though there's only one king)
     }
 }
+    // Every piece's moves onto the target squares: pawn captures where
+    // targets hold enemies, pushes where they are empty
+    void GenerateTargets(bool isWhite, std::vector<Move>& list, uint64_t targets) {
+        uint64_t enemies = isWhite ? getBlackPieces() : getWhitePieces();
+        GeneratePawnMoves(isWhite, list, (targets & enemies) != 0, (targets & ~getAllPieces()) != 0);
+        GenerateKnightMoves(isWhite, list, targets);
+        GenerateRookMoves(isWhite, list, targets);
+        GenerateBishopMoves(isWhite, list, targets);
+        GenerateQueenMoves(isWhite, list, targets);
+        GenerateKingMoves(isWhite, list, targets);
+    }
+
     public:
     MoveGen(ChessBoard& boards) : board(boards){}
 
     std::vector<Move> GenerateMoves(bool isWhite) {
         moves.clear();
-        GeneratePawnMoves(isWhite);
-        GenerateKnightMoves(isWhite, moves);
-        GenerateRookMoves(isWhite, moves);
-        GenerateBishopMoves(isWhite, moves);
-        GenerateQueenMoves(isWhite, moves);
-        GenerateKingMoves(isWhite, moves);
+        GenerateTargets(isWhite, moves, ~(isWhite ? getWhitePieces() : getBlackPieces()));
         return moves;
     }
 
+    // Moves that take a piece, appended to the list. Pawn pushes are quiet.
+    void GenerateCaptures(bool isWhite, std::vector<Move>& list) {
+        GenerateTargets(isWhite, list, isWhite ? getBlackPieces() : getWhitePieces());
+    }
+
+    // Moves to empty squares, appended to the list
+    void GenerateQuiets(bool isWhite, std::vector<Move>& list) {
+        GenerateTargets(isWhite, list, ~getAllPieces());
+    }
+
+    // Whether a move from somewhere else (TT, killer slot) is one GenerateMoves
+    // would produce here, without generating anything
+    bool isPseudoLegal(const Move& move, bool isWhite) {
+        if (move.flag() != Move::Normal && !move.isPromotion()) {
+            return false;  // castling and en passant are not generated
+        }
+        int from = move.from(), to = move.to();
+        uint64_t fromBit = 1ULL << from, toBit = 1ULL << to;
+        uint64_t friendly = isWhite ? getWhitePieces() : getBlackPieces();
+        if (!(friendly & fromBit) || (friendly & toBit)) {
+            return false;
+        }
+        uint64_t allPieces = getAllPieces();
+        int base = isWhite ? WP : BP;
+
+        if (board[base] & fromBit) {
+            if (move.isPromotion() != (to >= 56 || to < 8)) {
+                return false;
+            }
+            if (allPieces & toBit) {
+                return Attacks::pawn(isWhite, from) & toBit;
+            }
+            int push = isWhite ? from + 8 : from - 8;
+            if (to == push) {
+                return true;
+            }
+            bool onStartRank = from / 8 == (isWhite ? 1 : 6);
+            return onStartRank && to == (isWhite ? from + 16 : from - 16) && !(allPieces & (1ULL << push));
+        }
+        if (move.isPromotion()) {
+            return false;
+        }
+        uint64_t reach = board[base + 1] & fromBit ? Attacks::knight(from)
+                       : board[base + 2] & fromBit ? Attacks::bishop(from, allPieces)
+                       : board[base + 3] & fromBit ? Attacks::rook(from, allPieces)
+                       : board[base + 4] & fromBit ? Attacks::queen(from, allPieces)
+                       : Attacks::king(from);
+        return reach & toBit;
+    }
+
+    // Squares the given pieces of one side attack, all of them together.
+    // type is WP .. WK, the colour comes from isWhite.
+    uint64_t attacksBy(bool isWhite, int type) {
+        uint64_t pieces = board[(isWhite ? WP : BP) + type % 6];
+        if (type % 6 == WP) {
+            return isWhite ? ((pieces & ~0x0101010101010101ULL) << 7) | ((pieces & ~0x8080808080808080ULL) << 9)
+                           : ((pieces & ~0x0101010101010101ULL) >> 9) | ((pieces & ~0x8080808080808080ULL) >> 7);
+        }
+        uint64_t allPieces = getAllPieces();
+        uint64_t attacks = 0;
+        while (pieces) {
+            int square = getLSB(pieces);
+            switch (type % 6) {
+                case WN: attacks |= Attacks::knight(square); break;
+                case WB: attacks |= Attacks::bishop(square, allPieces); break;
+                case WR: attacks |= Attacks::rook(square, allPieces); break;
+                case WQ: attacks |= Attacks::queen(square, allPieces); break;
+                default: attacks |= Attacks::king(square); break;
+            }
+            pieces &= pieces - 1;
+        }
+        return attacks;
+    }
+
+    // Every square one side attacks
+    uint64_t attacksBy(bool isWhite) {
+        uint64_t attacks = 0;
+        for (int type = WP; type <= WK; type++) {
+            attacks |= attacksBy(isWhite, type);
+        }
+        return attacks;
+    }
+
+    // Pieces of both sides that attack a square, with the given occupancy
+    // for the sliders. Pieces not in occupied are left out, so taking them
+    // off occupied shows what attacks through them (exchanges).
+    uint64_t attackersTo(int square, uint64_t occupied) {
+        uint64_t bishops = board[WB] | board[BB] | board[WQ] | board[BQ];
+        uint64_t rooks = board[WR] | board[BR] | board[WQ] | board[BQ];
+        return ((Attacks::pawn(false, square) & board[WP]) |
+                (Attacks::pawn(true, square) & board[BP]) |
+                (Attacks::knight(square) & (board[WN] | board[BN])) |
+                (Attacks::king(square) & (board[WK] | board[BK])) |
+                (Attacks::bishop(square, occupied) & bishops) |
+                (Attacks::rook(square, occupied) & rooks)) & occupied;
+    }
+
+    // Whether a piece of the side byWhite attacks the square
+    bool isSquareAttacked(int square, bool byWhite) {
+        int base = byWhite ? WP : BP;
+        if ((Attacks::pawn(!byWhite, square) & board[base]) ||
+            (Attacks::knight(square) & board[base + 1]) ||
+            (Attacks::king(square) & board[base + 5])) {
+            return true;
+        }
+        uint64_t allPieces = getAllPieces();
+        return (Attacks::bishop(square, allPieces) & (board[base + 2] | board[base + 4])) ||
+               (Attacks::rook(square, allPieces) & (board[base + 3] | board[base + 4]));
+    }
+
+    // The attacks as a move list, for printing. Use attacksBy in the engine.
     std::vector<Move> GenerateAttackVision(bool isWhite) {
         attack_vision.clear();
         GeneratePawnAttackVision(isWhite);
-        GenerateKnightMoves(isWhite, attack_vision, true);
-        GenerateRookMoves(isWhite, attack_vision, true);
-        GenerateBishopMoves(isWhite, attack_vision, true);
-        GenerateQueenMoves(isWhite, attack_vision, true);
-        GenerateKingMoves(isWhite, attack_vision, true);
+        GenerateKnightMoves(isWhite, attack_vision, ~0ULL);
+        GenerateRookMoves(isWhite, attack_vision, ~0ULL);
+        GenerateBishopMoves(isWhite, attack_vision, ~0ULL);
+        GenerateQueenMoves(isWhite, attack_vision, ~0ULL);
+        GenerateKingMoves(isWhite, attack_vision, ~0ULL);
         return attack_vision;
     }
 };
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "movegen.hpp"
+
+// The rules the engine's pseudo-legal generator leaves out, for code that
+// plays whole games: the match runner and the game host. The search does
+// not need them, it scores a captured king as mate.
+namespace Referee {
+
+inline bool inCheck(ChessBoard& board, bool white) {
+    uint64_t king = board[white ? WK : BK];
+    return king && MoveGen(board).isSquareAttacked(getLSB(king), !white);
+}
+
+// Plays a move, queening a pawn that reaches the last rank without saying
+// what it becomes. Returns whether it was a capture or pawn move,
+// which resets the 50 move counter.
+inline bool play(ChessBoard& board, const Move& move, bool white) {
+    uint64_t fromBit = 1ULL << move.from(), toBit = 1ULL << move.to();
+    int friendly = white ? WP : BP, enemy = white ? BP : WP;
+    bool irreversible = board[friendly] & fromBit;
+    for (int piece = enemy; piece < enemy + 6; piece++) {
+        if (board[piece] & toBit) {
+            board[piece] &= ~toBit;
+            irreversible = true;
+        }
+    }
+    for (int piece = friendly; piece < friendly + 6; piece++) {
+        if (board[piece] & fromBit) {
+            int arriving = piece;
+            if (piece == friendly && (move.to() >= 56 || move.to() < 8)) {
+                arriving = friendly + (move.isPromotion() ? move.promotionType() : WQ - WP);
+            }
+            board[piece] &= ~fromBit;
+            board[arriving] |= toBit;
+            break;
+        }
+    }
+    return irreversible;
+}
+
+inline std::vector<Move> legalMoves(ChessBoard& board, bool white) {
+    std::vector<Move> legal;
+    for (const Move& move : MoveGen(board).GenerateMoves(white)) {
+        ChessBoard next = board;
+        play(next, move, white);
+        if (!inCheck(next, white)) {
+            legal.push_back(move);
+        }
+    }
+    return legal;
+}
+
+inline bool isLegal(ChessBoard& board, const Move& move, bool white) {
+    std::vector<Move> legal = legalMoves(board, white);
+    return std::find(legal.begin(), legal.end(), move) != legal.end();
+}
+
+// The legal move written as "e2e4" or "e7e8n", or nullptr. A promotion
+// without its piece is the queen one, which the generator puts first.
+inline const Move* findMove(const std::vector<Move>& legal, const std::string& text) {
+    for (const Move& move : legal) {
+        std::string name = moveToString(move);
+        if (text.size() > 4 ? text == name : text.compare(0, 4, name, 0, 4) == 0) {
+            return &move;
+        }
+    }
+    return nullptr;
+}
+
+inline bool insufficientMaterial(const ChessBoard& board) {
+    if (board[WP] | board[BP] | board[WR] | board[BR] | board[WQ] | board[BQ]) {
+        return false;
+    }
+    return std::popcount(board[WN] | board[BN] | board[WB] | board[BB]) <= 1;
+}
+
+}  // namespace Referee
@@ -1,178 +1,775 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bitbase.hpp"
 #include "board.hpp"
+#include "move_picker.hpp"
 #include "movegen.hpp"
+#include "search_stats.hpp"
+#include "search_trace.hpp"
+#include "syzygy.hpp"
+#include "timeman.hpp"
+#include "transposition.hpp"
 #include "../eval/evaluation.hpp"
+#include "../network/book.hpp"
+#include "../utils/zobrist.hpp"
+
+// Reported after every completed iteration of the iterative deepening loop
+struct SearchInfo {
+    int depth;
+    double score;      // from white's point of view, like evaluate(true)
+    uint64_t nodes;
+    int64_t timeMs;
+    std::vector<Move> pv;
+    int multiPV{1};    // rank of this line, 1 = best
+    uint64_t tbHits{0};
+};
 
 class MinimaxSearch {
 private:
     ChessBoard& board;
     MoveGen& moveGen;
     Evaluation& evaluator;
-    static constexpr int MAX_DEPTH = 10;  // Adjust based on desired search depth
-
-    // Helper function to make a move on the board
-    void makeMove(const Move& move, bool isWhite) {
-        uint64_t fromBit = 1ULL << move.from;
-        uint64_t toBit = 1ULL << move.to;
-        
-        // Find which piece is moving
-        for (int piece = 0; piece < 12; piece++) {
-            if (board[piece] & fromBit) {
-                // Remove piece from source square
-                board[piece] &= ~fromBit;
-                // Add piece to destination square
-                board[piece] |= toBit;
-                break;
+    static constexpr int MAX_DEPTH = 5;  // Adjust based on desired search depth
+    static constexpr int MAX_PLY = 64;
+    static_assert(SearchStats::MAX_PLY >= MAX_PLY, "stats.plyNodes is indexed by the search ply");
+
+    // Our own table, unless useHashTable points tt at someone else's
+    TranspositionTable ownTable;
+    TranspositionTable* tt{&ownTable};
+    TimeManager timeManager;
+    SearchLimits limits;
+    std::function<void(const SearchInfo&)> infoCallback;
+
+    // Written by the GUI thread while the search thread runs
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> pondering{false};
+    bool prepared{false};
+
+    uint64_t nodes{0};
+    uint64_t hash{0};
+    uint64_t materialKey{0};  // MaterialTable::key of the board, kept up to date like hash
+    Move pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    std::vector<Move> rootPV;
+
+    // MultiPV: the root is searched once per line, each pass skipping the
+    // first moves of the lines already found. Later passes mostly run on
+    // subtrees the TT and history tables already know from earlier passes.
+    int multiPV{1};
+    std::vector<Move> excludedRootMoves;
+    std::vector<SearchInfo> rankedLines;
+
+    // Quiet moves that caused a cutoff, by side / from / to
+    int history[2][64][64]{};
+
+    // Last two quiet moves that cut off at each ply, tried right after the
+    // captures since siblings tend to be refuted by the same move
+    Move killers[MAX_PLY][2];
+
+    // Move lists of the MovePicker at each ply, kept to reuse their memory
+    std::vector<Move> plyMoves[MAX_PLY];
+    std::vector<int> plyScores[MAX_PLY];
+
+    const BookSource* book{nullptr};
+    std::mt19937_64 bookRandom{std::random_device{}()};
+
+    const Bitbases* bitbases{nullptr};
+
+    // Syzygy: WDL probes in the tree from syzygyProbeDepth on, DTZ at the root
+    // to keep only the moves that hold the result
+    const SyzygyTablebases* syzygy{nullptr};
+    int syzygyProbeDepth{1};
+    int syzygyProbeLimit{SyzygyTablebases::MAX_PIECES};
+    uint64_t tbHits{0};
+    std::vector<Move> tbRootMoves;
+
+    SearchStats stats;
+
+    // Tree tracer, see search_trace.hpp. tracePath holds the moves of the
+    // current line so every event knows its move and root move.
+    std::unique_ptr<SearchTracer> tracer;
+    Move tracePath[MAX_PLY];
+    int traceIteration{0};
+    char traceFen[MAX_FEN_LENGTH]{};  // root of the traced search, no allocation to race with a dump
+    FenState traceState;               // castling, en passant and clocks from setRootState()
+    bool traceStateSet{false};
+
+    // Weighted random pick among the book moves for this position. Moves
+    // we cannot play here (key collision, corrupt book) are skipped.
+    bool probeBook(const std::vector<Move>& moves, Move& out) {
+        BookMove candidates[32];
+        int count = book->probe(hash, candidates, 32);
+        uint32_t totalWeight = 0;
+        for (int i = 0; i < count; i++) {
+            if (std::find(moves.begin(), moves.end(), candidates[i].move) == moves.end()) {
+                candidates[i].weight = 0;
             }
+            totalWeight += candidates[i].weight;
         }
-        
-        // Handle captures
-        uint64_t opposingPieces = isWhite ? 
-            (board[BP] | board[BN] | board[BB] | board[BR] | board[BQ] | board[BK]) :
-            (board[WP] | board[WN] | board[WB] | board[WR] | board[WQ] | board[WK]);
-            
-        if (toBit & opposingPieces) {
-            // Remove captured piece
-            for (int piece = 0; piece < 12; piece++) {
-                if (board[piece] & toBit) {
-                    board[piece] &= ~toBit;
-                    break;
-                }
+        if (totalWeight == 0) {
+            return false;
+        }
+
+        uint32_t pick = std::uniform_int_distribution<uint32_t>(0, totalWeight - 1)(bookRandom);
+        for (int i = 0; i < count; i++) {
+            if (pick < candidates[i].weight) {
+                out = candidates[i].move;
+                return true;
             }
+            pick -= candidates[i].weight;
         }
+        return false;
     }
 
-    // Helper function to unmake a move
-    void unmakeMove(const Move& move, bool isWhite, uint64_t capturedPiece = 0) {
-        uint64_t fromBit = 1ULL << move.from;
-        uint64_t toBit = 1ULL << move.to;
-        
-        // Find which piece is moving
-        for (int piece = 0; piece < 12; piece++) {
-            if (board[piece] & toBit) {
-                // Remove piece from destination square
-                board[piece] &= ~toBit;
-                // Add piece back to source square
-                board[piece] |= fromBit;
-                break;
+    // Mate scores are stored relative to the node in the TT, not the root
+    static double scoreToTT(double score, int ply) {
+        if (score >= MATE_BOUND) return score + ply;
+        if (score <= -MATE_BOUND) return score - ply;
+        return score;
+    }
+
+    static double scoreFromTT(double score, int ply) {
+        if (score >= MATE_BOUND) return score - ply;
+        if (score <= -MATE_BOUND) return score + ply;
+        return score;
+    }
+
+    // Old cutoffs still say something about the position, just less
+    void ageHistory() {
+        for (auto& side : history) {
+            for (auto& from : side) {
+                for (int& score : from) {
+                    score /= 8;
+                }
             }
         }
-        
-        // Restore captured piece if any
-        if (capturedPiece) {
-            for (int piece = 0; piece < 12; piece++) {
-                if (capturedPiece & (1ULL << piece)) {
-                    board[piece] |= toBit;
-                    break;
-                }
+    }
+
+    // Exact result for small endgames, or false if no bitbase covers it. A
+    // win scores far above any evaluation, plus the evaluation so the search
+    // still makes progress towards mate instead of shuffling between wins.
+    bool probeBitbase(bool isWhite, int ply, double& score) {
+        uint64_t occupied = 0;
+        for (const auto& bitboard : board) {
+            occupied |= bitboard;
+        }
+        if (Cpu::popcount(occupied) > bitbases->maxPieces()) {
+            return false;
+        }
+        // The last (pseudo-legal) move left its own king in check, which the
+        // bitbase has no value for. Evaluating such a leaf would make moving
+        // into check look fine; the king is taken next move, score it so.
+        uint64_t theirKing = board[isWhite ? BK : WK];
+        if (theirKing && moveGen.isSquareAttacked(getLSB(theirKing), isWhite)) {
+            score = isWhite ? MATE_SCORE - (ply + 1) : -(MATE_SCORE - (ply + 1));
+            return true;
+        }
+        Wdl wdl = bitbases->probe(board, isWhite);
+        if (wdl == Wdl::Illegal) {
+            return false;
+        }
+        SEARCH_STAT(stats.bitbaseHits++);
+        if (wdl == Wdl::Draw) {
+            score = 0.0;
+        } else {
+            bool whiteWins = (wdl == Wdl::Win) == isWhite;
+            score = (whiteWins ? TB_WIN : -TB_WIN) + evaluator.evaluate(true, materialKey);
+        }
+        return true;
+    }
+
+    // The rook half of a castling move, its own inverse
+    void moveCastlingRook(const Move& move, int rook) {
+        int rank = move.from() & 56;
+        bool kingSide = move.to() > move.from();
+        int rookFrom = rank + (kingSide ? 7 : 0);
+        int rookTo = rank + (kingSide ? 5 : 3);
+        board[rook] ^= (1ULL << rookFrom) | (1ULL << rookTo);
+        hash ^= Zobrist::piece(rook, rookFrom) ^ Zobrist::piece(rook, rookTo);
+    }
+
+    int pieceCount() const {
+        uint64_t occupied = 0;
+        for (const auto& bitboard : board) {
+            occupied |= bitboard;
+        }
+        return Cpu::popcount(occupied);
+    }
+
+    bool syzygyCovers() const {
+        return syzygy && pieceCount() <= std::min(syzygyProbeLimit, syzygy->maxPieces());
+    }
+
+    // WDL probe for an inner node. Wins that the 50 move rule spoils are
+    // scored as a hair better than a draw.
+    bool probeSyzygy(bool isWhite, int ply, double& score) {
+        SyzygyTablebases::ProbeState state;
+        SEARCH_STAT(stats.tbProbes++);
+        int wdl = syzygy->probeWdl({board, isWhite}, state);
+        if (state == SyzygyTablebases::ProbeState::Fail) {
+            return false;
+        }
+        tbHits++;
+        double relative = wdl == 2 ? TB_WIN - ply : wdl == -2 ? -(TB_WIN - ply) : wdl * 0.01;
+        score = isWhite ? relative : -relative;
+        return true;
+    }
+
+    // Ranks the root moves by DTZ and keeps the best class: the fastest
+    // zeroing win, else the draws, else the longest loss
+    void filterRootMoves(bool isWhite) {
+        tbRootMoves.clear();
+        SyzygyTablebases::ProbeState state;
+        auto ranked = syzygy->rankRootMoves({board, isWhite}, state);
+        if (ranked.empty()) {
+            return;
+        }
+        tbHits += ranked.size();
+
+        auto better = [](int a, int b) {
+            if ((a > 0) != (b > 0)) return a > 0;
+            if (a > 0) return a < b;                 // quicker win
+            if ((a == 0) != (b == 0)) return a == 0;  // draw over loss
+            return a < b;                            // longer loss
+        };
+        int best = ranked[0].second;
+        for (const auto& [move, dtz] : ranked) {
+            if (better(dtz, best)) best = dtz;
+        }
+        for (const auto& [move, dtz] : ranked) {
+            if (dtz == best && std::find(tbRootMoves.begin(), tbRootMoves.end(), move.move) == tbRootMoves.end()) {
+                tbRootMoves.push_back(move.move);
             }
         }
     }
 
-    double minimax(int depth, bool isWhite, double alpha, double beta) {
-        if (depth == 0) {
-            return evaluator.evaluate(isWhite);
+    void traceNode(int ply, int depth, double alpha, double beta, double score, TraceKind kind) {
+        if (!tracer) {
+            return;
         }
+        TraceEvent event;
+        event.key = static_cast<uint32_t>(hash >> 32);
+        event.alpha = static_cast<float>(alpha);
+        event.beta = static_cast<float>(beta);
+        event.score = static_cast<float>(score);
+        event.move = ply > 0 ? tracePath[ply - 1].raw() : 0;
+        event.rootMove = ply > 0 ? tracePath[0].raw() : 0;
+        event.ply = static_cast<uint8_t>(ply);
+        event.depth = static_cast<int8_t>(depth);
+        event.kind = kind;
+        event.iteration = static_cast<uint8_t>(traceIteration);
+        tracer->record(event);
+    }
 
-        std::vector<Move> moves = moveGen.GenerateMoves(isWhite);
-        if (moves.empty()) {
-            // If no moves are available, this might be checkmate or stalemate
-            return isWhite ? -1.0 : 1.0;  // Return worst score for the current player
+    void checkLimits() {
+        if (limits.nodes > 0 && nodes >= limits.nodes) {
+            stopRequested = true;
+        }
+        // While pondering the clock is not ours, only ponderhit or stop end it
+        if (!pondering && timeManager.hardLimitReached()) {
+            stopRequested = true;
         }
+    }
 
-        double bestValue = isWhite ? -std::numeric_limits<double>::infinity() 
-                                 : std::numeric_limits<double>::infinity();
+    double minimax(int depth, int ply, bool isWhite, double alpha, double beta) {
+        pvLength[ply] = 0;
+        if ((++nodes & 1023) == 0) {
+            checkLimits();
+        }
+        if (stopRequested) {
+            return 0.0;
+        }
+        SEARCH_STAT(stats.plyNodes[ply]++);
 
-        for (const Move& move : moves) {
-            // Store state before move
-            uint64_t capturedPiece = 0;
-            for (int piece = 0; piece < 12; piece++) {
-                if (board[piece] & (1ULL << move.to)) {
-                    capturedPiece = board[piece] & (1ULL << move.to);
-                    break;
+        // Moves are pseudo-legal, so a king can get captured. Losing the king
+        // is scored as being mated, sooner is worse.
+        if (!board[isWhite ? WK : BK]) {
+            double mated = isWhite ? -(MATE_SCORE - ply) : (MATE_SCORE - ply);
+            SEARCH_TRACE(traceNode(ply, depth, alpha, beta, mated, TraceKind::KingCaptured));
+            return mated;
+        }
+
+        if (depth == 0 || ply >= MAX_PLY - 1) {
+            double score;
+            if (bitbases && probeBitbase(isWhite, ply, score)) {
+                SEARCH_TRACE(traceNode(ply, depth, alpha, beta, score, TraceKind::Bitbase));
+                return score;
+            }
+            SEARCH_STAT(stats.leafNodes++);
+            score = evaluator.evaluate(true, materialKey);
+            SEARCH_TRACE(traceNode(ply, depth, alpha, beta, score, TraceKind::Leaf));
+            return score;
+        }
+
+        double alphaOrig = alpha;
+        double betaOrig = beta;
+        Move ttMove{};
+        bool hasTTMove = false;
+        TTEntry entry;
+        SEARCH_STAT(stats.ttProbes++);
+        if (tt->probe(hash, entry)) {
+            SEARCH_STAT(stats.ttHits++);
+            ttMove = entry.bestMove;
+            hasTTMove = true;
+            // Never cut at the root, we always want a full PV there
+            if (ply > 0 && entry.depth >= depth) {
+                double ttScore = scoreFromTT(entry.score, ply);
+                if (entry.bound == Bound::Lower) alpha = std::max(alpha, ttScore);
+                if (entry.bound == Bound::Upper) beta = std::min(beta, ttScore);
+                if (entry.bound == Bound::Exact || alpha >= beta) {
+                    SEARCH_STAT(stats.ttCutoffs++);
+                    SEARCH_TRACE(traceNode(ply, depth, alphaOrig, betaOrig, ttScore, TraceKind::TTCutoff));
+                    return ttScore;
                 }
             }
+        }
+
+        if (ply > 0 && depth >= syzygyProbeDepth && syzygyCovers()) {
+            double tbScore;
+            if (probeSyzygy(isWhite, ply, tbScore)) {
+                SEARCH_TRACE(traceNode(ply, depth, alpha, beta, tbScore, TraceKind::Tablebase));
+                return tbScore;
+            }
+        }
+
+        MovePicker picker(moveGen, board, plyMoves[ply], plyScores[ply], history[isWhite], isWhite,
+                          hasTTMove ? &ttMove : nullptr, killers[ply]);
+
+        double bestValue = isWhite ? -std::numeric_limits<double>::infinity()
+                                 : std::numeric_limits<double>::infinity();
+        Move bestMove;
+        bool anyMove = false;
+
+        bool excluding = ply == 0 && !excludedRootMoves.empty();
+        SEARCH_STAT(int movesSearched = 0);
+        Move move;
+        while (picker.next(move)) {
+            if (!anyMove) {
+                bestMove = move;
+                anyMove = true;
+            }
+            if (excluding && std::find(excludedRootMoves.begin(), excludedRootMoves.end(), move)
+                                 != excludedRootMoves.end()) {
+                continue;
+            }
+            if (ply == 0 && !tbRootMoves.empty() &&
+                std::find(tbRootMoves.begin(), tbRootMoves.end(), move) == tbRootMoves.end()) {
+                continue;
+            }
 
-            // Make move
-            makeMove(move, isWhite);
-            
-            // Recursive evaluation
-            double value = minimax(depth - 1, !isWhite, alpha, beta);
-            
-            // Unmake move
-            unmakeMove(move, isWhite, capturedPiece);
+            SEARCH_STAT(movesSearched++);
+            SEARCH_TRACE(tracePath[ply] = move);
+            int captured = makeMove(move, isWhite);
+            double value = minimax(depth - 1, ply + 1, !isWhite, alpha, beta);
+            unmakeMove(move, isWhite, captured);
+
+            if (stopRequested) {
+                return 0.0;
+            }
 
             // Update best value
+            if (isWhite ? value > bestValue : value < bestValue) {
+                bestValue = value;
+                bestMove = move;
+                pvTable[ply][0] = move;
+                std::copy(pvTable[ply + 1], pvTable[ply + 1] + pvLength[ply + 1], pvTable[ply] + 1);
+                pvLength[ply] = pvLength[ply + 1] + 1;
+                // Even the best move gets our king taken: we are mated here,
+                // and the PV ends with the move before instead of going on
+                // with an illegal reply and the king capture
+                if (ply > 0 && value == (isWhite ? -(MATE_SCORE - (ply + 2)) : MATE_SCORE - (ply + 2))) {
+                    pvLength[ply] = 0;
+                }
+            }
             if (isWhite) {
-                bestValue = std::max(bestValue, value);
                 alpha = std::max(alpha, bestValue);
             } else {
-                bestValue = std::min(bestValue, value);
                 beta = std::min(beta, bestValue);
             }
 
             // Alpha-beta pruning
             if (beta <= alpha) {
+                SEARCH_STAT(stats.betaCutoffs++);
+                SEARCH_STAT(stats.firstMoveCutoffs += movesSearched == 1);
+                if (captured < 0) {
+                    history[isWhite][move.from()][move.to()] += depth * depth;
+                    if (!(killers[ply][0] == move)) {
+                        killers[ply][1] = killers[ply][0];
+                        killers[ply][0] = move;
+                    }
+                }
+                SEARCH_STAT(stats.quietGenerationsSkipped += picker.stage() < MovePicker::Quiets);
                 break;
             }
         }
 
+        if (!anyMove) {
+            // If no moves are available, this might be checkmate or stalemate
+            double worst = isWhite ? -1.0 : 1.0;  // Return worst score for the current player
+            SEARCH_TRACE(traceNode(ply, depth, alphaOrig, betaOrig, worst, TraceKind::NoMoves));
+            return worst;
+        }
+
+        // A root searched with moves left out did not see the whole position
+        if (!excluding) {
+            Bound bound = bestValue <= alphaOrig ? Bound::Upper
+                        : bestValue >= betaOrig ? Bound::Lower
+                        : Bound::Exact;
+            tt->store(hash, depth, scoreToTT(bestValue, ply), bound, bestMove);
+            SEARCH_STAT(stats.ttStores++);
+        }
+        // Fail low is from the side to move's point of view, white raises alpha
+        SEARCH_TRACE(bool failedLow = isWhite ? bestValue <= alphaOrig : bestValue >= betaOrig);
+        SEARCH_TRACE(traceNode(ply, depth, alphaOrig, betaOrig, bestValue,
+                               beta <= alpha ? TraceKind::Cutoff
+                               : failedLow   ? TraceKind::FailLow
+                                             : TraceKind::Exact));
         return bestValue;
     }
 
 public:
-    MinimaxSearch(ChessBoard& b, MoveGen& mg, Evaluation& eval) 
-        : board(b), moveGen(mg), evaluator(eval) {}
+    static constexpr double MATE_SCORE = 10000.0;
+    static constexpr double MATE_BOUND = MATE_SCORE - MAX_PLY;
+    static constexpr double TB_WIN = 1000.0;  // bitbase / tablebase win, below any mate
+
+    // hashMegabytes sizes our own table; 0 leaves it a single entry, for a
+    // search that always runs on someone else's (useHashTable)
+    MinimaxSearch(ChessBoard& b, MoveGen& mg, Evaluation& eval, size_t hashMegabytes = 16)
+        : board(b), moveGen(mg), evaluator(eval), ownTable(hashMegabytes) {}
+
+    // Plays a move on the board, returns the captured piece or -1
+    int makeMove(const Move& move, bool isWhite) {
+        uint64_t fromBit = 1ULL << move.from();
+        uint64_t toBit = 1ULL << move.to();
+        int friendly = isWhite ? WP : BP;
+        int enemy = isWhite ? BP : WP;
+
+        // Handle captures, only the opponent's pieces can be on the target
+        // square (or behind it for en passant)
+        int captureSquare = move.isEnPassant() ? move.to() + (isWhite ? -8 : 8) : move.to();
+        int captured = -1;
+        for (int piece = enemy; piece < enemy + 6; piece++) {
+            if (board[piece] & (1ULL << captureSquare)) {
+                board[piece] &= ~(1ULL << captureSquare);
+                hash ^= Zobrist::piece(piece, captureSquare);
+                materialKey -= MaterialTable::pieceKey(piece);
+                captured = piece;
+                break;
+            }
+        }
+
+        // Find which piece is moving, a promoting pawn arrives as its new piece
+        for (int piece = friendly; piece < friendly + 6; piece++) {
+            if (board[piece] & fromBit) {
+                int arriving = move.isPromotion() ? friendly + move.promotionType() : piece;
+                board[piece] &= ~fromBit;
+                board[arriving] |= toBit;
+                hash ^= Zobrist::piece(piece, move.from()) ^ Zobrist::piece(arriving, move.to());
+                materialKey += MaterialTable::pieceKey(arriving) - MaterialTable::pieceKey(piece);
+                break;
+            }
+        }
+
+        if (move.isCastling()) {
+            moveCastlingRook(move, friendly + 3);
+        }
+
+        hash ^= Zobrist::sideToMove();
+        return captured;
+    }
+
+    // Takes back a move played by makeMove
+    void unmakeMove(const Move& move, bool isWhite, int capturedPiece = -1) {
+        uint64_t fromBit = 1ULL << move.from();
+        uint64_t toBit = 1ULL << move.to();
+        int friendly = isWhite ? WP : BP;
+
+        if (move.isPromotion()) {
+            int promoted = friendly + move.promotionType();
+            board[promoted] &= ~toBit;
+            board[friendly] |= fromBit;
+            hash ^= Zobrist::piece(promoted, move.to()) ^ Zobrist::piece(friendly, move.from());
+            materialKey += MaterialTable::pieceKey(friendly) - MaterialTable::pieceKey(promoted);
+        } else {
+            for (int piece = friendly; piece < friendly + 6; piece++) {
+                if (board[piece] & toBit) {
+                    board[piece] ^= fromBit | toBit;
+                    hash ^= Zobrist::piece(piece, move.from()) ^ Zobrist::piece(piece, move.to());
+                    break;
+                }
+            }
+        }
+
+        if (move.isCastling()) {
+            moveCastlingRook(move, friendly + 3);
+        }
+
+        // Restore captured piece if any
+        if (capturedPiece >= 0) {
+            int captureSquare = move.isEnPassant() ? move.to() + (isWhite ? -8 : 8) : move.to();
+            board[capturedPiece] |= 1ULL << captureSquare;
+            hash ^= Zobrist::piece(capturedPiece, captureSquare);
+            materialKey += MaterialTable::pieceKey(capturedPiece);
+        }
+
+        hash ^= Zobrist::sideToMove();
+    }
+
+    // Iterative deepening until the limits say stop. A ponder search runs
+    // untimed until ponderHit() turns it into a normal timed search (same
+    // tree, same TT), or stop() ends it. Ponder and infinite searches only
+    // return once one of those arrives, as UCI requires.
+    Move search(bool isWhite, const SearchLimits& searchLimits) {
+        if (!prepared) {
+            prepare(searchLimits);
+        }
+        prepared = false;
+        timeManager.init(limits, isWhite);
+        nodes = 0;
+        tbHits = 0;
+        SEARCH_STAT(stats.clear());
+        SEARCH_TRACE(if (tracer) {
+            tracer->clear();
+            FenState rootState = traceState;
+            if (!traceStateSet) {
+                rootState.castling = castlingFromPlacement(board);
+            }
+            rootState.whiteToMove = isWhite;
+            traceFen[writeFen(board, rootState, traceFen)] = '\0';
+        });
+        traceStateSet = false;
+        hash = Zobrist::hash(board, isWhite);
+        materialKey = MaterialTable::key(board);
+        rootPV.clear();
+        rankedLines.clear();
+        ageHistory();
+        tt->newSearch();
+        std::fill(&killers[0][0], &killers[0][0] + MAX_PLY * 2, Move());
 
-    Move findBestMove(bool isWhite) {
         std::vector<Move> moves = moveGen.GenerateMoves(isWhite);
         if (moves.empty()) {
             throw std::runtime_error("No moves available");
         }
-
         Move bestMove = moves[0];
-        double bestValue = isWhite ? -std::numeric_limits<double>::infinity() 
-                                 : std::numeric_limits<double>::infinity();
-        double alpha = -std::numeric_limits<double>::infinity();
-        double beta = std::numeric_limits<double>::infinity();
-
-        for (const Move& move : moves) {
-            // Store state before move
-            uint64_t capturedPiece = 0;
-            for (int piece = 0; piece < 12; piece++) {
-                if (board[piece] & (1ULL << move.to)) {
-                    capturedPiece = board[piece] & (1ULL << move.to);
+
+        // Known opening positions are played from the book without searching.
+        // Analysis (infinite, ponder, MultiPV) always searches.
+        if (book && !limits.infinite && !limits.ponder && multiPV == 1 && probeBook(moves, bestMove)) {
+            rootPV = {bestMove};
+            rankedLines = {SearchInfo{0, 0.0, 0, timeManager.elapsedMs(), rootPV, 1}};
+            return bestMove;
+        }
+
+        tbRootMoves.clear();
+        if (syzygyCovers()) {
+            filterRootMoves(isWhite);
+        }
+
+        int lineCount = std::min<int>(multiPV, static_cast<int>(tbRootMoves.empty() ? moves.size() : tbRootMoves.size()));
+
+        int maxDepth = limits.depth > 0 ? std::min(limits.depth, MAX_PLY - 1) : MAX_PLY - 1;
+        for (int depth = 1; depth <= maxDepth; depth++) {
+            SEARCH_TRACE(traceIteration = depth);
+            SEARCH_STAT(uint64_t iterationNodes = nodes);
+            SEARCH_STAT(int64_t iterationStartMs = timeManager.elapsedMs());
+            std::vector<SearchInfo> lines;
+            excludedRootMoves.clear();
+            for (int line = 0; line < lineCount; line++) {
+                double score = minimax(depth, 0, isWhite,
+                                       -std::numeric_limits<double>::infinity(),
+                                       std::numeric_limits<double>::infinity());
+                if (stopRequested || pvLength[0] == 0) {
                     break;
                 }
+
+                std::vector<Move> pv(pvTable[0], pvTable[0] + pvLength[0]);
+                excludedRootMoves.push_back(pv[0]);
+                lines.push_back({depth, score, nodes, timeManager.elapsedMs(), pv, line + 1, tbHits});
+                if (infoCallback) {
+                    infoCallback(lines.back());
+                }
             }
+            excludedRootMoves.clear();
+            SEARCH_STAT(stats.iterations.push_back({depth, nodes - iterationNodes,
+                                                    timeManager.elapsedMs() - iterationStartMs}));
 
-            // Make move
-            makeMove(move, isWhite);
-            
-            // Evaluate position after move
-            double value = minimax(MAX_DEPTH - 1, !isWhite, alpha, beta);
-            
-            // Unmake move
-            unmakeMove(move, isWhite, capturedPiece);
+            // An unfinished iteration is thrown away, unless it is all we have
+            if (stopRequested && !rootPV.empty()) {
+                break;
+            }
+            if (!lines.empty()) {
+                rankedLines = lines;
+                rootPV = lines[0].pv;
+            } else if (pvLength[0] > 0) {
+                rootPV.assign(pvTable[0], pvTable[0] + pvLength[0]);
+            }
+            if (!rootPV.empty()) {
+                bestMove = rootPV[0];
+            }
+            if (stopRequested) {
+                break;
+            }
 
-            // Update best move if necessary
-            if (isWhite) {
-                if (value > bestValue) {
-                    bestValue = value;
-                    bestMove = move;
-                }
-                alpha = std::max(alpha, bestValue);
-            } else {
-                if (value < bestValue) {
-                    bestValue = value;
-                    bestMove = move;
-                }
-                beta = std::min(beta, bestValue);
+            if (!rankedLines.empty() && std::abs(rankedLines[0].score) >= MATE_BOUND) {
+                break;
+            }
+            if (!pondering && timeManager.softLimitReached()) {
+                break;
             }
         }
 
+        SEARCH_STAT(stats.nodes = nodes);
+        SEARCH_STAT(stats.tbHits = tbHits);
+
+        while ((pondering || limits.infinite) && !stopRequested) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
         return bestMove;
     }
-};
\ No newline at end of file
+
+    // Resets the stop / ponder flags for the next search(). search() does it
+    // itself, but a caller starting search() on another thread has to do it
+    // first, or a "stop" or "ponderhit" sent right after "go" gets lost.
+    void prepare(const SearchLimits& searchLimits) {
+        limits = searchLimits;
+        stopRequested = false;
+        pondering = limits.ponder;
+        prepared = true;
+    }
+
+    Move findBestMove(bool isWhite) {
+        SearchLimits fixedDepth;
+        fixedDepth.depth = MAX_DEPTH;
+        return search(isWhite, fixedDepth);
+    }
+
+    // Called from another thread while search() runs
+    void stop() {
+        stopRequested = true;
+    }
+
+    // The opponent played the move we pondered on: start our clock now and
+    // let the search carry on with its current iteration as a timed search
+    void ponderHit() {
+        timeManager.start();
+        pondering = false;
+    }
+
+    void setInfoCallback(std::function<void(const SearchInfo&)> callback) {
+        infoCallback = std::move(callback);
+    }
+
+    // Number of ranked root lines to search and report, 1 = normal search
+    void setMultiPV(int lines) {
+        multiPV = std::max(1, lines);
+    }
+
+    // All lines of the last completed iteration, best first
+    const std::vector<SearchInfo>& multiPVLines() const {
+        return rankedLines;
+    }
+
+    // Book to consult before searching, nullptr to always search
+    void setBook(const BookSource* openingBook) {
+        book = openingBook;
+    }
+
+    // Endgame bitbases probed at the leaves, nullptr to turn them off
+    void setBitbases(const Bitbases* tables) {
+        bitbases = tables;
+    }
+
+    // Syzygy tables, probed in nodes at least probeDepth from the horizon
+    // with at most probeLimit pieces. nullptr turns them off.
+    void setSyzygy(const SyzygyTablebases* tables, int probeDepth, int probeLimit) {
+        syzygy = tables;
+        syzygyProbeDepth = probeDepth;
+        syzygyProbeLimit = probeLimit;
+    }
+
+    // Searches with another table from now on, nullptr goes back to our
+    // own. The game host gives each game its own table this way, or all of
+    // them one shared table (the entries are safe to share between threads,
+    // see TTEntry). Hash size, clear and file calls then act on that table.
+    void useHashTable(TranspositionTable* table) {
+        tt = table ? table : &ownTable;
+    }
+
+    // False when a hash file could not take the new size and the table
+    // went back to memory, with the reason in error
+    bool setHashSize(size_t megabytes, const char** error = nullptr) {
+        return tt->resize(megabytes, error);
+    }
+
+    void clearHash() {
+        tt->clear();
+    }
+
+    // Keeps the hash table in a file, see TranspositionTable::attachFile.
+    // An empty path goes back to a table in memory.
+    bool setHashFile(const std::string& path, const char** error = nullptr) {
+        if (path.empty()) {
+            tt->detachFile();
+            return true;
+        }
+        return tt->attachFile(path, tt->megabytes(), error);
+    }
+
+    // PV of the last completed iteration, pv[1] is the move to ponder on
+    const std::vector<Move>& principalVariation() const {
+        return rootPV;
+    }
+
+    uint64_t nodeCount() const {
+        return nodes;
+    }
+
+    // Records the last `events` nodes of every search from now on, 0 turns
+    // the tracer off. Does nothing in a build without the tracer.
+    void setTrace(size_t events) {
+        SEARCH_TRACE(tracer = events ? std::make_unique<SearchTracer>(events) : nullptr);
+        (void)events;
+    }
+
+    // Castling rights, en passant square and clocks of the next search's
+    // root, so the trace can replay it exactly. Without it the trace takes
+    // the castling rights from where the kings and rooks stand.
+    void setRootState(const FenState& state) {
+        traceState = state;
+        traceStateSet = true;
+    }
+
+    // Writes the tree trace of the last (or the running) search to a file,
+    // false if tracing is off or the file cannot be written
+    bool dumpTrace(const std::string& path) const {
+        return tracer && tracer->dump(path, traceFen);
+    }
+
+    // Counters of the last search(), see search_stats.hpp
+    const SearchStats& statistics() const {
+        return stats;
+    }
+};
+
+// Search scores are from white's side, UCI output wants the side to move:
+// "cp 35" or "mate 3"
+inline std::string formatScore(double score, bool whiteToMove) {
+    double relative = whiteToMove ? score : -score;
+    if (std::abs(relative) >= MinimaxSearch::MATE_BOUND) {
+        int plies = static_cast<int>(MinimaxSearch::MATE_SCORE - std::abs(relative));
+        int moves = std::max(1, (plies - 1) / 2);
+        return "mate " + std::to_string(relative > 0 ? moves : -moves);
+    }
+    return "cp " + std::to_string(static_cast<int>(std::lround(relative * 100)));
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Counters of one search, to see where the time goes when a search is slow.
+// Every MinimaxSearch owns its own SearchStats and bumps plain integers, no
+// atomics on the hot path; searches on other threads (analyse) are added up
+// with += once they are done.
+//
+// Building with -DLANCER_SEARCH_STATS=OFF (LANCER_NO_STATS) turns every
+// SEARCH_STAT() into nothing, so the counters cost nothing at all.
+#ifdef LANCER_NO_STATS
+#define SEARCH_STAT(statement)
+#else
+#define SEARCH_STAT(statement) statement
+#endif
+
+struct SearchStats {
+    static constexpr int MAX_PLY = 64;  // at least MinimaxSearch::MAX_PLY, checked there
+
+    // One completed iteration of the iterative deepening loop
+    struct Iteration {
+        int depth;
+        uint64_t nodes;   // in this iteration only
+        int64_t timeMs;   // in this iteration only
+    };
+
+    uint64_t nodes{0};
+    uint64_t leafNodes{0};         // evaluated at the horizon
+    uint64_t ttProbes{0};
+    uint64_t ttHits{0};
+    uint64_t ttCutoffs{0};
+    uint64_t ttStores{0};
+    uint64_t betaCutoffs{0};
+    uint64_t firstMoveCutoffs{0};  // cutoffs by the first move searched
+    uint64_t quietGenerationsSkipped{0};  // cutoffs before the quiet moves were generated
+    uint64_t bitbaseHits{0};
+    uint64_t tbProbes{0};
+    uint64_t tbHits{0};
+    uint64_t plyNodes[MAX_PLY]{};
+    std::vector<Iteration> iterations;
+
+    void clear() {
+        *this = SearchStats();
+    }
+
+    SearchStats& operator+=(const SearchStats& other) {
+        nodes += other.nodes;
+        leafNodes += other.leafNodes;
+        ttProbes += other.ttProbes;
+        ttHits += other.ttHits;
+        ttCutoffs += other.ttCutoffs;
+        ttStores += other.ttStores;
+        betaCutoffs += other.betaCutoffs;
+        firstMoveCutoffs += other.firstMoveCutoffs;
+        quietGenerationsSkipped += other.quietGenerationsSkipped;
+        bitbaseHits += other.bitbaseHits;
+        tbProbes += other.tbProbes;
+        tbHits += other.tbHits;
+        for (int ply = 0; ply < MAX_PLY; ply++) {
+            plyNodes[ply] += other.plyNodes[ply];
+        }
+        // Iterations line up by depth
+        for (const Iteration& iteration : other.iterations) {
+            auto it = std::find_if(iterations.begin(), iterations.end(),
+                                   [&](const Iteration& own) { return own.depth == iteration.depth; });
+            if (it == iterations.end()) {
+                iterations.push_back(iteration);
+            } else {
+                it->nodes += iteration.nodes;
+                it->timeMs += iteration.timeMs;
+            }
+        }
+        return *this;
+    }
+
+    // One line JSON object. Branching factors are nodes at ply + 1 per node
+    // at ply, and nodes of an iteration per node of the one before.
+    std::string toJson() const {
+#ifdef LANCER_NO_STATS
+        return "{}";
+#else
+        auto rate = [](uint64_t part, uint64_t whole) {
+            return whole ? static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+        };
+        std::ostringstream json;
+        json << "{\"nodes\":" << nodes
+             << ",\"leafNodes\":" << leafNodes
+             << ",\"tt\":{\"probes\":" << ttProbes << ",\"hits\":" << ttHits
+             << ",\"hitRate\":" << rate(ttHits, ttProbes)
+             << ",\"cutoffs\":" << ttCutoffs << ",\"stores\":" << ttStores << "}"
+             << ",\"betaCutoffs\":" << betaCutoffs
+             << ",\"firstMoveCutoffRate\":" << rate(firstMoveCutoffs, betaCutoffs)
+             << ",\"quietGenerationsSkipped\":" << quietGenerationsSkipped
+             << ",\"bitbaseHits\":" << bitbaseHits
+             << ",\"tablebase\":{\"probes\":" << tbProbes << ",\"hits\":" << tbHits << "}";
+
+        json << ",\"plies\":[";
+        int lastPly = MAX_PLY - 1;
+        while (lastPly > 0 && plyNodes[lastPly] == 0) {
+            lastPly--;
+        }
+        for (int ply = 0; ply <= lastPly && plyNodes[ply]; ply++) {
+            json << (ply ? "," : "") << "{\"ply\":" << ply << ",\"nodes\":" << plyNodes[ply]
+                 << ",\"ebf\":" << (ply < lastPly ? rate(plyNodes[ply + 1], plyNodes[ply]) : 0.0) << "}";
+        }
+
+        json << "],\"iterations\":[";
+        for (size_t i = 0; i < iterations.size(); i++) {
+            const Iteration& iteration = iterations[i];
+            json << (i ? "," : "") << "{\"depth\":" << iteration.depth << ",\"nodes\":" << iteration.nodes
+                 << ",\"timeMs\":" << iteration.timeMs
+                 << ",\"ebf\":" << (i ? rate(iteration.nodes, iterations[i - 1].nodes) : 0.0) << "}";
+        }
+        json << "]}";
+        return json.str();
+#endif
+    }
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "movegen.hpp"
+
+// Record of every node a search returned from, to find out afterwards why it
+// played a move: which subtree was cut, by what, with which window and which
+// score came back up. Off unless MinimaxSearch::setTrace gives it a buffer.
+//
+// Every search thread writes into its own ring buffer, so there is no
+// locking. Once the buffer is full the oldest events are overwritten, a dump
+// holds the last `capacity` nodes. dump() can run from another thread while
+// the search keeps writing (UCI "dumptrace" during "go infinite").
+//
+// Building with -DLANCER_SEARCH_TRACE=OFF (LANCER_NO_TRACE) turns every
+// SEARCH_TRACE() into nothing, the search then does not even check for a buffer.
+#ifdef LANCER_NO_TRACE
+#define SEARCH_TRACE(statement)
+#else
+#define SEARCH_TRACE(statement) statement
+#endif
+
+// How a node ended
+enum class TraceKind : uint8_t {
+    Leaf,          // evaluated at the horizon
+    Bitbase,       // bitbase result at the horizon
+    KingCaptured,  // the side to move has no king left
+    TTCutoff,
+    Tablebase,
+    Cutoff,        // a move failed high, the rest were never searched
+    FailLow,       // every move searched, none got inside the window
+    Exact,         // every move searched, the score is inside the window
+    NoMoves,
+};
+
+inline const char* traceKindName(TraceKind kind) {
+    static const char* const NAMES[] = {"leaf", "bitbase", "kingcaptured", "ttcutoff", "tablebase",
+                                        "cutoff", "faillow", "exact", "nomoves"};
+    return static_cast<size_t>(kind) < std::size(NAMES) ? NAMES[static_cast<size_t>(kind)] : "?";
+}
+
+// One node. Scores and window are in pawns from white's point of view like
+// everywhere in the search, the window is the one the node was called with.
+struct TraceEvent {
+    uint32_t key;       // high half of the Zobrist key, to spot transpositions
+    float alpha;
+    float beta;
+    float score;
+    uint16_t move;      // Move::raw() of the move into this node, 0 at the root
+    uint16_t rootMove;  // first move of the line, picks out a root subtree
+    uint8_t ply;
+    int8_t depth;       // left to the horizon
+    TraceKind kind;
+    uint8_t iteration;  // of the iterative deepening loop
+};
+
+static_assert(sizeof(TraceEvent) == 24, "trace events should stay 24 bytes");
+
+// Start of a dump file, the events follow oldest first
+struct TraceFileHeader {
+    static constexpr char MAGIC[8] = {'L', 'A', 'N', 'C', 'E', 'R', 'T', 'R'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t eventSize;
+    uint64_t eventCount;
+    uint64_t dropped;  // older events the ring had already overwritten
+    char fen[96];      // root position of the search
+};
+
+static_assert(sizeof(TraceFileHeader) == 128, "trace file header layout");
+
+class SearchTracer {
+private:
+    std::vector<TraceEvent> m_events;
+    uint64_t m_mask;
+    std::atomic<uint64_t> m_written{0};
+
+public:
+    // Room for the last `capacity` events, rounded up to a power of two
+    explicit SearchTracer(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        m_events.resize(size);
+        m_mask = size - 1;
+    }
+
+    size_t capacity() const { return m_events.size(); }
+    uint64_t recorded() const { return m_written.load(std::memory_order_acquire); }
+
+    // Owner thread only
+    void clear() {
+        m_written.store(0, std::memory_order_release);
+    }
+
+    // Owner thread only. The count is published after the event is written.
+    void record(const TraceEvent& event) {
+        uint64_t index = m_written.load(std::memory_order_relaxed);
+        m_events[index & m_mask] = event;
+        m_written.store(index + 1, std::memory_order_release);
+    }
+
+    // The buffered events, oldest first. From another thread the writer may
+    // lap us during the copy; the slots it could have reached are dropped
+    // afterwards, like a seqlock reader does.
+    std::vector<TraceEvent> snapshot(uint64_t* dropped = nullptr) const {
+        uint64_t end = m_written.load(std::memory_order_acquire);
+        uint64_t begin = end > m_events.size() ? end - m_events.size() : 0;
+        std::vector<TraceEvent> events;
+        events.reserve(end - begin);
+        for (uint64_t i = begin; i < end; i++) {
+            events.push_back(m_events[i & m_mask]);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = m_written.load(std::memory_order_relaxed);
+        // record() fills slot `after` before it publishes after + 1, so that
+        // slot may be half overwritten too
+        uint64_t firstIntact = after + 1 > m_events.size() ? after + 1 - m_events.size() : 0;
+        if (firstIntact > begin) {
+            size_t lost = static_cast<size_t>(std::min<uint64_t>(firstIntact - begin, events.size()));
+            events.erase(events.begin(), events.begin() + lost);
+            begin += lost;
+        }
+        if (dropped) {
+            *dropped = begin;
+        }
+        return events;
+    }
+
+    bool dump(const std::string& path, const std::string& rootFen) const {
+        uint64_t dropped = 0;
+        std::vector<TraceEvent> events = snapshot(&dropped);
+
+        TraceFileHeader header{};
+        std::memcpy(header.magic, TraceFileHeader::MAGIC, sizeof(header.magic));
+        header.version = TraceFileHeader::VERSION;
+        header.eventSize = sizeof(TraceEvent);
+        header.eventCount = events.size();
+        header.dropped = dropped;
+        std::strncpy(header.fen, rootFen.c_str(), sizeof(header.fen) - 1);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(events.data()),
+                  static_cast<std::streamsize>(events.size() * sizeof(TraceEvent)));
+        return static_cast<bool>(out);
+    }
+
+    // Reads a dump back, false if it is not one of ours
+    static bool load(const std::string& path, TraceFileHeader& header, std::vector<TraceEvent>& events) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, TraceFileHeader::MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != TraceFileHeader::VERSION || header.eventSize != sizeof(TraceEvent)) {
+            return false;
+        }
+        header.fen[sizeof(header.fen) - 1] = '\0';
+        events.resize(header.eventCount);
+        in.read(reinterpret_cast<char*>(events.data()),
+                static_cast<std::streamsize>(events.size() * sizeof(TraceEvent)));
+        events.resize(static_cast<size_t>(in.gcount()) / sizeof(TraceEvent));
+        return true;
+    }
+};
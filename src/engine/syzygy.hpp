@@ -0,0 +1,865 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "board.hpp"
+#include "movegen.hpp"
+#include "../utils/mapped_file.hpp"
+
+// Probing of Syzygy tablebases (.rtbw win/draw/loss, .rtbz distance to
+// zeroing), the format most engines and GUIs ship for 5 and 6 pieces.
+//
+// The tables index a position by the pieces' squares after folding away the
+// board symmetries, and store the values Huffman-compressed in blocks. This
+// follows the layout the tables are generated with: per material a set of
+// "pairs data" (one per side to move, and per leading pawn file when there
+// are pawns), a sparse index into the blocks, then the blocks.
+//
+// Files are found by name when the path is set, but only mapped on their first
+// probe. Several search threads may probe at once; the first one maps the file
+// under a lock and the others see the entry as ready afterwards.
+//
+// WDL values are from the side to move: -2 loss, -1 loss saved by the 50 move
+// rule ("blessed"), 0 draw, 1 win spoiled by the 50 move rule ("cursed"), 2 win.
+class SyzygyTablebases {
+public:
+    static constexpr int MAX_PIECES = 7;
+
+    enum class ProbeState { Fail, Ok, ChangeSideToMove, ZeroingBestMove };
+
+    // A position as the probing code needs it, the search has no position
+    // object of its own
+    struct Position {
+        ChessBoard board;
+        bool whiteToMove;
+    };
+
+    struct TbMove {
+        Move move;
+        int promotion;  // piece index, -1 if none
+        bool zeroing;   // capture or pawn move, resets the 50 move counter
+    };
+
+private:
+    enum TableType { WDL = 0, DTZ = 1 };
+    enum Flag { STM = 1, Mapped = 2, WinPlies = 4, LossPlies = 8, Wide = 16, SingleValue = 128 };
+
+    // ---- Encoding tables, built once ----
+
+    static int offA1H8(int square) { return (square >> 3) - (square & 7); }
+
+    struct Encoding {
+        int mapB1H1H7[64]{};
+        int mapA1D1D4[64]{};
+        int mapKK[10][64]{};
+        uint64_t binomial[MAX_PIECES][64]{};
+        int mapPawns[64]{};
+        int leadPawnIdx[MAX_PIECES][64]{};
+        int leadPawnsSize[MAX_PIECES][4]{};
+
+        Encoding() {
+            int code = 0;
+            for (int s = 0; s < 64; s++) {
+                if (offA1H8(s) < 0) mapB1H1H7[s] = code++;
+            }
+
+            // The a1-d1-d4 triangle, diagonal squares last
+            std::vector<int> diagonal;
+            code = 0;
+            for (int s = 0; s <= 27; s++) {
+                if (offA1H8(s) < 0 && (s & 7) <= 3) mapA1D1D4[s] = code++;
+                else if (!offA1H8(s) && (s & 7) <= 3) diagonal.push_back(s);
+            }
+            for (int s : diagonal) mapA1D1D4[s] = code++;
+
+            // The 462 legal placements of two kings with the first one in the
+            // triangle, and not above the diagonal if the first is on it
+            std::vector<std::pair<int, int>> bothOnDiagonal;
+            code = 0;
+            for (int idx = 0; idx < 10; idx++) {
+                for (int s1 = 0; s1 <= 27; s1++) {
+                    if (mapA1D1D4[s1] != idx || (idx == 0 && s1 != 1)) continue;
+                    for (int s2 = 0; s2 < 64; s2++) {
+                        if (std::abs((s1 & 7) - (s2 & 7)) <= 1 && std::abs((s1 >> 3) - (s2 >> 3)) <= 1) continue;
+                        if (!offA1H8(s1) && offA1H8(s2) > 0) continue;
+                        if (!offA1H8(s1) && !offA1H8(s2)) bothOnDiagonal.emplace_back(idx, s2);
+                        else mapKK[idx][s2] = code++;
+                    }
+                }
+            }
+            for (auto [idx, s2] : bothOnDiagonal) mapKK[idx][s2] = code++;
+
+            binomial[0][0] = 1;
+            for (int n = 1; n < 64; n++) {
+                for (int k = 0; k < MAX_PIECES && k <= n; k++) {
+                    binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+                }
+            }
+
+            // a2-h7 numbered so the highest is the leading pawn: nearest the
+            // edge, then lowest rank
+            int available = 47;
+            for (int leadPawns = 1; leadPawns < MAX_PIECES - 1; leadPawns++) {
+                for (int file = 0; file < 4; file++) {
+                    int idx = 0;
+                    for (int rank = 1; rank <= 6; rank++) {
+                        int sq = rank * 8 + file;
+                        if (leadPawns == 1) {
+                            mapPawns[sq] = available--;
+                            mapPawns[sq ^ 7] = available--;
+                        }
+                        leadPawnIdx[leadPawns][sq] = idx;
+                        idx += static_cast<int>(binomial[leadPawns - 1][mapPawns[sq]]);
+                    }
+                    leadPawnsSize[leadPawns][file] = idx;
+                }
+            }
+        }
+    };
+
+    static const Encoding& encoding() {
+        static const Encoding tables;
+        return tables;
+    }
+
+    // ---- Reading the file ----
+
+    static uint16_t readLE16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+    static uint32_t readLE32(const uint8_t* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+    static uint32_t readBE32(const uint8_t* p) {
+        return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    static uint64_t readBE64(const uint8_t* p) {
+        return (static_cast<uint64_t>(readBE32(p)) << 32) | readBE32(p + 4);
+    }
+
+    struct PairsData {
+        uint8_t flags{0};
+        size_t sizeofBlock{0};
+        size_t span{0};
+        uint32_t numBlocks{0};
+        int maxSymLen{0};
+        int minSymLen{0};            // the value itself for SingleValue tables
+        const uint8_t* lowestSym{nullptr};
+        const uint8_t* btree{nullptr};  // 3 bytes per symbol: two 12 bit children
+        const uint8_t* blockLength{nullptr};
+        size_t blockLengthSize{0};
+        const uint8_t* sparseIndex{nullptr};  // 6 bytes per entry: block, offset
+        size_t sparseIndexSize{0};
+        const uint8_t* data{nullptr};
+        std::vector<uint64_t> base64;
+        std::vector<uint8_t> symlen;
+        uint8_t pieces[MAX_PIECES]{};
+        uint64_t groupIdx[MAX_PIECES + 1]{};
+        int groupLen[MAX_PIECES + 1]{};
+        uint16_t mapIdx[4]{};
+
+        int left(int sym) const {
+            const uint8_t* lr = btree + 3 * sym;
+            return ((lr[1] & 0xF) << 8) | lr[0];
+        }
+        int right(int sym) const {
+            const uint8_t* lr = btree + 3 * sym;
+            return (lr[2] << 4) | (lr[1] >> 4);
+        }
+    };
+
+    struct TableFile {
+        std::string path;
+        std::atomic<bool> ready{false};
+        bool failed{false};
+        MappedFile file;
+        PairsData items[2][4];
+        const uint8_t* map{nullptr};  // DTZ value maps
+    };
+
+    struct Table {
+        std::string name;
+        uint64_t key{0}, key2{0};  // material with the named side white / black
+        int pieceCount{0};
+        bool hasPawns{false};
+        bool hasUniquePieces{false};
+        int pawnCount[2]{};        // leading colour first
+        TableFile files[2];        // WDL, DTZ
+
+        PairsData* get(TableType type, int stm, int file) {
+            int sides = type == WDL ? 2 : 1;
+            return &files[type].items[stm % sides][hasPawns ? file : 0];
+        }
+    };
+
+    std::vector<std::unique_ptr<Table>> m_tables;
+    std::unordered_map<uint64_t, Table*> m_byKey;
+    int m_maxPieces{0};
+    mutable std::mutex m_mappingMutex;
+
+    static int pieceCode(int piece) {
+        return piece % 6 + 1 + (piece >= BP ? 8 : 0);
+    }
+
+    // 4 bits of count per piece
+    static uint64_t materialKey(const ChessBoard& board) {
+        uint64_t key = 0;
+        for (int piece = 0; piece < 12; piece++) {
+            key += static_cast<uint64_t>(std::popcount(board[piece])) << (4 * piece);
+        }
+        return key;
+    }
+
+    static uint8_t setSymlen(PairsData& d, int sym, std::vector<bool>& visited) {
+        visited[sym] = true;
+        int right = d.right(sym);
+        if (right == 0xFFF) {
+            return 0;
+        }
+        int left = d.left(sym);
+        if (!visited[left]) d.symlen[left] = setSymlen(d, left, visited);
+        if (!visited[right]) d.symlen[right] = setSymlen(d, right, visited);
+        return static_cast<uint8_t>(d.symlen[left] + d.symlen[right] + 1);
+    }
+
+    static const uint8_t* setSizes(PairsData& d, const uint8_t* data) {
+        d.flags = *data++;
+        if (d.flags & SingleValue) {
+            d.numBlocks = 0;
+            d.span = d.blockLengthSize = d.sparseIndexSize = 0;
+            d.minSymLen = *data++;
+            return data;
+        }
+
+        // groupLen is zero terminated, the groupIdx after the last group is
+        // the table size
+        uint64_t tbSize = d.groupIdx[std::find(d.groupLen, d.groupLen + MAX_PIECES, 0) - d.groupLen];
+        d.sizeofBlock = size_t(1) << *data++;
+        d.span = size_t(1) << *data++;
+        d.sparseIndexSize = static_cast<size_t>((tbSize + d.span - 1) / d.span);
+        int padding = *data++;
+        d.numBlocks = readLE32(data);
+        data += 4;
+        d.blockLengthSize = d.numBlocks + padding;
+        d.maxSymLen = *data++;
+        d.minSymLen = *data++;
+        d.lowestSym = data;
+        d.base64.resize(d.maxSymLen - d.minSymLen + 1);
+
+        // Canonical Huffman code: base64[l] is the lowest code of length l,
+        // left-aligned in 64 bits
+        for (int i = static_cast<int>(d.base64.size()) - 2; i >= 0; i--) {
+            d.base64[i] = (d.base64[i + 1] + readLE16(d.lowestSym + 2 * i) - readLE16(d.lowestSym + 2 * (i + 1))) / 2;
+        }
+        for (size_t i = 0; i < d.base64.size(); i++) {
+            d.base64[i] <<= 64 - i - d.minSymLen;
+        }
+        data += d.base64.size() * 2;
+
+        d.symlen.resize(readLE16(data));
+        data += 2;
+        d.btree = data;
+        std::vector<bool> visited(d.symlen.size());
+        for (size_t sym = 0; sym < d.symlen.size(); sym++) {
+            if (!visited[sym]) d.symlen[sym] = setSymlen(d, static_cast<int>(sym), visited);
+        }
+        return data + d.symlen.size() * 3 + (d.symlen.size() & 1);
+    }
+
+    static const uint8_t* setDtzMap(Table& e, TableType type, const uint8_t* data, int maxFile) {
+        if (type == WDL) {
+            return data;
+        }
+        TableFile& f = e.files[DTZ];
+        f.map = data;
+        for (int file = 0; file <= maxFile; file++) {
+            PairsData* d = e.get(DTZ, 0, file);
+            if (d->flags & Mapped) {
+                if (d->flags & Wide) {
+                    data += reinterpret_cast<uintptr_t>(data) & 1;
+                    for (int i = 0; i < 4; i++) {
+                        d->mapIdx[i] = static_cast<uint16_t>((data - f.map) / 2 + 1);
+                        data += 2 * readLE16(data) + 2;
+                    }
+                } else {
+                    for (int i = 0; i < 4; i++) {
+                        d->mapIdx[i] = static_cast<uint16_t>(data - f.map + 1);
+                        data += *data + 1;
+                    }
+                }
+            }
+        }
+        return data + (reinterpret_cast<uintptr_t>(data) & 1);
+    }
+
+    // How the pieces are grouped and in which order the groups are encoded
+    static void setGroups(const Table& e, PairsData& d, const int order[2], int file) {
+        const Encoding& enc = encoding();
+        int n = 0, firstLen = e.hasPawns ? 0 : e.hasUniquePieces ? 3 : 2;
+        d.groupLen[n] = 1;
+        for (int i = 1; i < e.pieceCount; i++) {
+            if (--firstLen > 0 || d.pieces[i] == d.pieces[i - 1]) d.groupLen[n]++;
+            else d.groupLen[++n] = 1;
+        }
+        d.groupLen[++n] = 0;
+
+        bool pp = e.hasPawns && e.pawnCount[1];
+        int next = pp ? 2 : 1;
+        int freeSquares = 64 - d.groupLen[0] - (pp ? d.groupLen[1] : 0);
+        uint64_t idx = 1;
+        for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+            if (k == order[0]) {
+                d.groupIdx[0] = idx;
+                idx *= e.hasPawns ? enc.leadPawnsSize[d.groupLen[0]][file]
+                     : e.hasUniquePieces ? 31332 : 462;
+            } else if (k == order[1]) {
+                d.groupIdx[1] = idx;
+                idx *= enc.binomial[d.groupLen[1]][48 - d.groupLen[0]];
+            } else {
+                d.groupIdx[next] = idx;
+                idx *= enc.binomial[d.groupLen[next]][freeSquares];
+                freeSquares -= d.groupLen[next++];
+            }
+        }
+        d.groupIdx[n] = idx;
+    }
+
+    // Parses the table header, returns false if it does not fit in the file
+    static bool setup(Table& e, TableType type, const uint8_t* data, const uint8_t* end) {
+        enum { HasPawns = 2 };
+        if (bool(*data & HasPawns) != e.hasPawns) {
+            return false;
+        }
+        data++;
+
+        int sides = type == WDL && e.key != e.key2 ? 2 : 1;
+        int maxFile = e.hasPawns ? 3 : 0;
+        bool pp = e.hasPawns && e.pawnCount[1];
+
+        for (int file = 0; file <= maxFile; file++) {
+            for (int i = 0; i < sides; i++) {
+                *e.get(type, i, file) = PairsData();
+            }
+            int order[2][2] = {{*data & 0xF, pp ? *(data + 1) & 0xF : 0xF},
+                               {*data >> 4, pp ? *(data + 1) >> 4 : 0xF}};
+            data += 1 + pp;
+            for (int k = 0; k < e.pieceCount; k++, data++) {
+                for (int i = 0; i < sides; i++) {
+                    e.get(type, i, file)->pieces[k] = static_cast<uint8_t>(i ? *data >> 4 : *data & 0xF);
+                }
+            }
+            for (int i = 0; i < sides; i++) {
+                setGroups(e, *e.get(type, i, file), order[i], file);
+            }
+        }
+        data += reinterpret_cast<uintptr_t>(data) & 1;
+
+        for (int file = 0; file <= maxFile; file++) {
+            for (int i = 0; i < sides; i++) {
+                data = setSizes(*e.get(type, i, file), data);
+                if (data > end) return false;
+            }
+        }
+        data = setDtzMap(e, type, data, maxFile);
+
+        for (int file = 0; file <= maxFile; file++) {
+            for (int i = 0; i < sides; i++) {
+                PairsData* d = e.get(type, i, file);
+                d->sparseIndex = data;
+                data += d->sparseIndexSize * 6;
+            }
+        }
+        for (int file = 0; file <= maxFile; file++) {
+            for (int i = 0; i < sides; i++) {
+                PairsData* d = e.get(type, i, file);
+                d->blockLength = data;
+                data += d->blockLengthSize * 2;
+            }
+        }
+        for (int file = 0; file <= maxFile; file++) {
+            for (int i = 0; i < sides; i++) {
+                data = reinterpret_cast<const uint8_t*>((reinterpret_cast<uintptr_t>(data) + 0x3F) & ~uintptr_t(0x3F));
+                PairsData* d = e.get(type, i, file);
+                d->data = data;
+                data += d->numBlocks * d->sizeofBlock;
+            }
+        }
+        return data <= end;
+    }
+
+    // Maps the file on first use. Returns false if it is missing or broken.
+    bool ensureMapped(Table& e, TableType type) const {
+        TableFile& f = e.files[type];
+        if (f.ready.load(std::memory_order_acquire)) {
+            return !f.failed;
+        }
+        std::lock_guard<std::mutex> lock(m_mappingMutex);
+        if (!f.ready.load(std::memory_order_relaxed)) {
+            static constexpr uint8_t MAGIC[2][4] = {{0x71, 0xE8, 0x23, 0x5D}, {0xD7, 0x66, 0x0C, 0xA5}};
+            f.failed = f.path.empty() || !f.file.open(f.path) || f.file.size() < 5 ||
+                       std::memcmp(f.file.data(), MAGIC[type], 4) != 0 ||
+                       !setup(e, type, f.file.data() + 4, f.file.data() + f.file.size());
+            if (f.failed) {
+                f.file.close();
+            }
+            f.ready.store(true, std::memory_order_release);
+        }
+        return !f.failed;
+    }
+
+    static int decompressPairs(const PairsData& d, uint64_t idx) {
+        if (d.flags & SingleValue) {
+            return d.minSymLen;
+        }
+
+        // The sparse index points near the block, the block lengths walk the rest
+        uint32_t k = static_cast<uint32_t>(idx / d.span);
+        uint32_t block = readLE32(d.sparseIndex + 6 * k);
+        int offset = readLE16(d.sparseIndex + 6 * k + 4);
+        int diff = static_cast<int>(idx % d.span) - static_cast<int>(d.span / 2);
+        offset += diff;
+        while (offset < 0) offset += readLE16(d.blockLength + 2 * --block) + 1;
+        while (offset > readLE16(d.blockLength + 2 * block)) offset -= readLE16(d.blockLength + 2 * block++) + 1;
+
+        const uint8_t* ptr = d.data + static_cast<uint64_t>(block) * d.sizeofBlock;
+        uint64_t buf64 = readBE64(ptr);
+        ptr += 8;
+        int buf64Size = 64;
+        int sym;
+
+        while (true) {
+            int len = 0;
+            while (buf64 < d.base64[len]) len++;
+            sym = static_cast<int>((buf64 - d.base64[len]) >> (64 - len - d.minSymLen));
+            sym += readLE16(d.lowestSym + 2 * len);
+            if (offset < d.symlen[sym] + 1) break;
+            offset -= d.symlen[sym] + 1;
+            len += d.minSymLen;
+            buf64 <<= len;
+            buf64Size -= len;
+            if (buf64Size <= 32) {
+                buf64Size += 32;
+                buf64 |= static_cast<uint64_t>(readBE32(ptr)) << (64 - buf64Size);
+                ptr += 4;
+            }
+        }
+
+        // Symbols stand for pairs of symbols, walk down to the value
+        while (d.symlen[sym]) {
+            int left = d.left(sym);
+            if (offset < d.symlen[left] + 1) {
+                sym = left;
+            } else {
+                offset -= d.symlen[left] + 1;
+                sym = d.right(sym);
+            }
+        }
+        return d.left(sym);
+    }
+
+    int mapScore(Table& e, TableType type, int file, int value, int wdl) const {
+        if (type == WDL) {
+            return value - 2;
+        }
+        static constexpr int WDL_MAP[] = {1, 3, 0, 2, 0};
+        const PairsData* d = e.get(DTZ, 0, file);
+        const uint8_t* map = e.files[DTZ].map;
+        if (d->flags & Mapped) {
+            int at = d->mapIdx[WDL_MAP[wdl + 2]] + value;
+            value = d->flags & Wide ? readLE16(map + 2 * at) : map[at];
+        }
+        // Stored in moves unless the flags say plies, we want plies
+        if ((wdl == 2 && !(d->flags & WinPlies)) || (wdl == -2 && !(d->flags & LossPlies)) ||
+            wdl == 1 || wdl == -1) {
+            value *= 2;
+        }
+        return value + 1;
+    }
+
+    // Index of the position in the table, then the stored value
+    int probeTable(const Position& pos, TableType type, int wdl, ProbeState& state) const {
+        uint64_t key = materialKey(pos.board);
+        if (key == ((1ULL << (4 * WK)) | (1ULL << (4 * BK)))) {
+            return 0;  // bare kings
+        }
+        auto it = m_byKey.find(key);
+        if (it == m_byKey.end() || !ensureMapped(*it->second, type)) {
+            state = ProbeState::Fail;
+            return 0;
+        }
+        Table& e = *it->second;
+        const Encoding& enc = encoding();
+        auto pawnsComp = [&enc](int a, int b) { return enc.mapPawns[a] < enc.mapPawns[b]; };
+
+        int squares[MAX_PIECES], pieces[MAX_PIECES];
+        int size = 0, leadPawnsCnt = 0;
+        uint64_t leadPawns = 0;
+        int tbFile = 0;
+
+        // Tables are stored with the named (stronger) side as white, and
+        // symmetric tables only for white to move: otherwise swap the colours
+        bool symmetricBlackToMove = e.key == e.key2 && !pos.whiteToMove;
+        bool blackStronger = key != e.key;
+        bool flip = symmetricBlackToMove || blackStronger;
+        int flipColor = flip ? 8 : 0, flipSquares = flip ? 56 : 0;
+        int stm = flip ^ !pos.whiteToMove;
+
+        if (e.hasPawns) {
+            int pc = e.get(type, 0, 0)->pieces[0] ^ flipColor;
+            leadPawns = pos.board[pc >= 8 ? BP : WP];
+            for (uint64_t b = leadPawns; b; b &= b - 1) {
+                squares[size++] = getLSB(b) ^ flipSquares;
+            }
+            leadPawnsCnt = size;
+            std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCnt, pawnsComp));
+            tbFile = std::min(squares[0] & 7, 7 - (squares[0] & 7));
+        }
+
+        // DTZ files only hold one side to move
+        if (type == DTZ) {
+            int flags = e.get(DTZ, stm, tbFile)->flags;
+            if ((flags & STM) != stm && !(e.key == e.key2 && !e.hasPawns)) {
+                state = ProbeState::ChangeSideToMove;
+                return 0;
+            }
+        }
+
+        uint64_t occupied = 0;
+        for (const auto& bitboard : pos.board) {
+            occupied |= bitboard;
+        }
+        for (uint64_t b = occupied & ~leadPawns; b; b &= b - 1) {
+            int square = getLSB(b);
+            int piece = 0;
+            while (!(pos.board[piece] & (1ULL << square))) piece++;
+            squares[size] = square ^ flipSquares;
+            pieces[size++] = pieceCode(piece) ^ flipColor;
+        }
+
+        PairsData* d = e.get(type, stm, tbFile);
+
+        // Same sequence of pieces as the table
+        for (int i = leadPawnsCnt; i < size - 1; i++) {
+            for (int j = i + 1; j < size; j++) {
+                if (d->pieces[i] == pieces[j]) {
+                    std::swap(pieces[i], pieces[j]);
+                    std::swap(squares[i], squares[j]);
+                    break;
+                }
+            }
+        }
+
+        // Lead piece on the queen side
+        if ((squares[0] & 7) > 3) {
+            for (int i = 0; i < size; i++) squares[i] ^= 7;
+        }
+
+        uint64_t idx;
+        if (e.hasPawns) {
+            idx = enc.leadPawnIdx[leadPawnsCnt][squares[0]];
+            std::stable_sort(squares + 1, squares + leadPawnsCnt, pawnsComp);
+            for (int i = 1; i < leadPawnsCnt; i++) {
+                idx += enc.binomial[i][enc.mapPawns[squares[i]]];
+            }
+        } else {
+            // Lead piece below rank 5, then below the a1-h8 diagonal
+            if ((squares[0] >> 3) > 3) {
+                for (int i = 0; i < size; i++) squares[i] ^= 56;
+            }
+            for (int i = 0; i < d->groupLen[0]; i++) {
+                if (!offA1H8(squares[i])) continue;
+                if (offA1H8(squares[i]) > 0) {
+                    for (int j = i; j < size; j++) {
+                        squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                    }
+                }
+                break;
+            }
+
+            if (e.hasUniquePieces) {
+                int adjust1 = squares[1] > squares[0];
+                int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+                if (offA1H8(squares[0])) {
+                    idx = (enc.mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+                } else if (offA1H8(squares[1])) {
+                    idx = (6 * 63 + (squares[0] >> 3) * 28 + enc.mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+                } else if (offA1H8(squares[2])) {
+                    idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 +
+                          ((squares[1] >> 3) - adjust1) * 28 + enc.mapB1H1H7[squares[2]];
+                } else {
+                    idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6 +
+                          ((squares[1] >> 3) - adjust1) * 6 + ((squares[2] >> 3) - adjust2);
+                }
+            } else {
+                idx = enc.mapKK[enc.mapA1D1D4[squares[0]]][squares[1]];
+            }
+        }
+
+        // The other groups, each as a combination of its free squares
+        idx *= d->groupIdx[0];
+        int* groupSq = squares + d->groupLen[0];
+        bool remainingPawns = e.hasPawns && e.pawnCount[1];
+        int next = 0;
+        while (d->groupLen[++next]) {
+            std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+            uint64_t n = 0;
+            for (int i = 0; i < d->groupLen[next]; i++) {
+                int adjust = static_cast<int>(std::count_if(squares, groupSq, [&](int s) { return groupSq[i] > s; }));
+                n += enc.binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+            }
+            remainingPawns = false;
+            idx += n * d->groupIdx[next];
+            groupSq += d->groupLen[next];
+        }
+
+        return mapScore(e, type, tbFile, decompressPairs(*d, idx), wdl);
+    }
+
+    // ---- Moves on a probe position ----
+
+    static bool kingAttacked(ChessBoard& board, bool whiteKing) {
+        uint64_t king = board[whiteKing ? WK : BK];
+        return king && MoveGen(board).isSquareAttacked(getLSB(king), !whiteKing);
+    }
+
+    static Position play(const Position& pos, const TbMove& m) {
+        Position next = pos;
+        uint64_t fromBit = 1ULL << m.move.from(), toBit = 1ULL << m.move.to();
+        int friendly = pos.whiteToMove ? WP : BP, enemy = pos.whiteToMove ? BP : WP;
+        for (int piece = enemy; piece < enemy + 6; piece++) next.board[piece] &= ~toBit;
+        for (int piece = friendly; piece < friendly + 6; piece++) {
+            if (next.board[piece] & fromBit) {
+                next.board[piece] &= ~fromBit;
+                next.board[m.promotion >= 0 ? m.promotion : piece] |= toBit;
+                break;
+            }
+        }
+        next.whiteToMove = !pos.whiteToMove;
+        return next;
+    }
+
+    // Captures are the moves that leave the table, they are searched before
+    // trusting the stored value ("don't care" entries hide behind them)
+    template <bool CheckZeroingMoves>
+    int search(const Position& pos, ProbeState& state) const {
+        int bestValue = -2, value = 0;
+        std::vector<TbMove> moves = legalMoves(pos);
+        size_t moveCount = 0;
+        for (const TbMove& m : moves) {
+            bool capture = false;
+            for (int piece = 0; piece < 12; piece++) capture |= bool(pos.board[piece] & (1ULL << m.move.to()));
+            if (!capture && (!CheckZeroingMoves || !m.zeroing)) continue;
+            moveCount++;
+            value = -search<false>(play(pos, m), state);
+            if (state == ProbeState::Fail) return 0;
+            if (value > bestValue) {
+                bestValue = value;
+                if (value >= 2) {
+                    state = ProbeState::ZeroingBestMove;
+                    return value;
+                }
+            }
+        }
+
+        bool noMoreMoves = moveCount && moveCount == moves.size();
+        if (noMoreMoves) {
+            value = bestValue;
+        } else {
+            value = probeTable(pos, WDL, 0, state);
+            if (state == ProbeState::Fail) return 0;
+        }
+        if (bestValue >= value) {
+            state = bestValue > 0 || noMoreMoves ? ProbeState::ZeroingBestMove : ProbeState::Ok;
+            return bestValue;
+        }
+        state = ProbeState::Ok;
+        return value;
+    }
+
+    static int dtzBeforeZeroing(int wdl) {
+        return wdl == 2 ? 1 : wdl == 1 ? 101 : wdl == -1 ? -101 : wdl == -2 ? -1 : 0;
+    }
+
+public:
+    // Every legal move, promotions expanded. MoveGen has no en passant or
+    // castling, the tables do not cover castling rights anyway.
+    static std::vector<TbMove> legalMoves(const Position& pos) {
+        Position copy = pos;
+        MoveGen gen(copy.board);
+        std::vector<TbMove> moves;
+        int pawn = pos.whiteToMove ? WP : BP;
+        int enemy = pos.whiteToMove ? BP : WP;
+        for (const Move& move : gen.GenerateMoves(pos.whiteToMove)) {
+            bool isPawn = pos.board[pawn] & (1ULL << move.from());
+            bool capture = false;
+            for (int piece = enemy; piece < enemy + 6; piece++) capture |= bool(pos.board[piece] & (1ULL << move.to()));
+            if (pos.board[enemy + 5] & (1ULL << move.to())) continue;
+
+            bool promotes = isPawn && (move.to() >> 3 == 7 || move.to() >> 3 == 0);
+            for (int promotion = promotes ? WQ : -1; promotion >= (promotes ? WN : -1); promotion--) {
+                TbMove m{move, promotion < 0 ? -1 : promotion + (pos.whiteToMove ? 0 : 6), isPawn || capture};
+                Position next = play(pos, m);
+                if (!kingAttacked(next.board, pos.whiteToMove)) moves.push_back(m);
+                if (!promotes) break;
+            }
+        }
+        return moves;
+    }
+
+    SyzygyTablebases() = default;
+
+    // Directories separated by ':' (';' on Windows). Replaces the tables
+    // found before; nothing is mapped until probed.
+    int setPath(const std::string& paths) {
+        std::lock_guard<std::mutex> lock(m_mappingMutex);
+        m_tables.clear();
+        m_byKey.clear();
+        m_maxPieces = 0;
+
+#if defined(_WIN32)
+        const char separator = ';';
+#else
+        const char separator = ':';
+#endif
+        size_t start = 0;
+        while (start <= paths.size()) {
+            size_t end = paths.find(separator, start);
+            std::string directory = paths.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            start = end == std::string::npos ? paths.size() + 1 : end + 1;
+            if (directory.empty() || directory == "<empty>") continue;
+
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+                std::string extension = entry.path().extension().string();
+                if (extension == ".rtbw") addTable(entry.path().stem().string(), WDL, entry.path().string());
+                else if (extension == ".rtbz") addTable(entry.path().stem().string(), DTZ, entry.path().string());
+            }
+        }
+        return static_cast<int>(m_tables.size());
+    }
+
+    // Largest piece count with a WDL table
+    int maxPieces() const { return m_maxPieces; }
+
+    // Win / draw / loss for the side to move (-2 ... 2). Fails on positions
+    // without a table and on illegal ones (side not to move in check).
+    int probeWdl(const Position& pos, ProbeState& state) const {
+        state = ProbeState::Ok;
+        Position copy = pos;
+        if (kingAttacked(copy.board, !pos.whiteToMove) || !pos.board[WK] || !pos.board[BK]) {
+            state = ProbeState::Fail;
+            return 0;
+        }
+        return search<false>(pos, state);
+    }
+
+    // Distance to zeroing (capture or pawn move) in plies, signed like the
+    // WDL value: positive wins, 1 means the winning zeroing move is next.
+    // Plus or minus 100 and more for results the 50 move rule spoils.
+    int probeDtz(const Position& pos, ProbeState& state) const {
+        state = ProbeState::Ok;
+        int wdl = search<true>(pos, state);
+        if (state == ProbeState::Fail || wdl == 0) return 0;
+        if (state == ProbeState::ZeroingBestMove) return dtzBeforeZeroing(wdl);
+
+        int dtz = probeTable(pos, DTZ, wdl, state);
+        if (state == ProbeState::Fail) return 0;
+        if (state != ProbeState::ChangeSideToMove) {
+            return (dtz + 100 * (wdl == -1 || wdl == 1)) * (wdl > 0 ? 1 : -1);
+        }
+
+        // The file has the other side to move: one ply search for the move
+        // with the best DTZ
+        int minDtz = 0xFFFF;
+        for (const TbMove& m : legalMoves(pos)) {
+            Position next = play(pos, m);
+            dtz = m.zeroing ? -dtzBeforeZeroing(search<false>(next, state)) : -probeDtz(next, state);
+            if (dtz == 1 && kingAttacked(next.board, next.whiteToMove) && legalMoves(next).empty()) {
+                minDtz = 1;
+            }
+            if (!m.zeroing) dtz += dtz > 0 ? 1 : dtz < 0 ? -1 : 0;
+            if (dtz < minDtz && (dtz > 0) == (wdl > 0) && dtz != 0) minDtz = dtz;
+            if (state == ProbeState::Fail) return 0;
+        }
+        return minDtz == 0xFFFF ? -1 : minDtz;
+    }
+
+    // DTZ of every legal root move, from the root side's point of view:
+    // positive wins in that many plies to zeroing, 0 draws, negative loses
+    std::vector<std::pair<TbMove, int>> rankRootMoves(const Position& root, ProbeState& state) const {
+        std::vector<std::pair<TbMove, int>> ranked;
+        state = ProbeState::Ok;
+        for (const TbMove& m : legalMoves(root)) {
+            Position next = play(root, m);
+            int dtz;
+            if (m.zeroing) {
+                dtz = dtzBeforeZeroing(-probeWdl(next, state));
+            } else {
+                dtz = -probeDtz(next, state);
+                dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+            }
+            if (state == ProbeState::Fail) return {};
+            if (dtz == 2 && kingAttacked(next.board, next.whiteToMove) && legalMoves(next).empty()) {
+                dtz = 1;  // mate
+            }
+            ranked.push_back({m, dtz});
+        }
+        return ranked;
+    }
+
+private:
+    void addTable(const std::string& name, TableType type, const std::string& path) {
+        size_t split = name.find('v');
+        if (split == std::string::npos || name.size() - 1 > MAX_PIECES || name[0] != 'K' ||
+            split + 1 >= name.size() || name[split + 1] != 'K') {
+            return;
+        }
+
+        // Counts with the named first side as white and as black
+        uint64_t key = 0, key2 = 0;
+        int counts[12]{};
+        for (size_t i = 0; i < name.size(); i++) {
+            if (i == split) continue;
+            const char* letter = std::strchr("PNBRQK", name[i]);
+            if (!letter || !*letter) return;
+            int type = static_cast<int>(letter - "PNBRQK");
+            bool white = i < split;
+            counts[type + (white ? 0 : 6)]++;
+            key += 1ULL << (4 * (type + (white ? 0 : 6)));
+            key2 += 1ULL << (4 * (type + (white ? 6 : 0)));
+        }
+
+        Table* table;
+        auto it = m_byKey.find(key);
+        if (it != m_byKey.end()) {
+            table = it->second;
+        } else {
+            m_tables.push_back(std::make_unique<Table>());
+            table = m_tables.back().get();
+            table->name = name;
+            table->key = key;
+            table->key2 = key2;
+            table->pieceCount = static_cast<int>(name.size() - 1);
+            table->hasPawns = counts[WP] || counts[BP];
+            for (int piece = 0; piece < 12; piece++) {
+                if (piece % 6 != WK && counts[piece] == 1) table->hasUniquePieces = true;
+            }
+            // Leading colour: the side with fewer pawns, if both have some
+            bool whiteLeads = !counts[BP] || (counts[WP] && counts[BP] >= counts[WP]);
+            table->pawnCount[0] = whiteLeads ? counts[WP] : counts[BP];
+            table->pawnCount[1] = whiteLeads ? counts[BP] : counts[WP];
+            m_byKey[key] = table;
+            m_byKey[key2] = table;
+        }
+        table->files[type].path = path;
+        if (type == WDL) {
+            m_maxPieces = std::max(m_maxPieces, table->pieceCount);
+        }
+    }
+};
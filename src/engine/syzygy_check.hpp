@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <algorithm>
+#include "bitbase.hpp"
+#include "board.hpp"
+#include "syzygy.hpp"
+
+// Checks the Syzygy decoder (syzygy.hpp) against real tables: a handful of
+// positions whose result every chess player knows, then every legal 3 piece
+// position against our own bitbases, which come from a separate generator
+// (bitbase_gen.hpp) and share no code with the Syzygy decoding. Material
+// without a table is skipped, so it runs on any subset of the files.
+namespace SyzygyCheck {
+
+struct Summary {
+    uint64_t checked{0};
+    uint64_t skipped{0};
+    uint64_t mismatches{0};
+};
+
+struct KnownPosition {
+    const char* fen;
+    int wdl;  // for the side to move, -2 .. 2
+    const char* what;
+};
+
+// WDL from the side to move; 3 and 4 piece tables have no 50 move results
+inline const KnownPosition KNOWN[] = {
+    {"8/8/8/4k3/8/8/8/KQ6 w - - 0 1", 2, "KQvK, white to move wins"},
+    {"8/8/8/4k3/8/8/8/KQ6 b - - 0 1", -2, "KQvK, black to move loses"},
+    {"8/8/8/4k3/8/8/8/KR6 b - - 0 1", -2, "KRvK, black to move loses"},
+    {"8/8/8/4k3/8/8/8/KB6 w - - 0 1", 0, "KBvK draws"},
+    {"8/8/8/4k3/8/8/8/KN6 w - - 0 1", 0, "KNvK draws"},
+    {"8/8/8/4k3/8/8/8/KNN5 w - - 0 1", 0, "KNNvK draws"},
+    {"r7/8/2k5/8/8/5K2/8/7R w - - 0 1", 0, "KRvKR draws"},
+    {"r7/8/2k5/8/8/5K2/8/7R b - - 0 1", 0, "KRvKR draws, black to move"},
+    {"8/8/8/3k4/8/8/1r6/KQ6 w - - 0 1", 2, "KQvKR, white takes the rook"},
+    {"8/8/8/3k4/8/8/1r6/KQ6 b - - 0 1", 0, "KQvKR, black takes the queen"},
+    {"4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", 2, "KPvK, king on the sixth wins"},
+    {"4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", -2, "KPvK, king on the sixth wins, black to move"},
+    {"4k3/4P3/4K3/8/8/8/8/8 w - - 0 1", 0, "KPvK, white to move cannot make progress"},
+    {"4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", 0, "KPvK, black is stalemated"},
+    {"k7/8/8/8/8/8/P7/K7 w - - 0 1", 0, "KPvK, rook pawn with the king in the corner"},
+};
+
+inline int bitbaseWdl(Wdl wdl) {
+    return wdl == Wdl::Win ? 2 : wdl == Wdl::Loss ? -2 : 0;
+}
+
+// The known positions, with DTZ checked for agreeing in sign with the WDL
+// value when the .rtbz is there too
+inline Summary knownPositions(const SyzygyTablebases& tables, std::ostream& out) {
+    Summary summary;
+    for (const KnownPosition& known : KNOWN) {
+        SyzygyTablebases::Position position{ChessBoard(12, 0), true};
+        FenState state;
+        parseFen(known.fen, position.board, state);
+        position.whiteToMove = state.whiteToMove;
+
+        SyzygyTablebases::ProbeState probe;
+        int wdl = tables.probeWdl(position, probe);
+        if (probe == SyzygyTablebases::ProbeState::Fail) {
+            out << "skipped  " << known.what << " (no table)\n";
+            summary.skipped++;
+            continue;
+        }
+        summary.checked++;
+        std::string line = known.what + std::string(": wdl ") + std::to_string(wdl);
+        bool good = wdl == known.wdl;
+        int dtz = tables.probeDtz(position, probe);
+        if (probe != SyzygyTablebases::ProbeState::Fail) {
+            line += ", dtz " + std::to_string(dtz);
+            good &= (dtz > 0) == (wdl > 0) && (dtz < 0) == (wdl < 0);
+        }
+        if (!good) {
+            summary.mismatches++;
+            line += ", expected wdl " + std::to_string(known.wdl);
+        }
+        out << (good ? "ok       " : "WRONG    ") << line << "  " << known.fen << "\n";
+    }
+    return summary;
+}
+
+// Every legal position of each 3 piece material both have, both sides to move
+inline Summary compareWithBitbases(const SyzygyTablebases& tables, const Bitbases& bitbases, std::ostream& out) {
+    static constexpr int STRONG[] = {WP, WN, WB, WR, WQ};
+    static constexpr const char* NAMES[] = {"KPvK", "KNvK", "KBvK", "KRvK", "KQvK"};
+    Summary summary;
+    SyzygyTablebases::Position position{ChessBoard(12, 0), true};
+    for (int material = 0; material < 5; material++) {
+        int piece = STRONG[material];
+        uint64_t checked = 0, mismatches = 0;
+        bool missing = false;
+        for (int whiteKing = 0; whiteKing < 64 && !missing; whiteKing++) {
+            for (int blackKing = 0; blackKing < 64 && !missing; blackKing++) {
+                if (Attacks::king(whiteKing) & (1ULL << blackKing) || whiteKing == blackKing) continue;
+                for (int square = 0; square < 64 && !missing; square++) {
+                    if (square == whiteKing || square == blackKing) continue;
+                    if (piece == WP && (square < 8 || square >= 56)) continue;
+                    std::fill(position.board.begin(), position.board.end(), 0);
+                    position.board[WK] = 1ULL << whiteKing;
+                    position.board[BK] = 1ULL << blackKing;
+                    position.board[piece] = 1ULL << square;
+                    for (bool white : {true, false}) {
+                        position.whiteToMove = white;
+                        Wdl expected = bitbases.probe(position.board, white);
+                        if (expected == Wdl::Illegal) continue;  // side not to move in check
+                        SyzygyTablebases::ProbeState probe;
+                        int wdl = tables.probeWdl(position, probe);
+                        if (probe == SyzygyTablebases::ProbeState::Fail) {
+                            missing = true;
+                            break;
+                        }
+                        checked++;
+                        if ((wdl > 0 ? 2 : wdl < 0 ? -2 : 0) != bitbaseWdl(expected) && mismatches++ < 5) {
+                            FenState state;
+                            state.whiteToMove = white;
+                            out << "WRONG    " << NAMES[material] << " " << boardToFen(position.board, state)
+                                << ": syzygy " << wdl << ", bitbase " << bitbaseWdl(expected) << "\n";
+                        }
+                    }
+                }
+            }
+        }
+        if (missing) {
+            out << "skipped  " << NAMES[material] << " (no table)\n";
+            summary.skipped++;
+            continue;
+        }
+        char text[128];
+        std::snprintf(text, sizeof(text), "%-8s %s against the bitbase: %llu positions, %llu differ\n",
+                      mismatches ? "WRONG" : "ok", NAMES[material], static_cast<unsigned long long>(checked),
+                      static_cast<unsigned long long>(mismatches));
+        out << text;
+        summary.checked += checked;
+        summary.mismatches += mismatches;
+    }
+    return summary;
+}
+
+}  // namespace SyzygyCheck
@@ -0,0 +1,312 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "bitbase.hpp"
+#include "board.hpp"
+#include "epd_reader.hpp"
+#include "movegen.hpp"
+#include "referee.hpp"
+#include "search.hpp"
+#include "../eval/evaluation.hpp"
+
+// Runs a test suite: EPD positions with "bm" (best move, any of them) and/or
+// "am" (avoid move) operations, WAC / ECM style. Every position is searched
+// with the same limits. The search reports each completed iteration, and a
+// position counts as solved at the first iteration whose best move was right
+// and stayed right until the end. Its time to solve is the time and nodes of
+// that iteration.
+//
+// Positions are handed to the workers from one shared counter, each worker
+// with its own single-threaded search. Time to solve is measured per search,
+// but with more threads than cores the searches share the CPU, and the times
+// grow accordingly.
+class SuiteRunner {
+public:
+    struct Options {
+        SearchLimits limits;
+        unsigned threads{1};
+        size_t hashMegabytes{16};  // per worker
+    };
+
+    struct Result {
+        uint64_t line{0};
+        std::string id;
+        std::string fen;
+        std::string expected;  // "bm Nf6 Bc5" / "am Qxb2"
+        Move best;
+        bool solved{false};
+        int64_t solveMs{0};    // of the iteration that found the move for good
+        uint64_t solveNodes{0};
+        int solveDepth{0};
+        uint64_t nodes{0};     // whole search
+        std::string error;     // position skipped, e.g. a move in bm is not legal
+    };
+
+    struct Summary {
+        size_t positions{0};
+        size_t solved{0};
+        size_t skipped{0};
+        uint64_t nodes{0};
+        double seconds{0.0};
+        std::vector<int64_t> solveMs;  // of the solved positions, sorted
+    };
+
+private:
+    struct Position {
+        uint64_t line;
+        std::string text;
+    };
+
+    Options m_options;
+    const Bitbases* m_bitbases;
+    std::vector<Position> m_positions;
+    std::atomic<size_t> m_next{0};
+    std::mutex m_mutex;  // output and summary
+    Summary m_summary;
+
+    // SAN of a legal move, without check marks: "Nbd7", "exd5", "O-O", "e8=Q"
+    static std::string toSan(const ChessBoard& board, bool white, const Move& move, const std::vector<Move>& legal) {
+        if (move.isCastling()) {
+            return (move.to() & 7) == 6 ? "O-O" : "O-O-O";
+        }
+        int friendly = white ? WP : BP;
+        int piece = friendly;
+        while (!(board[piece] & (1ULL << move.from()))) piece++;
+        uint64_t occupied = 0;
+        for (int i = WP; i <= BK; i++) occupied |= board[i];
+        bool capture = (occupied & (1ULL << move.to())) || move.isEnPassant();
+
+        std::string san;
+        std::string to = moveToString(move).substr(2, 2);
+        if (piece == friendly) {
+            if (capture) san = std::string(1, static_cast<char>('a' + (move.from() & 7))) + "x";
+            san += to;
+            if (move.to() >= 56 || move.to() < 8) {
+                san += "=";
+                san += "PNBRQK"[move.isPromotion() ? move.promotionType() : WQ - WP];
+            }
+            return san;
+        }
+
+        san = std::string(1, "PNBRQK"[piece - friendly]);
+        bool sameFile = false, sameRank = false, ambiguous = false;
+        for (const Move& other : legal) {
+            if (other.to() != move.to() || other.from() == move.from() ||
+                !(board[piece] & (1ULL << other.from()))) {
+                continue;
+            }
+            ambiguous = true;
+            sameFile |= (other.from() & 7) == (move.from() & 7);
+            sameRank |= (other.from() >> 3) == (move.from() >> 3);
+        }
+        if (ambiguous) {
+            std::string from = moveToString(move).substr(0, 2);
+            san += !sameFile ? from.substr(0, 1) : !sameRank ? from.substr(1, 1) : from;
+        }
+        return san + (capture ? "x" : "") + to;
+    }
+
+    // The legal moves a bm / am operand names, in SAN or coordinates.
+    // False if one of them is not a legal move here.
+    static bool parseMoves(const ChessBoard& board, bool white, const std::vector<Move>& legal,
+                           std::string_view operand, std::vector<Move>& moves) {
+        std::istringstream words{std::string(operand)};
+        std::string word;
+        while (words >> word) {
+            while (!word.empty() && std::strchr("+#!?", word.back())) word.pop_back();
+            std::replace(word.begin(), word.end(), '0', 'O');  // "0-0"
+            const Move* found = nullptr;
+            for (const Move& move : legal) {
+                if (toSan(board, white, move, legal) == word || moveToString(move) == word) {
+                    found = &move;
+                    break;
+                }
+            }
+            if (!found) {
+                return false;
+            }
+            moves.push_back(*found);
+        }
+        return true;
+    }
+
+    struct Searcher {
+        ChessBoard board;
+        MoveGen moveGen;
+        Evaluation evaluator;
+        MinimaxSearch search;
+
+        Searcher(size_t hashMegabytes, const Bitbases* bitbases)
+            : board(12, 0), moveGen(board), evaluator(board, moveGen), search(board, moveGen, evaluator) {
+            search.setHashSize(hashMegabytes);
+            search.setBitbases(bitbases);
+        }
+    };
+
+    static bool contains(const std::vector<Move>& moves, const Move& move) {
+        return std::find(moves.begin(), moves.end(), move) != moves.end();
+    }
+
+    Result solve(Searcher& searcher, const Position& position) {
+        Result result;
+        result.line = position.line;
+        FenState state;
+        std::string_view operations;
+        const char* error = nullptr;
+        if (!parseEpd(position.text, searcher.board, state, operations, &error)) {
+            result.fen = position.text;
+            result.error = std::string("bad position: ") + (error ? error : "?");
+            return result;
+        }
+        result.fen = boardToFen(searcher.board, state);
+        result.id = std::string(epdOperation(operations, "id"));
+        std::string_view bm = epdOperation(operations, "bm"), am = epdOperation(operations, "am");
+        if (!bm.empty()) result.expected = "bm " + std::string(bm);
+        if (!am.empty()) result.expected += (result.expected.empty() ? "am " : ", am ") + std::string(am);
+
+        bool white = state.whiteToMove;
+        std::vector<Move> legal = Referee::legalMoves(searcher.board, white), best, avoid;
+        if (bm.empty() && am.empty()) {
+            result.error = "no bm or am";
+            return result;
+        }
+        if (!parseMoves(searcher.board, white, legal, bm, best) ||
+            !parseMoves(searcher.board, white, legal, am, avoid)) {
+            result.error = "move in " + result.expected + " is not legal here";
+            return result;
+        }
+        auto correct = [&](const Move& move) {
+            return (best.empty() || contains(best, move)) && !contains(avoid, move);
+        };
+
+        // The iteration from which the best move has been right
+        bool streak = false;
+        searcher.search.clearHash();
+        searcher.search.setInfoCallback([&](const SearchInfo& info) {
+            if (info.multiPV != 1 || info.pv.empty()) return;
+            if (!correct(info.pv[0])) {
+                streak = false;
+            } else if (!streak) {
+                streak = true;
+                result.solveMs = info.timeMs;
+                result.solveNodes = info.nodes;
+                result.solveDepth = info.depth;
+            }
+        });
+        try {
+            result.best = searcher.search.search(white, m_options.limits);
+            result.solved = streak && correct(result.best);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        searcher.search.setInfoCallback(nullptr);
+        result.nodes = searcher.search.nodeCount();
+        return result;
+    }
+
+    static void print(const Result& result, std::ostream& out) {
+        std::ostringstream line;
+        line << result.line << ": " << (result.id.empty() ? result.fen : result.id) << " | ";
+        if (!result.error.empty()) {
+            line << "skipped, " << result.error;
+        } else if (result.solved) {
+            line << "solved " << moveToString(result.best) << " in " << result.solveMs << " ms, "
+                 << result.solveNodes << " nodes, depth " << result.solveDepth;
+        } else {
+            line << "FAILED " << moveToString(result.best) << ", " << result.expected;
+        }
+        out << line.str() << "\n" << std::flush;
+    }
+
+    void work(std::ostream& out) {
+        Searcher searcher(m_options.hashMegabytes, m_bitbases);
+        for (size_t index = m_next++; index < m_positions.size(); index = m_next++) {
+            Result result = solve(searcher, m_positions[index]);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            print(result, out);
+            if (!result.error.empty()) {
+                m_summary.skipped++;
+                continue;
+            }
+            m_summary.positions++;
+            m_summary.nodes += result.nodes;
+            if (result.solved) {
+                m_summary.solved++;
+                m_summary.solveMs.push_back(result.solveMs);
+            }
+        }
+    }
+
+public:
+    SuiteRunner(const Options& options, const Bitbases* bitbases = nullptr)
+        : m_options(options), m_bitbases(bitbases) {
+        m_options.threads = std::max(1u, m_options.threads);
+    }
+
+    // Suites are small, the lines are read up front
+    Summary run(EpdReader& reader, std::ostream& out) {
+        auto start = std::chrono::steady_clock::now();
+        std::string_view line;
+        while (reader.next(line)) {
+            m_positions.push_back({reader.lineNumber(), std::string(line)});
+        }
+
+        std::vector<std::thread> workers;
+        unsigned threads = std::min<unsigned>(m_options.threads, std::max<size_t>(1, m_positions.size()));
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back([this, &out] { work(out); });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        m_summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::sort(m_summary.solveMs.begin(), m_summary.solveMs.end());
+        return m_summary;
+    }
+
+    // Solved count, percentiles and a histogram of the times to solve
+    static void report(const Summary& summary, std::ostream& out) {
+        char text[160];
+        std::snprintf(text, sizeof(text), "Solved %zu of %zu (%.1f%%), %zu skipped, %.2f s, %llu nodes\n",
+                      summary.solved, summary.positions,
+                      summary.positions ? 100.0 * summary.solved / summary.positions : 0.0, summary.skipped,
+                      summary.seconds, static_cast<unsigned long long>(summary.nodes));
+        out << text;
+        const std::vector<int64_t>& times = summary.solveMs;
+        if (times.empty()) {
+            return;
+        }
+        auto percentile = [&times](double p) {
+            return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))];
+        };
+        std::snprintf(text, sizeof(text), "Time to solve: p50 %lld ms, p90 %lld ms, max %lld ms\n",
+                      static_cast<long long>(percentile(0.5)), static_cast<long long>(percentile(0.9)),
+                      static_cast<long long>(times.back()));
+        out << text;
+
+        static constexpr int64_t BOUNDS[] = {10, 100, 1000, 10000};
+        static constexpr const char* LABELS[] = {"< 10 ms", "< 100 ms", "< 1 s", "< 10 s", ">= 10 s"};
+        size_t counts[5] = {};
+        for (int64_t ms : times) {
+            int bucket = 0;
+            while (bucket < 4 && ms >= BOUNDS[bucket]) bucket++;
+            counts[bucket]++;
+        }
+        for (int bucket = 0; bucket < 5; bucket++) {
+            std::snprintf(text, sizeof(text), "  %-9s %5zu  ", LABELS[bucket], counts[bucket]);
+            out << text << std::string(counts[bucket] * 40 / times.size(), '#') << "\n";
+        }
+    }
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Everything a "go" command can ask for. Zero means "not set".
+struct SearchLimits {
+    int depth{0};
+    uint64_t nodes{0};
+    int64_t movetime{0};
+    int64_t wtime{0};
+    int64_t btime{0};
+    int64_t winc{0};
+    int64_t binc{0};
+    int movestogo{0};
+    bool infinite{false};
+    bool ponder{false};
+    int64_t moveOverhead{30};  // ms kept back for GUI / OS latency, 0 in process
+};
+
+// Decides how long a search may run. The budget is worked out once per "go",
+// the clock only starts when start() is called - for a ponder search that is
+// at ponderhit, so time spent thinking on the opponent's clock is never
+// charged to us.
+class TimeManager {
+private:
+    int64_t m_optimumMs{0};   // stop starting new iterations after this
+    int64_t m_maximumMs{0};   // abort the running iteration after this
+    bool m_timed{false};
+    std::atomic<int64_t> m_startNs{0};
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    // Work out the budget for the side to move, does not start the clock
+    void init(const SearchLimits& limits, bool isWhite) {
+        int64_t time = isWhite ? limits.wtime : limits.btime;
+        int64_t inc = isWhite ? limits.winc : limits.binc;
+
+        m_timed = true;
+        if (limits.movetime > 0) {
+            m_optimumMs = m_maximumMs = std::max<int64_t>(1, limits.movetime - limits.moveOverhead);
+        } else if (time > 0) {
+            int movesLeft = limits.movestogo > 0 ? std::min(limits.movestogo, 40) : 30;
+            int64_t usable = std::max<int64_t>(1, time - limits.moveOverhead);
+            m_optimumMs = std::min(usable, usable / movesLeft + inc * 3 / 4);
+            m_maximumMs = std::min(usable * 3 / 4, m_optimumMs * 4);
+            m_maximumMs = std::max(m_maximumMs, m_optimumMs);
+        } else {
+            m_timed = false;  // depth / nodes / infinite, no clock involved
+            m_optimumMs = m_maximumMs = 0;
+        }
+        start();
+    }
+
+    void start() {
+        m_startNs.store(nowNs());
+    }
+
+    int64_t elapsedMs() const {
+        return (nowNs() - m_startNs.load()) / 1000000;
+    }
+
+    bool isTimed() const { return m_timed; }
+
+    // Checked between iterations, the next one would most likely not finish
+    bool softLimitReached() const {
+        return m_timed && elapsedMs() >= m_optimumMs / 2;
+    }
+
+    // Checked inside the search
+    bool hardLimitReached() const {
+        return m_timed && elapsedMs() >= m_maximumMs;
+    }
+};
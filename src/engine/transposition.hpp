@@ -0,0 +1,278 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "movegen.hpp"
+#include "../utils/mapped_file.hpp"
+#include "../utils/zobrist.hpp"
+
+// What the stored score tells us about the real score of the node
+enum class Bound : uint8_t { None, Exact, Lower, Upper };
+
+// 16 bytes, four entries to a cache line. Depths stay below MAX_PLY and
+// float keeps scores to well under a centipawn.
+//
+// The key is stored XORed with the other 8 bytes. Two processes (or
+// threads) writing the same slot at once can leave half of each entry
+// behind; such a torn entry no longer matches its key and just misses.
+struct TTEntry {
+    uint64_t key{0};
+    float score{0.0f};
+    Move bestMove{};
+    int8_t depth{0};
+    Bound bound : 2 {Bound::None};
+    uint8_t generation : 6 {0};  // search that wrote it, for aging
+
+    uint64_t data() const {
+        uint64_t word;
+        std::memcpy(&word, reinterpret_cast<const char*>(this) + sizeof(key), sizeof(word));
+        return word;
+    }
+};
+
+static_assert(sizeof(TTEntry) == 16, "TT entries should stay 16 bytes");
+
+// First 64 bytes of a hash file, the entries follow
+struct TTFileHeader {
+    static constexpr char MAGIC[8] = {'L', 'A', 'N', 'C', 'E', 'R', 'T', 'T'};
+    // Bump when the entry layout or the meaning of scores changes
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t entryCount;
+    uint64_t keySignature;  // Zobrist keys the entries were hashed with
+    uint64_t checksum;      // of the fields above
+    uint32_t generation;    // of the last search, every process bumps it atomically
+    uint8_t reserved[20];
+
+    static uint64_t expectedSignature() {
+        return Zobrist::piece(WP, 8) ^ Zobrist::piece(BK, 60) ^ Zobrist::sideToMove();
+    }
+
+    // FNV-1a over the fixed fields; the generation changes all the time and
+    // is left out, a torn write of it must not throw the table away
+    uint64_t computeChecksum() const {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        const auto* bytes = reinterpret_cast<const uint8_t*>(this);
+        for (size_t i = 0; i < offsetof(TTFileHeader, checksum); i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    bool isValid(uint64_t expectedCount) const {
+        return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 && version == VERSION &&
+               entrySize == sizeof(TTEntry) && entryCount == expectedCount &&
+               keySignature == expectedSignature() && checksum == computeChecksum();
+    }
+};
+
+static_assert(sizeof(TTFileHeader) == 64, "the entries start on a cache line");
+
+// Hash table of already searched positions, indexed by Zobrist key.
+// Lives as long as its owner so results survive from one search to the next
+// (iterative deepening, pondering, consecutive moves of a game).
+//
+// With attachFile the table lives in a memory-mapped file instead, so it
+// also survives the process: a later analysis session starts with the deep
+// results of the earlier ones, and engines running at the same time share
+// them. Every search() is a new generation; entries from older generations
+// lose depth priority and get replaced first. The generation is counted in
+// the file header, so all processes on one file age entries alike.
+class TranspositionTable {
+private:
+    static constexpr int GENERATIONS = 64;  // 6 bits in TTEntry
+    static constexpr int AGE_PENALTY = 2;   // plies of priority lost per generation
+
+    std::vector<TTEntry> m_entries;
+    MappedFile m_file;
+    std::string m_path;
+    TTEntry* m_table{nullptr};
+    TTFileHeader* m_header{nullptr};
+    uint64_t m_mask{0};
+    size_t m_megabytes{0};
+    // Searches so far, modulo GENERATIONS for the entries. Atomic because a
+    // table shared by threads (GameHost) is aged by all of them.
+    std::atomic<uint32_t> m_generation{0};
+    std::atomic<uint32_t> m_agingInterval{1};
+    std::atomic<uint32_t> m_searches{0};
+
+    static size_t entryCount(size_t megabytes) {
+        size_t count = 1;
+        // Largest power of two that fits, so we can mask instead of modulo
+        while (count * 2 * sizeof(TTEntry) <= megabytes * 1024 * 1024) {
+            count *= 2;
+        }
+        return count;
+    }
+
+    uint8_t generation() const {
+        return static_cast<uint8_t>(m_generation.load(std::memory_order_relaxed) % GENERATIONS);
+    }
+
+    int age(const TTEntry& entry) const {
+        return (generation() - entry.generation + GENERATIONS) % GENERATIONS;
+    }
+
+    std::atomic_ref<uint32_t> sharedGeneration() const {
+        return std::atomic_ref<uint32_t>(m_header->generation);
+    }
+
+    bool failAttach(const char** error, const char* reason) {
+        if (error) *error = reason;
+        detachFile();
+        return false;
+    }
+
+public:
+    explicit TranspositionTable(size_t megabytes = 16) {
+        resize(megabytes);
+    }
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // A file-backed table is attached again at the new size, which only
+    // works for a file made with that size; otherwise it goes to memory.
+    bool resize(size_t megabytes, const char** error = nullptr) {
+        m_megabytes = megabytes;
+        if (isPersistent()) {
+            if (entryCount(megabytes) == m_mask + 1) {
+                return true;
+            }
+            return attachFile(m_path, megabytes, error);
+        }
+        m_entries.assign(entryCount(megabytes), TTEntry{});
+        m_table = m_entries.data();
+        m_mask = m_entries.size() - 1;
+        return true;
+    }
+
+    // Backs the table with a file of about `megabytes`. A new file is set up
+    // under a temporary name and then linked into place, so other engines
+    // only ever see complete ones. An existing file is used as it is and
+    // never resized, since other processes may have it mapped: if it was
+    // made with another size, version or keys we do not attach, and the
+    // table stays in memory with the reason in error if asked for.
+    bool attachFile(const std::string& path, size_t megabytes, const char** error = nullptr) {
+        m_megabytes = megabytes;
+        size_t count = entryCount(megabytes);
+        size_t bytes = sizeof(TTFileHeader) + count * sizeof(TTEntry);
+        MappedFile file;
+        if (!file.openWritable(path)) {
+            if (!file.createWritable(path, bytes)) {
+                return failAttach(error, "cannot create it");
+            }
+            TTFileHeader header{};
+            std::memcpy(header.magic, TTFileHeader::MAGIC, sizeof(header.magic));
+            header.version = TTFileHeader::VERSION;
+            header.entrySize = sizeof(TTEntry);
+            header.entryCount = count;
+            header.keySignature = TTFileHeader::expectedSignature();
+            header.checksum = header.computeChecksum();
+            std::memcpy(file.writableData(), &header, sizeof(header));
+            // Somebody else may have created it meanwhile, then theirs counts
+            if (!file.publish(path) && !file.openWritable(path)) {
+                return failAttach(error, "cannot open it");
+            }
+        }
+        auto* header = reinterpret_cast<TTFileHeader*>(file.writableData());
+        if (file.size() != bytes) {
+            return failAttach(error, "it was made with another Hash size");
+        }
+        if (!header->isValid(count)) {
+            return failAttach(error, "it was made by another version");
+        }
+
+        m_file = std::move(file);
+        m_path = path;
+        m_header = header;
+        m_table = reinterpret_cast<TTEntry*>(m_file.writableData() + sizeof(TTFileHeader));
+        m_mask = count - 1;
+        m_entries.clear();
+        m_entries.shrink_to_fit();
+        m_generation.store(sharedGeneration().load(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // Back to a private in-memory table, the file keeps what it has
+    void detachFile() {
+        m_file.close();
+        m_header = nullptr;
+        m_table = nullptr;
+        resize(m_megabytes);
+    }
+
+    bool isPersistent() const { return m_header != nullptr; }
+    size_t megabytes() const { return m_megabytes; }
+
+    // Wipes an in-memory table. A file-backed one is shared and meant to
+    // outlive us, so it is left alone: the next search moves on a generation,
+    // and everything in it gets old and is replaced before anything new.
+    void clear() {
+        if (isPersistent()) {
+            return;
+        }
+        std::fill(m_entries.begin(), m_entries.end(), TTEntry{});
+    }
+
+    // Only every `searches`-th newSearch starts a new generation. A table
+    // shared by many games would otherwise go through all 64 generations in
+    // 64 moves of any of them, and age entries by chance.
+    void setAgingInterval(uint32_t searches) {
+        m_agingInterval.store(std::max(1u, searches), std::memory_order_relaxed);
+    }
+
+    // Called at the start of every search. A file-backed table takes its
+    // generation from the file, where every process counts its searches.
+    void newSearch() {
+        uint32_t interval = m_agingInterval.load(std::memory_order_relaxed);
+        if (interval > 1 && m_searches.fetch_add(1, std::memory_order_relaxed) % interval != 0) {
+            return;
+        }
+        if (m_header) {
+            m_generation.store(sharedGeneration().fetch_add(1) + 1, std::memory_order_relaxed);
+        } else {
+            m_generation.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool probe(uint64_t key, TTEntry& out) const {
+        TTEntry entry = m_table[key & m_mask];
+        if (entry.bound == Bound::None || (entry.key ^ entry.data()) != key) {
+            return false;
+        }
+        out = entry;
+        out.key = key;
+        return true;
+    }
+
+    void store(uint64_t key, int depth, double score, Bound bound, const Move& bestMove) {
+        TTEntry& slot = m_table[key & m_mask];
+        TTEntry old = slot;
+        bool sameKey = (old.key ^ old.data()) == key;
+        // Keep deeper results for the same position. Another position's
+        // entry stays if it is deeper, counting 2 plies less per search since
+        // it was written, so old results make room unless they were deep.
+        if (sameKey && old.depth > depth && bound != Bound::Exact) {
+            return;
+        }
+        if (!sameKey && old.bound != Bound::None && old.depth - AGE_PENALTY * age(old) > depth) {
+            return;
+        }
+        TTEntry entry;
+        entry.score = static_cast<float>(score);
+        entry.bestMove = bestMove;
+        entry.depth = static_cast<int8_t>(depth);
+        entry.bound = bound;
+        entry.generation = generation();
+        entry.key = key ^ entry.data();
+        slot = entry;
+    }
+};
@@ -0,0 +1,407 @@
+#pragma once
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "bitbase.hpp"
+#include "board.hpp"
+#include "movegen.hpp"
+#include "referee.hpp"
+#include "search.hpp"
+#include "syzygy.hpp"
+#include "../eval/evaluation.hpp"
+#include "../network/book.hpp"
+#include "../network/network.hpp"
+
+// UCI front end, enough for a GUI or match runner to play timed games.
+// The search runs on its own thread so "stop" and "ponderhit" can reach it.
+//
+// Pondering: after "bestmove X ponder Y" the GUI plays X and Y on its board and
+// sends "go ponder". We search that position on the opponent's clock. If the
+// opponent plays Y the GUI sends "ponderhit" and the same search continues as
+// a normal timed one; otherwise it sends "stop" and the result is dropped.
+class UciEngine {
+private:
+    static constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    static constexpr const char* DEFAULT_BOOK = "database/book.bin";
+    static constexpr const char* DEFAULT_BITBASES = "database/bitbases";
+
+    ChessBoard m_board;
+    MoveGen m_moveGen;
+    Evaluation m_evaluator;
+    MinimaxSearch m_search;
+    OpeningBook m_book;
+    std::unique_ptr<ChessEngineDB> m_bookDatabase;  // BookFile pointing at a .db
+    Bitbases m_bitbases;
+    SyzygyTablebases m_syzygy;
+    int m_syzygyProbeDepth{1};
+    int m_syzygyProbeLimit{SyzygyTablebases::MAX_PIECES};
+    // The search takes table results as exact, so a decoding error would
+    // make it trust a wrong win or draw. Off until "Lancer-bot tbcheck" has
+    // passed on the real 3-4-5 piece files.
+    bool m_syzygySearch{false};
+    bool m_ownBook{true};
+    bool m_searchStats{false};
+    bool m_whiteToMove{true};
+    uint8_t m_castling{0};  // CastlingRight bits of the current position
+    int m_epSquare{-1};     // FenState::epSquare of the current position
+    std::thread m_searchThread;
+    std::mutex m_outputMutex;
+
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(m_outputMutex);
+        std::cout << line << std::endl;
+    }
+
+    void waitForSearch() {
+        if (m_searchThread.joinable()) {
+            m_searchThread.join();
+        }
+    }
+
+    void sendInfo(const SearchInfo& info) {
+        std::ostringstream line;
+        line << "info depth " << info.depth
+             << " multipv " << info.multiPV
+             << " score " << formatScore(info.score, m_whiteToMove)
+             << " nodes " << info.nodes
+             << " nps " << (info.nodes * 1000 / std::max<int64_t>(1, info.timeMs))
+             << " time " << info.timeMs
+             << " tbhits " << info.tbHits
+             << " pv";
+        for (const Move& move : info.pv) {
+            line << " " << moveToString(move);
+        }
+        send(line.str());
+    }
+
+    // UCI moves do not say what kind of move they are, the board does: a king
+    // moving two files castles, a pawn moving diagonally to an empty square
+    // takes en passant. False for anything that is not a legal move here.
+    // The generator has no castling or en passant moves, those two are
+    // checked against the castling rights and en passant square we keep;
+    // everything else has to be a generated move that does not leave the
+    // king in check, with a promotion piece exactly when a pawn promotes.
+    bool parseMove(const std::string& str, Move& move) {
+        if (str.size() < 4 || str.size() > 5 || str[0] < 'a' || str[0] > 'h' || str[1] < '1' || str[1] > '8' ||
+            str[2] < 'a' || str[2] > 'h' || str[3] < '1' || str[3] > '8') {
+            return false;
+        }
+        int from = (str[0] - 'a') + (str[1] - '1') * 8;
+        int to = (str[2] - 'a') + (str[3] - '1') * 8;
+        int friendly = m_whiteToMove ? WP : BP, enemy = m_whiteToMove ? BP : WP;
+        uint64_t fromBit = 1ULL << from, toBit = 1ULL << to;
+        uint64_t occupied = 0;
+        for (const auto& bitboard : m_board) {
+            occupied |= bitboard;
+        }
+
+        int kingHome = m_whiteToMove ? 4 : 60;
+        if ((m_board[friendly + WK] & fromBit) && from == kingHome && std::abs(to - from) == 2 && str.size() == 4) {
+            bool kingSide = to > from;
+            uint8_t right = m_whiteToMove ? (kingSide ? WHITE_OO : WHITE_OOO) : (kingSide ? BLACK_OO : BLACK_OOO);
+            int rookSquare = kingSide ? from + 3 : from - 4;
+            uint64_t between = kingSide ? 3ULL << (from + 1) : 7ULL << (from - 3);
+            int crossed = (from + to) / 2;
+            // Not out of, through or into check
+            if ((m_castling & right) && (m_board[friendly + WR] & (1ULL << rookSquare)) && !(occupied & between) &&
+                !m_moveGen.isSquareAttacked(from, !m_whiteToMove) &&
+                !m_moveGen.isSquareAttacked(crossed, !m_whiteToMove) &&
+                !m_moveGen.isSquareAttacked(to, !m_whiteToMove)) {
+                move = Move(from, to, Move::Castling);
+                return true;
+            }
+            return false;
+        }
+        int forward = m_whiteToMove ? 8 : -8;
+        int behind = to - forward;
+        if (to == m_epSquare && (m_board[friendly] & fromBit) && !(occupied & toBit) &&
+            std::abs(to - from - forward) == 1 && std::abs((to & 7) - (from & 7)) == 1 &&
+            (m_board[enemy] & (1ULL << behind)) && str.size() == 4) {
+            // Taking the pawn may uncover a check along the rank
+            ChessBoard next = m_board;
+            next[friendly] ^= fromBit | toBit;
+            next[enemy] &= ~(1ULL << behind);
+            if (Referee::inCheck(next, m_whiteToMove)) {
+                return false;
+            }
+            move = Move(from, to, Move::EnPassant);
+            return true;
+        }
+
+        std::vector<Move> legal = Referee::legalMoves(m_board, m_whiteToMove);
+        if (!Referee::findMove(legal, str.substr(0, 4))) {
+            return false;
+        }
+        bool lastRank = (m_board[friendly] & fromBit) && (to >= 56 || to < 8);
+        if (str.size() == 5) {
+            const char* promotion = std::strchr("nbrq", str[4]);
+            if (!lastRank || !promotion || !*promotion) {
+                return false;
+            }
+            move = Move(from, to, static_cast<Move::Flag>(Move::PromoteKnight + (promotion - "nbrq")));
+            return true;
+        }
+        if (lastRank) {
+            return false;  // a pawn on the last rank has to say what it becomes
+        }
+        move = Move(from, to);
+        return true;
+    }
+
+    bool playMove(const std::string& str) {
+        Move move;
+        if (!parseMove(str, move)) {
+            return false;
+        }
+        bool pawn = m_board[m_whiteToMove ? WP : BP] & (1ULL << move.from());
+        m_epSquare = pawn && std::abs(move.to() - move.from()) == 16 ? (move.from() + move.to()) / 2 : -1;
+        m_castling = castlingAfterMove(m_castling, move.from(), move.to());
+        m_search.makeMove(move, m_whiteToMove);
+        m_whiteToMove = !m_whiteToMove;
+        return true;
+    }
+
+    // A spin option's value, throws std::invalid_argument / std::out_of_range
+    // unless it is a whole number within the advertised range
+    static long long spinValue(const std::string& value, long long min, long long max) {
+        size_t used = 0;
+        long long number = std::stoll(value, &used);
+        if (used != value.size()) {
+            throw std::invalid_argument("not a number");
+        }
+        if (number < min || number > max) {
+            throw std::out_of_range("outside " + std::to_string(min) + " .. " + std::to_string(max));
+        }
+        return number;
+    }
+
+    void handlePosition(std::istringstream& args) {
+        std::string token, fen;
+        args >> token;
+        if (token == "startpos") {
+            fen = START_FEN;
+            args >> token;  // "moves" or nothing
+        } else if (token == "fen") {
+            while (args >> token && token != "moves") {
+                fen += (fen.empty() ? "" : " ") + token;
+            }
+        } else {
+            return;
+        }
+
+        // A bad FEN leaves the last position in place
+        ChessBoard board(12, 0);
+        FenState state;
+        const char* error = nullptr;
+        if (!parseFen(fen, board, state, &error)) {
+            send(std::string("info string invalid fen: ") + error);
+            return;
+        }
+        m_board = board;
+        m_whiteToMove = state.whiteToMove;
+        m_castling = state.castling;
+        m_epSquare = state.epSquare;
+        // The position stays at the last good move
+        while (args >> token) {
+            if (!playMove(token)) {
+                send("info string illegal move " + token + ", ignoring it and the moves after it");
+                break;
+            }
+        }
+    }
+
+    void handleGo(std::istringstream& args) {
+        SearchLimits limits;
+        std::string token;
+        while (args >> token) {
+            if (token == "wtime") args >> limits.wtime;
+            else if (token == "btime") args >> limits.btime;
+            else if (token == "winc") args >> limits.winc;
+            else if (token == "binc") args >> limits.binc;
+            else if (token == "movestogo") args >> limits.movestogo;
+            else if (token == "depth") args >> limits.depth;
+            else if (token == "nodes") args >> limits.nodes;
+            else if (token == "movetime") args >> limits.movetime;
+            else if (token == "infinite") limits.infinite = true;
+            else if (token == "ponder") limits.ponder = true;
+        }
+
+        FenState root;
+        root.castling = m_castling;
+        root.epSquare = m_epSquare;
+        m_search.setRootState(root);
+        m_search.prepare(limits);
+        m_searchThread = std::thread([this, limits] {
+            Move best = m_search.search(m_whiteToMove, limits);
+            if (m_searchStats) {
+                send("info string stats " + m_search.statistics().toJson());
+            }
+            const std::vector<Move>& pv = m_search.principalVariation();
+            std::string line = "bestmove " + moveToString(best);
+            // Only a legal reply, the PV stops at a mate but the GUI must
+            // never be told to ponder on a move it cannot play
+            if (pv.size() > 1 && pv[0] == best) {
+                ChessBoard next = m_board;
+                Referee::play(next, best, m_whiteToMove);
+                if (Referee::isLegal(next, pv[1], !m_whiteToMove)) {
+                    line += " ponder " + moveToString(pv[1]);
+                }
+            }
+            send(line);
+        });
+    }
+
+    void handleSetOption(std::istringstream& args) {
+        std::string token, name, value;
+        args >> token;  // "name"
+        while (args >> token && token != "value") {
+            name += (name.empty() ? "" : " ") + token;
+        }
+        args >> value;
+        try {
+            setOption(name, value);
+        } catch (const std::exception& e) {
+            send("info string bad value '" + value + "' for option " + name + ": " + e.what());
+        }
+    }
+
+    void setOption(const std::string& name, const std::string& value) {
+        const char* error = "";
+        if (name == "Hash" && !value.empty()) {
+            if (!m_search.setHashSize(spinValue(value, 1, 4096), &error)) {
+                send(std::string("info string hash file not used, ") + error + ", using memory");
+            }
+        } else if (name == "HashFile") {
+            bool off = value.empty() || value == "<empty>";
+            if (!m_search.setHashFile(off ? "" : value, &error)) {
+                send("info string hash file " + value + " not used, " + error + ", using memory");
+            }
+        } else if (name == "MultiPV" && !value.empty()) {
+            m_search.setMultiPV(static_cast<int>(spinValue(value, 1, 64)));
+        } else if (name == "SearchStats") {
+            m_searchStats = value == "true";
+        } else if (name == "Trace" && !value.empty()) {
+            m_search.setTrace(static_cast<size_t>(spinValue(value, 0, 67108864)));
+        } else if (name == "OwnBook") {
+            m_ownBook = value == "true";
+        } else if (name == "BookFile") {
+            // A .db is probed through SQLite, anything else is a binary book
+            m_bookDatabase.reset();
+            m_book.close();
+            if (value.size() > 3 && value.compare(value.size() - 3, 3, ".db") == 0) {
+                try {
+                    m_bookDatabase = std::make_unique<ChessEngineDB>(value, true);
+                } catch (const std::exception& e) {
+                    send(std::string("info string no book: ") + e.what());
+                }
+            } else {
+                m_book.open(value);
+            }
+        } else if (name == "BitbasePath") {
+            m_bitbases.clear();
+            m_bitbases.load(value);
+        } else if (name == "SyzygyPath") {
+            m_syzygy.setPath(value);
+        } else if (name == "SyzygyProbeDepth" && !value.empty()) {
+            m_syzygyProbeDepth = static_cast<int>(spinValue(value, 1, 100));
+        } else if (name == "SyzygyProbeLimit" && !value.empty()) {
+            m_syzygyProbeLimit = static_cast<int>(spinValue(value, 0, SyzygyTablebases::MAX_PIECES));
+        } else if (name == "SyzygySearch") {
+            m_syzygySearch = value == "true";
+        }
+        m_search.setSyzygy(m_syzygySearch ? &m_syzygy : nullptr, m_syzygyProbeDepth, m_syzygyProbeLimit);
+
+        const BookSource* book = nullptr;
+        if (m_bookDatabase) {
+            book = m_bookDatabase.get();
+        } else if (m_book.isOpen()) {
+            book = &m_book;
+        }
+        m_search.setBook(m_ownBook ? book : nullptr);
+        // "Ponder" only tells us the GUI may send go ponder, nothing to set
+    }
+
+public:
+    UciEngine()
+        : m_board(12, 0), m_moveGen(m_board), m_evaluator(m_board, m_moveGen),
+          m_search(m_board, m_moveGen, m_evaluator) {
+        setPositionFromFEN(m_board, START_FEN);
+        if (m_book.open(DEFAULT_BOOK)) {
+            m_search.setBook(&m_book);
+        }
+        m_bitbases.load(DEFAULT_BITBASES);
+        m_search.setBitbases(&m_bitbases);
+        m_search.setSyzygy(nullptr, m_syzygyProbeDepth, m_syzygyProbeLimit);
+        m_search.setInfoCallback([this](const SearchInfo& info) { sendInfo(info); });
+    }
+
+    ~UciEngine() {
+        m_search.stop();
+        waitForSearch();
+    }
+
+    void loop(std::istream& in) {
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream args(line);
+            std::string command;
+            args >> command;
+
+            if (command == "uci") {
+                send("id name Lancer-bot");
+                send("id author WSU CS Club");
+                send("option name Hash type spin default 16 min 1 max 4096");
+                send("option name HashFile type string default <empty>");
+                send("option name Ponder type check default false");
+                send("option name MultiPV type spin default 1 min 1 max 64");
+                send("option name OwnBook type check default true");
+                send(std::string("option name BookFile type string default ") + DEFAULT_BOOK);
+                send(std::string("option name BitbasePath type string default ") + DEFAULT_BITBASES);
+                send("option name SyzygyPath type string default <empty>");
+                send("option name SyzygyProbeDepth type spin default 1 min 1 max 100");
+                send("option name SyzygyProbeLimit type spin default 7 min 0 max 7");
+                send("option name SyzygySearch type check default false");
+                send("option name SearchStats type check default false");
+                send("option name Trace type spin default 0 min 0 max 67108864");
+                send("uciok");
+            } else if (command == "isready") {
+                send("readyok");
+            } else if (command == "setoption") {
+                waitForSearch();
+                handleSetOption(args);
+            } else if (command == "ucinewgame") {
+                waitForSearch();
+                m_search.clearHash();
+            } else if (command == "position") {
+                waitForSearch();
+                handlePosition(args);
+            } else if (command == "go") {
+                waitForSearch();
+                handleGo(args);
+            } else if (command == "ponderhit") {
+                m_search.ponderHit();
+            } else if (command == "stop") {
+                m_search.stop();
+                waitForSearch();
+            } else if (command == "dumptrace") {
+                // Not UCI: writes the tree trace (option Trace), also while searching
+                std::string path;
+                args >> path;
+                if (!m_search.dumpTrace(path)) {
+                    send("info string no trace written, set the Trace option first");
+                }
+            } else if (command == "quit") {
+                m_search.stop();
+                break;
+            }
+        }
+        // On end of input a running fixed depth / time search is allowed to
+        // finish, so "echo go depth 5 | Lancer-bot uci" works
+        waitForSearch();
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include "../engine/movegen.hpp"
+#include "../utils/cpu.hpp"
+
+// Evaluations for endings where the general terms are no help, picked by
+// the material table (material.hpp) from the material alone. An evaluator
+// replaces the whole evaluation and returns centipawns from white's point of
+// view, it gets the table's material score (same view) to build on. A scale
+// function shrinks the general score of the side that leads when its
+// advantage is hard or impossible to convert.
+namespace Endgame {
+
+// Added to a won ending, more than any middlegame advantage so the search
+// goes for the exchange into it, far less than a mate
+constexpr int KNOWN_WIN = 2000;
+
+// Scale factors, out of 64
+constexpr int SCALE_NORMAL = 64;
+constexpr int SCALE_DRAWISH = 16;
+constexpr int SCALE_DRAW = 0;
+
+using Evaluator = int (*)(const ChessBoard& board, bool strongWhite, int material);
+using Scaler = int (*)(const ChessBoard& board);
+
+inline int distance(int a, int b) {
+    return std::max(std::abs((a & 7) - (b & 7)), std::abs((a >> 3) - (b >> 3)));
+}
+
+// 0 in the centre, 6 in a corner
+inline int centreDistance(int square) {
+    int file = square & 7, rank = square >> 3;
+    return std::max(3 - file, file - 4) + std::max(3 - rank, rank - 4);
+}
+
+inline bool darkSquare(int square) {
+    return ((square & 7) + (square >> 3)) % 2 == 0;
+}
+
+inline int pushToEdge(int square) { return 20 * centreDistance(square); }
+inline int pushClose(int a, int b) { return 10 * (7 - distance(a, b)); }
+
+inline int signFor(bool strongWhite, int score) {
+    return strongWhite ? score : -score;
+}
+
+// A position without a chance for either side
+inline int drawn(const ChessBoard&, bool, int) {
+    return 0;
+}
+
+// Anything with a queen or rook (or two bishops) against a bare king: drive
+// the king to the edge and walk ours up to it
+inline int kxk(const ChessBoard& board, bool strongWhite, int material) {
+    int strongKing = getLSB(board[strongWhite ? WK : BK]);
+    int weakKing = getLSB(board[strongWhite ? BK : WK]);
+    return material + signFor(strongWhite, KNOWN_WIN + pushToEdge(weakKing) + pushClose(strongKing, weakKing));
+}
+
+// Bishop and knight: only a corner of the bishop's colour mates
+inline int kbnk(const ChessBoard& board, bool strongWhite, int material) {
+    int strongKing = getLSB(board[strongWhite ? WK : BK]);
+    int weakKing = getLSB(board[strongWhite ? BK : WK]);
+    bool dark = darkSquare(getLSB(board[strongWhite ? WB : BB]));
+    // a1 and h8 are dark
+    int corner = dark ? std::min(distance(weakKing, 0), distance(weakKing, 63))
+                      : std::min(distance(weakKing, 7), distance(weakKing, 56));
+    return material + signFor(strongWhite, KNOWN_WIN + 40 * (7 - corner) + pushClose(strongKing, weakKing));
+}
+
+// Rook against pawn: a win unless the pawn's king escorts it far up the
+// board while ours is away. After the rule of thumb Stockfish uses. The
+// evaluation does not know who is to move, so it counts the tempo for the pawn.
+inline int krkp(const ChessBoard& board, bool strongWhite, int) {
+    // Seen from the strong side as white: the weak pawn runs towards rank 1
+    auto relative = [strongWhite](int square) { return strongWhite ? square : square ^ 56; };
+    int strongKing = relative(getLSB(board[strongWhite ? WK : BK]));
+    int weakKing = relative(getLSB(board[strongWhite ? BK : WK]));
+    int rook = relative(getLSB(board[strongWhite ? WR : BR]));
+    int pawn = relative(getLSB(board[strongWhite ? BP : WP]));
+    int queening = pawn & 7;
+    int push = pawn - 8;  // square in front of the pawn
+
+    int score;
+    if ((strongKing & 7) == (pawn & 7) && strongKing < pawn) {
+        // our king stands in front of the pawn
+        score = 500 - distance(strongKing, pawn);
+    } else if (distance(weakKing, pawn) >= 4 && distance(weakKing, rook) >= 3) {
+        // their king is too far away to help
+        score = 500 - distance(strongKing, pawn);
+    } else if ((weakKing >> 3) <= 2 && distance(weakKing, pawn) == 1 && (strongKing >> 3) >= 3 &&
+               distance(strongKing, pawn) > 2) {
+        // pawn far advanced with its king, ours out of play
+        score = 80 - 8 * distance(strongKing, pawn);
+    } else {
+        score = 200 - 8 * (distance(strongKing, push) - distance(weakKing, push) - distance(pawn, queening));
+    }
+    return signFor(strongWhite, score);
+}
+
+// Bishops of opposite colours and nothing else but pawns: a pawn or two up
+// is usually a draw, the defending bishop holds the other colour
+inline int oppositeBishops(const ChessBoard& board) {
+    if (darkSquare(getLSB(board[WB])) == darkSquare(getLSB(board[BB]))) {
+        return SCALE_NORMAL;
+    }
+    int pawnLead = std::abs(Cpu::popcount(board[WP]) - Cpu::popcount(board[BP]));
+    return pawnLead <= 1 ? SCALE_DRAWISH : SCALE_NORMAL / 2;
+}
+
+}  // namespace Endgame
@@ -1,6 +1,8 @@
 #pragma once
 #include <iostream>
+#include "material.hpp"
 #include "../engine/movegen.hpp"
+#include "../utils/bitboard.hpp"
 
 class Evaluation {
 private:
@@ -12,6 +14,12 @@ private:
     static constexpr int QUEEN_VALUE = 900;
     static constexpr int KING_VALUE = 20000;
 
+    // Per bitboard WP .. BK, the kings cancel out
+    static constexpr int32_t MATERIAL_WEIGHTS[12] = {
+        PAWN_VALUE,  KNIGHT_VALUE,  BISHOP_VALUE,  ROOK_VALUE,  QUEEN_VALUE,  0,
+        -PAWN_VALUE, -KNIGHT_VALUE, -BISHOP_VALUE, -ROOK_VALUE, -QUEEN_VALUE, 0,
+    };
+
     // Piece mobility bonuses
     static constexpr int KNIGHT_MOBILITY_BONUS = 4;
     static constexpr int BISHOP_MOBILITY_BONUS = 3;
@@ -33,12 +41,8 @@ private:
     static constexpr int ROOK_ON_OPEN_FILE_BONUS = 30;
     static constexpr int ROOK_ON_SEMI_OPEN_FILE_BONUS = 15;
     static constexpr int ROOK_CONNECTED_BONUS = 20;
-    static constexpr int BISHOP_PAIR_BONUS = 50;
     static constexpr int KNIGHT_OUTPOST_BONUS = 30;
 
-    static constexpr uint64_t FILE_A = 0x0101010101010101ULL;
-    static constexpr uint64_t FILE_H = 0x8080808080808080ULL;
-    
     // Central squares (e4, e5, d4, d5)
     static constexpr uint64_t CENTRAL_SQUARES = 
         (1ULL << 27) | (1ULL << 28) | (1ULL << 35) | (1ULL << 36);
@@ -79,18 +83,10 @@ static constexpr int PAWN_PST[64] = {
 
     ChessBoard& board;
     MoveGen& moveGen;
-
-    uint64_t getFileMask(int square) {
-        return 0x0101010101010101ULL << (square & 7);
-    }
+    MaterialTable materialTable{MATERIAL_WEIGHTS};
 
     int countPieces(uint64_t bitboard) {
-        int count = 0;
-        while (bitboard) {
-            count++;
-            bitboard &= (bitboard - 1);
-        }
-        return count;
+        return Cpu::popcount(bitboard);
     }
 
     int getPSTValue(int square, const int table[64]) {
@@ -101,84 +97,47 @@ static constexpr int PAWN_PST[64] = {
         return table[63 - square];
     }
     
-    // Enhanced pawn structure evaluation
+    // Enhanced pawn structure evaluation, set-wise for all pawns of a side
     int evaluatePawnStructure(bool isWhite) {
         int score = 0;
         uint64_t pawns = isWhite ? board[WP] : board[BP];
         uint64_t enemyPawns = isWhite ? board[BP] : board[WP];
-        
-        while (pawns) {
-            int square = getLSB(pawns);
-            int file = square & 7;
-            
-            // Basic PST score
-            score += isWhite ? 
-                    getPSTValue(square, PAWN_PST) :
-                    getBlackPSTValue(square, PAWN_PST);
 
-            uint64_t fileMask = getFileMask(square);
-            
-            // Doubled pawns
-            int pawnsOnFile = countPieces(pawns & fileMask);
-            if (pawnsOnFile > 1) {
-                score += DOUBLED_PAWN_PENALTY * (pawnsOnFile - 1);
-            }
+        // Basic PST score
+        for (uint64_t rest = pawns; rest; rest &= rest - 1) {
+            int square = getLSB(rest);
+            score += isWhite ? getPSTValue(square, PAWN_PST) : getBlackPSTValue(square, PAWN_PST);
+        }
 
-            // Isolated pawns
-            uint64_t adjacentFiles = 0;
-            if (file > 0) adjacentFiles |= getFileMask(square - 1);
-            if (file < 7) adjacentFiles |= getFileMask(square + 1);
-            if (!(pawns & adjacentFiles)) {
-                score += ISOLATED_PAWN_PENALTY;
-            }
+        // Doubled pawns: n (n - 1) / 2 penalties for a file with n of them,
+        // each pawn pays for the ones below it. The pawns with at least k
+        // others below them on their file form layer k.
+        for (uint64_t layer = pawns & Bitboards::frontSpan(pawns, true); layer;
+             layer = pawns & Bitboards::frontSpan(layer, true)) {
+            score += DOUBLED_PAWN_PENALTY * countPieces(layer);
+        }
 
-            // Passed pawns
-            uint64_t frontSpan = isWhite ? 
-                (fileMask << 8) & (-(1ULL << square)) :
-                (fileMask >> 8) & ((1ULL << square) - 1);
-            uint64_t adjacentFrontSpan = 0;
-            if (file > 0) adjacentFrontSpan |= frontSpan >> 1;
-            if (file < 7) adjacentFrontSpan |= frontSpan << 1;
-            
-            if (!(frontSpan & enemyPawns) && !(adjacentFrontSpan & enemyPawns)) {
-                score += PASSED_PAWN_BONUS;
-                
-                // Get all moves for this pawn to check if it's protected
-                auto pawnMoves = moveGen.GenerateMoves(isWhite);
-                bool isProtected = false;
-                for (const auto& move : pawnMoves) {
-                    if (move.to == square && (board[WP] & (1ULL << move.from))) {
-                        isProtected = true;
-                        break;
-                    }
-                }
-                if (isProtected) {
-                    score += PROTECTED_PASSED_PAWN_BONUS;
-                }
-            }
+        score += ISOLATED_PAWN_PENALTY * countPieces(Bitboards::isolatedPawns(pawns));
+
+        uint64_t passed = Bitboards::passedPawns(pawns, enemyPawns, isWhite);
+        score += PASSED_PAWN_BONUS * countPieces(passed);
+        // Protected by one of our pawns
+        score += PROTECTED_PASSED_PAWN_BONUS * countPieces(passed & Bitboards::pawnAttacks(pawns, isWhite));
 
-            pawns &= pawns - 1;
-        }
-        
         return score;
     }
 
-    // Evaluate king safety using MoveGen
+    // Evaluate king safety
     int evaluateKingSafety(bool isWhite) {
         int score = 0;
         int kingSquare = getLSB(isWhite ? board[WK] : board[BK]);
-        int kingFile = kingSquare & 7;
 
         uint64_t friendlyPawns = isWhite ? board[WP] : board[BP];
         
-        // Get king moves to determine king zone
-        auto kingMoves = moveGen.GenerateMoves(isWhite);
-        uint64_t kingZone = 0ULL;
-        for (const auto& move : kingMoves) {
-            if ((1ULL << move.from) & (isWhite ? board[WK] : board[BK])) {
-                kingZone |= (1ULL << move.to);
-            }
-        }
+        // King zone: the squares the king could step to
+        uint64_t friendly = isWhite ? board[WP] | board[WN] | board[WB] | board[WR] | board[WQ]
+                                    : board[BP] | board[BN] | board[BB] | board[BR] | board[BQ];
+        uint64_t kingZone = Attacks::king(kingSquare) & ~friendly;
 
         // Pawn shield
         uint64_t pawnShield = isWhite ?
@@ -187,156 +146,99 @@ static constexpr int PAWN_PST[64] = {
         score += countPieces(pawnShield) * KING_SHIELD_BONUS;
 
         // Open files near king
-        for (int f = std::max(0, kingFile - 1); f <= std::min(7, kingFile + 1); f++) {
-            uint64_t fileMask = getFileMask(f);
-            if (!(fileMask & (board[WP] | board[BP]))) {
-                score += KING_OPEN_FILE_PENALTY;
-            }
-        }
+        uint64_t king = isWhite ? board[WK] : board[BK];
+        uint64_t kingFiles = Bitboards::fileFill(king | Bitboards::adjacentFiles(king));
+        score += KING_OPEN_FILE_PENALTY *
+                 countPieces(kingFiles & Bitboards::openFiles(board[WP] | board[BP]) & Bitboards::RANK_1);
 
         return score;
     }
 
-    // Evaluate piece coordination using MoveGen
+    // Evaluate piece coordination
     int evaluatePieceCoordination(bool isWhite) {
         int score = 0;
         
         // Rook evaluation
         uint64_t rooks = isWhite ? board[WR] : board[BR];
+        uint64_t allRooks = rooks;
         uint64_t allPawns = board[WP] | board[BP];
+        uint64_t occupied = 0;
+        for (const auto& bitboard : board) {
+            occupied |= bitboard;
+        }
         
+        // Rooks on open and semi-open files
+        uint64_t openFiles = Bitboards::openFiles(allPawns);
+        uint64_t semiOpenFiles = Bitboards::openFiles(isWhite ? board[WP] : board[BP]) & ~openFiles;
+        score += ROOK_ON_OPEN_FILE_BONUS * countPieces(rooks & openFiles);
+        score += ROOK_ON_SEMI_OPEN_FILE_BONUS * countPieces(rooks & semiOpenFiles);
+
         while (rooks) {
             int square = getLSB(rooks);
-            uint64_t fileMask = getFileMask(square);
-            
-            // Rook on open file
-            if (!(fileMask & allPawns)) {
-                score += ROOK_ON_OPEN_FILE_BONUS;
-            }
-            // Rook on semi-open file
-            else if (!(fileMask & (isWhite ? board[WP] : board[BP]))) {
-                score += ROOK_ON_SEMI_OPEN_FILE_BONUS;
-            }
-            
-            // Get rook moves to check connectivity
-            auto rookMoves = moveGen.GenerateMoves(isWhite);
-            for (const auto& move : rookMoves) {
-                if ((1ULL << move.from) & rooks && (1ULL << move.to) & rooks) {
-                    score += ROOK_CONNECTED_BONUS;
-                    break;
-                }
+
+            // Connected: sees the other rook along a rank or file
+            if (Attacks::rook(square, occupied) & allRooks) {
+                score += ROOK_CONNECTED_BONUS;
             }
             
             rooks &= rooks - 1;
         }
 
-        // Bishop pair bonus
-        if (countPieces(isWhite ? board[WB] : board[BB]) >= 2) {
-            score += BISHOP_PAIR_BONUS;
-        }
-
         // Knight outposts
-        uint64_t knights = isWhite ? board[WN] : board[BN];
-        uint64_t enemyPawnMoves = 0ULL;
-        
-        // Get enemy pawn attacks using MoveGen
-        auto enemyPawnMovesList = moveGen.GenerateMoves(!isWhite);
-        for (const auto& move : enemyPawnMovesList) {
-            if ((board[isWhite ? BP : WP] & (1ULL << move.from))) {
-                enemyPawnMoves |= (1ULL << move.to);
-            }
-        }
-        
-            score += evaluateKnightOutposts(isWhite);
+        score += evaluateKnightOutposts(isWhite);
 
           return score;
     }
 
-    // Evaluate mobility using MoveGen
+    // Evaluate mobility: squares each piece can move to, not counting our own pieces
     int evaluateMobility(bool isWhite) {
-        auto moves = moveGen.GenerateMoves(isWhite);
+        int base = isWhite ? WP : BP;
+        uint64_t friendly = 0, occupied = 0;
+        for (int piece = WP; piece <= BK; piece++) {
+            occupied |= board[piece];
+            if (piece >= base && piece < base + 6) friendly |= board[piece];
+        }
         int score = 0;
-        
-        for (const auto& move : moves) {
-            uint64_t fromBit = 1ULL << move.from;
-            
-            // Assign mobility bonus based on piece type
-            if (fromBit & board[isWhite ? WN : BN]) score += KNIGHT_MOBILITY_BONUS;
-            else if (fromBit & board[isWhite ? WB : BB]) score += BISHOP_MOBILITY_BONUS;
-            else if (fromBit & board[isWhite ? WR : BR]) score += ROOK_MOBILITY_BONUS;
-            else if (fromBit & board[isWhite ? WQ : BQ]) score += QUEEN_MOBILITY_BONUS;
+
+        // One popcount per piece. Batching these for AVX2 was slower: the
+        // vector loads wait on the stores that just filled the batch.
+        for (uint64_t pieces = board[base + 1]; pieces; pieces &= pieces - 1) {
+            score += KNIGHT_MOBILITY_BONUS * countPieces(Attacks::knight(getLSB(pieces)) & ~friendly);
         }
-        
-        return score;
-    }
-int evaluateKnightOutposts(bool isWhite) {
-    int score = 0;
-    uint64_t knights = isWhite ? board[WN] : board[BN];
-    uint64_t friendlyPawns = isWhite ? board[WP] : board[BP];
-    
-    // Get squares attacked by enemy pawns
-    uint64_t enemyPawnMoves = 0ULL;
-    auto enemyPawnMovesList = moveGen.GenerateMoves(!isWhite);
-    for (const auto& move : enemyPawnMovesList) {
-        if ((board[isWhite ? BP : WP] & (1ULL << move.from))) {
-            enemyPawnMoves |= (1ULL << move.to);
+        for (uint64_t pieces = board[base + 2]; pieces; pieces &= pieces - 1) {
+            score += BISHOP_MOBILITY_BONUS * countPieces(Attacks::bishop(getLSB(pieces), occupied) & ~friendly);
         }
-    }
-
-    // Get squares controlled by equal/lesser value pieces
-    uint64_t enemyControl = 0ULL;
-    auto enemyMoves = moveGen.GenerateMoves(!isWhite);
-    for (const auto& move : enemyMoves) {
-        uint64_t fromBit = 1ULL << move.from;
-        // Only consider knights and bishops (equal or lesser value)
-        if ((fromBit & board[isWhite ? BN : WN]) || 
-            (fromBit & board[isWhite ? BB : WB])) {
-            enemyControl |= (1ULL << move.to);
+        for (uint64_t pieces = board[base + 3]; pieces; pieces &= pieces - 1) {
+            score += ROOK_MOBILITY_BONUS * countPieces(Attacks::rook(getLSB(pieces), occupied) & ~friendly);
         }
+        for (uint64_t pieces = board[base + 4]; pieces; pieces &= pieces - 1) {
+            score += QUEEN_MOBILITY_BONUS * countPieces(Attacks::queen(getLSB(pieces), occupied) & ~friendly);
+        }
+        return score;
     }
-
-    while (knights) {
-        int square = getLSB(knights);
-        uint64_t squareBit = 1ULL << square;
-        
-        // Condition 1: Protected by friendly pawn
-        bool pawnProtected = false;
-        uint64_t pawnAttacks = isWhite ?
-            ((squareBit >> 7) & ~FILE_H) | ((squareBit >> 9) & ~FILE_A) :  // White pawn attacks
-            ((squareBit << 7) & ~FILE_A) | ((squareBit << 9) & ~FILE_H);   // Black pawn attacks
-        
-        if (pawnAttacks & friendlyPawns) {
-            pawnProtected = true;
+    // Knights on squares our pawns defend and no enemy pawn, knight or
+    // bishop attacks, better the further up the board
+    int evaluateKnightOutposts(bool isWhite) {
+        uint64_t knights = isWhite ? board[WN] : board[BN];
+        uint64_t friendlyPawns = isWhite ? board[WP] : board[BP];
+        uint64_t enemyControl = moveGen.attacksBy(!isWhite, WP) | moveGen.attacksBy(!isWhite, WN) |
+                                moveGen.attacksBy(!isWhite, WB);
+        uint64_t outposts = knights & Bitboards::pawnAttacks(friendlyPawns, isWhite) & ~enemyControl;
+        if (!outposts) {
+            return 0;
         }
 
-        // Condition 2: Cannot be attacked by enemy pawns
-        bool safeFromPawns = !(enemyPawnMoves & squareBit);
-
-        // Condition 3: Not easily challenged by equal value pieces
-        bool notEasilyChallenged = !(enemyControl & squareBit);
-
-        // Calculate rank bonus (outposts are stronger in enemy territory)
-        int rank = square >> 3;
-        int rankBonus = isWhite ? 
-            std::max(0, rank - 3) * 5 :  // Bonus for ranks 4-7 for white
-            std::max(0, 4 - rank) * 5;   // Bonus for ranks 3-0 for black
-
-        // Only give outpost bonus if all conditions are met
-        if (pawnProtected && safeFromPawns && notEasilyChallenged) {
-            score += KNIGHT_OUTPOST_BONUS + rankBonus;
-            
-            // Additional bonus for central control
-            int file = square & 7;
-            if ((rank >= 3 && rank <= 4) && (file >= 2 && file <= 5)) {
-                score += 10;  // Bonus for controlling center from outpost
-            }
-        }
+        // 5 a rank from the 5th rank up (the 4th down for black): each outpost
+        // is counted once for every one of these ranks it stands on or beyond
+        uint64_t relative = isWhite ? outposts : Bitboards::flipVertical(outposts);
+        int rankBonus = countPieces(relative & ~0ULL << 32) + countPieces(relative & ~0ULL << 40) +
+                        countPieces(relative & ~0ULL << 48) + countPieces(relative & ~0ULL << 56);
 
-        knights &= knights - 1;
+        // c4 - f5, controlling the centre from the outpost
+        constexpr uint64_t OUTPOST_CENTRE = 0x3C3C000000ULL;
+        return KNIGHT_OUTPOST_BONUS * countPieces(outposts) + 5 * rankBonus +
+               10 * countPieces(outposts & OUTPOST_CENTRE);
     }
-    
-    return score;
-}
 
 public:
     Evaluation(ChessBoard& b, MoveGen& mg) : board(b), moveGen(mg) {}
@@ -355,23 +257,34 @@ double normalizeScore(int score) {
 }
 
     double evaluate(bool isWhiteTurn) {
-        int score = 0;
+        return evaluate(isWhiteTurn, MaterialTable::key(board));
+    }
 
-        // Material counting
-        score += PAWN_VALUE * (countPieces(board[WP]) - countPieces(board[BP]));
-        score += KNIGHT_VALUE * (countPieces(board[WN]) - countPieces(board[BN]));
-        score += BISHOP_VALUE * (countPieces(board[WB]) - countPieces(board[BB]));
-        score += ROOK_VALUE * (countPieces(board[WR]) - countPieces(board[BR]));
-        score += QUEEN_VALUE * (countPieces(board[WQ]) - countPieces(board[BQ]));
+    // With the material key of the board (MaterialTable::key), which the
+    // search keeps up to date instead of counting pieces at every leaf
+    double evaluate(bool isWhiteTurn, uint64_t materialKey) {
+        // Material, bishop pair and game phase come cached by the material on
+        // the board, known endings skip the general terms (material.hpp)
+        const MaterialEntry& material = materialTable.probe(materialKey);
+        if (material.evaluator) {
+            double exactScore = normalizeScore(material.evaluator(board, material.strongWhite, material.value));
+            return isWhiteTurn ? exactScore : -exactScore;
+        }
+        int score = material.value;
 
         // Positional evaluation
         score += evaluatePawnStructure(true) - evaluatePawnStructure(false);
-        score += evaluateKingSafety(true) - evaluateKingSafety(false);
         score += evaluatePieceCoordination(true) - evaluatePieceCoordination(false);
 
+        // King shelter fades out with the pieces that could attack it
+        score += (evaluateKingSafety(true) - evaluateKingSafety(false)) * material.phase / MaterialEntry::MAX_PHASE;
+
         // Mobility evaluation
         score += evaluateMobility(true) - evaluateMobility(false);
 
+        // Endings the leading side can hardly win
+        score = score * material.scale(board, score) / Endgame::SCALE_NORMAL;
+
         // Tempo bonus: having the move is worth about 10 centipawns
         // Add when i have time or when im not lazy :0
         const int TEMPO_BONUS = 10;
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "endgame.hpp"
+#include "../engine/board.hpp"
+#include "../utils/cpu.hpp"
+
+// Everything the evaluation gets from the material alone, cached by the
+// material on the board: the material score with the bishop pair, the game
+// phase, and for the endings endgame.hpp knows an evaluator that replaces
+// the general evaluation or a scale factor for it.
+//
+// The key is the piece counts, 4 bits per piece type and side, so it is
+// exact and two material signatures never share an entry. A search meets a
+// few hundred signatures at most, a small direct mapped table per
+// Evaluation keeps nearly all of them.
+struct MaterialEntry {
+    static constexpr int MAX_PHASE = 24;  // all minor and major pieces on the board
+
+    uint64_t key{~0ULL};
+    Endgame::Evaluator evaluator{nullptr};  // the whole evaluation, nullptr = general one
+    Endgame::Scaler scaler{nullptr};        // position dependent scale factor
+    int16_t value{0};                       // material and imbalance, centipawns, white's side
+    uint8_t phase{0};                       // MAX_PHASE down to 0 with only kings and pawns
+    uint8_t factor[2]{Endgame::SCALE_NORMAL, Endgame::SCALE_NORMAL};  // for a white / black lead
+    bool strongWhite{true};                 // side the evaluator plays for
+
+    // Factor for a general score, out of SCALE_NORMAL
+    int scale(const ChessBoard& board, int score) const {
+        int result = factor[score > 0 ? 0 : 1];
+        return scaler ? std::min(result, scaler(board)) : result;
+    }
+};
+
+class MaterialTable {
+private:
+    static constexpr int BITS = 12;
+
+    static constexpr int PHASE_WEIGHTS[5] = {0, 1, 1, 2, 4};
+    static constexpr int BISHOP_PAIR_BONUS = 50;
+
+    const int32_t* m_weights;  // centipawns per bitboard, WP .. BK
+    std::vector<MaterialEntry> m_entries;
+
+    // Counts of one piece type in a key, piece WP .. BQ
+    static int count(uint64_t key, int piece) {
+        int shift = piece >= BP ? 32 + 4 * (piece - BP) : 4 * piece;
+        return static_cast<int>((key >> shift) & 15);
+    }
+
+    void compute(MaterialEntry& entry, uint64_t key) const {
+        entry = MaterialEntry();
+        entry.key = key;
+
+        int value = 0, phase = 0;
+        int nonPawn[2] = {0, 0}, pawns[2], minors[2], majors[2];
+        for (int side = 0; side < 2; side++) {
+            int base = side == 0 ? WP : BP;
+            for (int type = 0; type < 5; type++) {
+                int pieces = count(key, base + type);
+                value += m_weights[base + type] * pieces;
+                phase += PHASE_WEIGHTS[type] * pieces;
+                if (type > 0) nonPawn[side] += std::abs(m_weights[base + type]) * pieces;
+            }
+            pawns[side] = count(key, base);
+            minors[side] = count(key, base + 1) + count(key, base + 2);
+            majors[side] = count(key, base + 3) + count(key, base + 4);
+            if (count(key, base + 2) >= 2) {
+                value += side == 0 ? BISHOP_PAIR_BONUS : -BISHOP_PAIR_BONUS;
+            }
+        }
+        entry.value = static_cast<int16_t>(std::clamp(value, -32000, 32000));
+        entry.phase = static_cast<uint8_t>(std::min(phase, MaterialEntry::MAX_PHASE));
+
+        // Nobody can force mate: no pawns and a minor piece a side at most, or
+        // two knights against a bare king
+        bool twoKnights = (count(key, WN) == 2 && minors[0] == 2 && minors[1] == 0) ||
+                          (count(key, BN) == 2 && minors[1] == 2 && minors[0] == 0);
+        if (pawns[0] + pawns[1] == 0 && majors[0] + majors[1] == 0 &&
+            ((minors[0] <= 1 && minors[1] <= 1) || twoKnights)) {
+            entry.evaluator = Endgame::drawn;
+            return;
+        }
+
+        for (int side = 0; side < 2; side++) {
+            int strong = side == 0 ? WP : BP;
+            bool bareWeak = pawns[1 - side] == 0 && nonPawn[1 - side] == 0;
+            entry.strongWhite = side == 0;
+            if (bareWeak && pawns[side] == 0 && majors[side] == 0 && count(key, strong + 1) == 1 &&
+                count(key, strong + 2) == 1) {
+                entry.evaluator = Endgame::kbnk;
+                return;
+            }
+            if (bareWeak && (majors[side] > 0 || count(key, strong + 2) >= 2)) {
+                entry.evaluator = Endgame::kxk;
+                return;
+            }
+            if (pawns[side] == 0 && minors[side] == 0 && count(key, strong + 3) == 1 && count(key, strong + 4) == 0 &&
+                pawns[1 - side] == 1 && nonPawn[1 - side] == 0) {
+                entry.evaluator = Endgame::krkp;
+                return;
+            }
+        }
+        entry.strongWhite = true;
+
+        // A side without pawns needs more than a minor piece up to win
+        for (int side = 0; side < 2; side++) {
+            int bishop = std::abs(m_weights[WB]), rook = std::abs(m_weights[WR]);
+            if (pawns[side] == 0 && nonPawn[side] - nonPawn[1 - side] <= bishop) {
+                entry.factor[side] = nonPawn[side] < rook ? Endgame::SCALE_DRAW
+                                   : nonPawn[1 - side] <= bishop ? 4 : 14;
+            }
+        }
+
+        if (count(key, WB) == 1 && count(key, BB) == 1 && minors[0] == 1 && minors[1] == 1 &&
+            majors[0] + majors[1] == 0) {
+            entry.scaler = Endgame::oppositeBishops;
+        }
+    }
+
+public:
+    // weights: the evaluation's centipawns per bitboard, WP .. BK
+    explicit MaterialTable(const int32_t* weights) : m_weights(weights), m_entries(size_t(1) << BITS) {}
+
+    // What one piece adds to the key, so the search can keep it up to date
+    // move by move like the Zobrist hash. Kings are not counted.
+    static constexpr uint64_t pieceKey(int piece) {
+        return piece == WK || piece == BK ? 0 : 1ULL << (piece >= BP ? 32 + 4 * (piece - BP) : 4 * piece);
+    }
+
+    static uint64_t key(const ChessBoard& board) {
+        uint64_t key = 0;
+        for (int piece = WP; piece <= BK; piece++) {
+            key += Cpu::popcount(board[piece]) * pieceKey(piece);
+        }
+        return key;
+    }
+
+    const MaterialEntry& probe(uint64_t key) {
+        MaterialEntry& entry = m_entries[(key * 0x9E3779B97F4A7C15ULL) >> (64 - BITS)];
+        if (entry.key != key) {
+            compute(entry, key);
+        }
+        return entry;
+    }
+};
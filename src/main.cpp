@@ -1,16 +1,31 @@
+#include "engine/analysis.hpp"
+#include "engine/bench.hpp"
+#include "engine/bitbase_gen.hpp"
 #include "engine/board.hpp"
+#include "engine/datagen.hpp"
+#include "engine/game_host.hpp"
+#include "engine/match.hpp"
+#include "engine/syzygy_check.hpp"
 #include "engine/movegen.hpp"
 #include "network/network.hpp"
 #include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 #include "eval/evaluation.hpp"
 #include "engine/search.hpp"
+#include "engine/test_suite.hpp"
+#include "engine/uci.hpp"
+#include "network/book.hpp"
+#include "network/book_builder.hpp"
+#include "network/pgn_import.hpp"
 
 void printMove(const Move& move) {
-    char fromFile = 'a' + (move.from % 8);
-    int fromRank = 1 + (move.from / 8);
-    char toFile = 'a' + (move.to % 8);
-    int toRank = 1 + (move.to / 8);
+    char fromFile = 'a' + (move.from() % 8);
+    int fromRank = 1 + (move.from() / 8);
+    char toFile = 'a' + (move.to() % 8);
+    int toRank = 1 + (move.to() / 8);
     
     printf("%c%d%c%d ", fromFile, fromRank, toFile, toRank);
 }
@@ -26,7 +41,7 @@ std::string end_fen1 = "8/1k3p2/pp4p1/3Pp3/6P1/PK6/7P/8 w - - 0 2";
 std::string end_fen2 = "3k4/8/4PK2/8/8/8/8/8 w - - 1 5";
 
 
-int runPositions(ChessBoard board) {
+int runPositions(ChessBoard board, const OpeningBook* book = nullptr, const Bitbases* bitbases = nullptr) {
     // Display the current board state
     printBoard(board);
 
@@ -68,6 +83,8 @@ int runPositions(ChessBoard board) {
     Evaluation evaluator(board, moveGen);
 
     MinimaxSearch minimaxSearch(board, moveGen, evaluator);
+    minimaxSearch.setBook(book);
+    minimaxSearch.setBitbases(bitbases);
     std::cout << "\nCalculating best move...\n";
     Move bestMove = minimaxSearch.findBestMove(false);
     std::cout << "Best move found: ";
@@ -79,7 +96,650 @@ int runPositions(ChessBoard board) {
     return 0;
 }
 
-int main() {
+// Fills the book tables from the openings in the SQL database and exports
+// them as the binary book
+int buildBook(const std::string& dbPath, const std::string& bookPath) {
+    try {
+        ChessEngineDB db(dbPath);
+        OpeningBookBuilder builder;
+        int openings = builder.addDatabase(db);
+        builder.store(db);
+        size_t entries = OpeningBookBuilder::exportBook(db, bookPath);
+        std::cout << "Wrote " << entries << " book entries from "
+                  << openings << " openings to " << bookPath << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// "Lancer-bot importpgn <games.pgn> [--db path] [--ply N] [--threads T] [--book out.bin]"
+// Adds the games to the book tables, and optionally re-exports the binary book
+int importPgn(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: Lancer-bot importpgn <games.pgn> [--db path] [--ply N] [--threads T] [--book out.bin]\n";
+        return 1;
+    }
+    std::string pgnPath = argv[2];
+    std::string dbPath = "database/chess_openings.db";
+    std::string bookPath;
+    PgnImportOptions options;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--db") dbPath = argv[i + 1];
+        else if (flag == "--ply") options.maxPly = std::stoi(argv[i + 1]);
+        else if (flag == "--threads") options.threads = static_cast<unsigned>(std::stoi(argv[i + 1]));
+        else if (flag == "--book") bookPath = argv[i + 1];
+        else {
+            std::cerr << "Unknown option " << flag << "\n";
+            return 1;
+        }
+    }
+
+    try {
+        ChessEngineDB db(dbPath);
+        PgnImportResult result = PgnImporter::import(pgnPath, db, options);
+        double seconds = result.parseSeconds + result.writeSeconds;
+        std::cout << "Imported " << result.games - result.skippedGames << " games ("
+                  << result.skippedGames << " skipped) into " << result.positions
+                  << " positions and " << result.moves << " moves\n"
+                  << "Parsing " << result.parseSeconds << " s, writing " << result.writeSeconds
+                  << " s, " << static_cast<uint64_t>(result.games / std::max(seconds, 1e-9)) << " games/s\n";
+        if (!bookPath.empty()) {
+            size_t entries = OpeningBookBuilder::exportBook(db, bookPath);
+            std::cout << "Wrote " << entries << " book entries to " << bookPath << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// "Lancer-bot genbitbases [directory] [--threads T] [tables...]"
+// Without table names the 3 piece endgames are generated, bigger ones like
+// KRKP are asked for by name and pull in the tables they depend on
+int generateBitbases(int argc, char* argv[]) {
+    std::string directory = "database/bitbases";
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> names;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::stoi(argv[++i]));
+        } else if (i == 2 && arg.find_first_not_of("KQRBNP") != std::string::npos) {
+            directory = arg;
+        } else {
+            names.push_back(arg);
+        }
+    }
+    if (names.empty()) {
+        names = {"KPK", "KNK", "KBK", "KRK", "KQK"};
+    }
+
+    try {
+        Bitbases tables(directory);
+        int written = 0;
+        for (const std::string& name : names) {
+            written += BitbaseGenerator::generate(name, directory, threads, tables);
+        }
+        std::cout << "Generated " << written << " bitbases, " << tables.tableCount()
+                  << " in " << directory << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// "Lancer-bot analyse --input file.epd [--depth N | --nodes N] [--threads T]
+//  [--hash MB] [--hash-file path] [--output results.txt] [--stats on]"
+// Searches every position in the file, one single-threaded search per thread
+int analysePositions(int argc, char* argv[]) {
+    BatchAnalyzer::Options options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string inputPath, outputPath;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--input") inputPath = argv[i + 1];
+        else if (flag == "--output") outputPath = argv[i + 1];
+        else if (flag == "--depth") options.limits.depth = std::stoi(argv[i + 1]);
+        else if (flag == "--nodes") options.limits.nodes = std::stoull(argv[i + 1]);
+        else if (flag == "--threads") options.threads = static_cast<unsigned>(std::stoi(argv[i + 1]));
+        else if (flag == "--hash") options.hashMegabytes = std::stoul(argv[i + 1]);
+        else if (flag == "--hash-file") options.hashFile = argv[i + 1];
+        else if (flag == "--stats") options.stats = std::string(argv[i + 1]) == "on";
+        else {
+            std::cerr << "Unknown option " << flag << "\n";
+            return 1;
+        }
+    }
+    if (inputPath.empty()) {
+        std::cerr << "Usage: Lancer-bot analyse --input file.epd [--depth N | --nodes N] [--threads T] [--hash MB] [--hash-file path] [--output file] [--stats on]\n";
+        return 1;
+    }
+    if (options.limits.depth == 0 && options.limits.nodes == 0) {
+        options.limits.depth = 5;  // what the demo positions search to
+    }
+
+    EpdReader input(inputPath);
+    if (!input.isOpen()) {
+        std::cerr << "Error: cannot open " << inputPath << std::endl;
+        return 1;
+    }
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        outputFile.open(outputPath);
+        if (!outputFile) {
+            std::cerr << "Error: cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+
+    Bitbases bitbases("database/bitbases");
+    BatchAnalyzer analyzer(options, &bitbases);
+    BatchAnalyzer::Summary summary = analyzer.run(input, outputPath.empty() ? std::cout : outputFile);
+    double seconds = std::max(summary.seconds, 1e-9);
+    std::cerr << "Analysed " << summary.positions << " positions (" << summary.skipped << " skipped) with "
+              << options.threads << " threads in " << summary.seconds << " s, "
+              << summary.positions / seconds << " positions/s, "
+              << static_cast<uint64_t>(summary.nodes / seconds) << " nps\n";
+    if (options.stats) {
+        std::cerr << "Statistics: " << summary.stats.toJson() << "\n";
+    }
+    return 0;
+}
+
+// "Lancer-bot bench [depth]"
+// Fixed depth searches over the bench positions. The node total is the
+// search signature, it only changes when the search or evaluation does.
+int bench(int depth) {
+    BenchResult result = runBench(depth, std::cout);
+    std::cout << "\n===========================\n"
+              << "Total time (ms) : " << static_cast<uint64_t>(result.seconds * 1000) << "\n"
+              << "Nodes searched  : " << result.nodes << "\n"
+              << "Nodes/second    : " << result.nps() << "\n"
+              << "CPU path        : " << Cpu::name(Cpu::path()) << " (best here: " << Cpu::name(Cpu::detect())
+              << ")\n"
+              << "Statistics      : " << result.stats.toJson() << std::endl;
+    return 0;
+}
+
+// "Lancer-bot trace --fen "<fen>" [--depth N] [--events N] [--output search.trace]"
+// Searches one position with the tree tracer on and writes the trace, to
+// read back with bin/trace_reader (search_trace.hpp)
+int traceSearch(int argc, char* argv[]) {
+    std::string fen = mid_fen2, outputPath = "search.trace";
+    SearchLimits limits;
+    limits.depth = 5;
+    size_t events = size_t(1) << 22;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--fen") fen = value;
+        else if (flag == "--depth") limits.depth = std::stoi(value);
+        else if (flag == "--events") events = std::stoull(value);
+        else if (flag == "--output") outputPath = value;
+    }
+
+    try {
+        ChessBoard board(12, 0);
+        FenState state;
+        const char* error = nullptr;
+        if (!parseFen(fen, board, state, &error)) {
+            throw std::runtime_error("Invalid FEN (" + std::string(error) + "): " + fen);
+        }
+        MoveGen moveGen(board);
+        Evaluation evaluator(board, moveGen);
+        MinimaxSearch search(board, moveGen, evaluator);
+        search.setTrace(events);
+        search.setRootState(state);
+        Move best = search.search(state.whiteToMove, limits);
+        std::cout << "bestmove " << moveToString(best) << " nodes " << search.nodeCount() << "\n";
+        if (!search.dumpTrace(outputPath)) {
+            std::cerr << "No trace written to " << outputPath
+                      << " (built with -DLANCER_SEARCH_TRACE=OFF, or the file cannot be written)\n";
+            return 1;
+        }
+        std::cout << "Trace written to " << outputPath << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// "Lancer-bot match --a "hash=16" --b "hash=64" [--games N] [--threads T]
+//  [--tc 10+0.1] [--openings file.epd] [--sprt elo0,elo1] [--report N]"
+// Plays the two configurations against each other, see match.hpp
+int playMatch(int argc, char* argv[]) {
+    MatchRunner::Options options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    options.a.name = "A";
+    options.b.name = "B";
+    try {
+        for (int i = 2; i + 1 < argc; i += 2) {
+            std::string flag = argv[i], value = argv[i + 1];
+            if (flag == "--a") options.a = EngineConfig::parse("A", value);
+            else if (flag == "--b") options.b = EngineConfig::parse("B", value);
+            else if (flag == "--games") options.games = std::stoull(value);
+            else if (flag == "--threads") options.threads = static_cast<unsigned>(std::stoi(value));
+            else if (flag == "--report") options.reportEvery = std::stoull(value);
+            else if (flag == "--tc") {
+                // seconds + increment seconds
+                size_t plus = value.find('+');
+                options.baseMs = static_cast<int64_t>(std::stod(value.substr(0, plus)) * 1000);
+                options.incrementMs = plus == std::string::npos ? 0
+                                    : static_cast<int64_t>(std::stod(value.substr(plus + 1)) * 1000);
+            } else if (flag == "--sprt") {
+                size_t comma = value.find(',');
+                options.elo0 = std::stod(value.substr(0, comma));
+                options.elo1 = std::stod(value.substr(comma + 1));
+            } else if (flag == "--openings") {
+                EpdReader reader(value);
+                if (!reader.isOpen()) {
+                    std::cerr << "Error: cannot open " << value << std::endl;
+                    return 1;
+                }
+                ChessBoard board(12, 0);
+                FenState state;
+                std::string_view operations;
+                while (reader.nextPosition(board, state, operations)) {
+                    options.openings.push_back(boardToFen(board, state));
+                }
+            } else {
+                std::cerr << "Unknown option " << flag << "\n";
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (options.openings.empty()) {
+        options.openings = benchPositions();
+    }
+
+    MatchRunner runner(options);
+    MatchRunner::Summary summary = runner.run(std::cout);
+    std::cout << summary.timeLosses << " time losses, " << summary.adjudicated << " adjudicated, "
+              << summary.seconds << " s";
+    if (summary.sprt != 0) {
+        std::cout << ", SPRT accepted " << (summary.sprt > 0 ? "H1" : "H0");
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+// Options shared by "host" and "hostbench", false on an unknown flag
+bool parseHostOptions(int argc, char* argv[], GameHost::Options& options, size_t& games, int& plies) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--threads") options.threads = static_cast<unsigned>(std::stoi(value));
+        else if (flag == "--hash-per-game") options.hashPerGame = std::stoull(value);
+        else if (flag == "--shared-hash") options.sharedHash = std::stoull(value);
+        else if (flag == "--movetime") options.movetimeMs = std::stoll(value);
+        else if (flag == "--depth") options.depth = std::stoi(value);
+        else if (flag == "--margin") options.marginMs = std::stoll(value);
+        else if (flag == "--games") games = std::stoull(value);
+        else if (flag == "--plies") plies = std::stoi(value);
+        else {
+            std::cerr << "Unknown option " << flag << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+void printHostStats(const GameHost::Stats& stats, std::ostream& out) {
+    out << "stats games " << stats.games << " served " << stats.served << " moves/s "
+        << static_cast<uint64_t>(stats.movesPerSecond()) << " p50 " << stats.p50Ms << "ms p99 " << stats.p99Ms
+        << "ms max " << stats.maxMs << "ms missed " << stats.missedDeadlines << std::endl;
+}
+
+// "Lancer-bot host [--threads N] [--hash-per-game MB | --shared-hash MB]
+//  [--movetime ms] [--depth N] [--margin ms]"
+// Many games on stdin/stdout, one line per command (game_host.hpp):
+//   new <id> [movetime <ms>] [startpos | fen <fen>]
+//   move <id> <move>...      the opponent's moves
+//   go <id> [movetime <ms>]  answered later with "bestmove <id> <move> ..."
+//   close <id>, stats, quit (answers what is queued first)
+// For a socket put socat in front: socat TCP-LISTEN:4000,fork EXEC:"Lancer-bot host"
+int hostGames(int argc, char* argv[]) {
+    GameHost::Options options;
+    size_t games = 0;
+    int plies = 0;
+    try {
+        if (!parseHostOptions(argc, argv, options, games, plies)) return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::mutex outputMutex;
+    auto print = [&outputMutex](const std::string& line) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout << line << std::endl;
+    };
+    GameHost host(options, [&print](const GameHost::Reply& reply) {
+        if (!reply.error.empty()) {
+            print("error " + reply.game + " " + reply.error);
+            return;
+        }
+        char latency[32];
+        std::snprintf(latency, sizeof(latency), "%.1f", reply.latencyMs);
+        std::string line = "bestmove " + reply.game + " " + (reply.move.raw() ? moveToString(reply.move) : "0000");
+        if (!reply.result.empty()) line += " result " + reply.result;
+        print(line + " latency " + latency);
+    });
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream input(line);
+        std::string command, id, error;
+        input >> command >> id;
+        bool ok = true;
+        if (command == "new") {
+            std::string token, fen = GameHost::START_FEN;
+            int64_t movetime = 0;
+            while (input >> token) {
+                if (token == "movetime") input >> movetime;
+                else if (token == "fen") {
+                    std::getline(input, fen);
+                    fen.erase(0, fen.find_first_not_of(' '));
+                }
+            }
+            ok = host.newGame(id, fen, movetime, error);
+        } else if (command == "move") {
+            std::string move;
+            while (ok && input >> move) ok = host.play(id, move, error);
+        } else if (command == "go") {
+            std::string token;
+            int64_t movetime = 0;
+            if (input >> token && token == "movetime") input >> movetime;
+            ok = host.go(id, movetime, error);
+        } else if (command == "close") {
+            ok = host.close(id, error);
+        } else if (command == "stats") {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            printHostStats(host.stats(), std::cout);
+        } else if (command == "quit") {
+            break;
+        } else if (!command.empty()) {
+            ok = false;
+            error = "unknown command " + command;
+        }
+        if (!ok) print("error " + id + " " + error);
+    }
+    host.wait();
+    printHostStats(host.stats(), std::cout);
+    return 0;
+}
+
+// "Lancer-bot hostbench [--games 200] [--plies 20] [--movetime 50] [--threads N]
+//  [--hash-per-game MB | --shared-hash MB]"
+// Load test of the host: every game starts from a bench position and the
+// host plays both sides, each reply asks for the next move straight away.
+int hostBench(int argc, char* argv[]) {
+    GameHost::Options options;
+    options.movetimeMs = 50;
+    size_t games = 200;
+    int plies = 20;
+    try {
+        if (!parseHostOptions(argc, argv, options, games, plies)) return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> positions = benchPositions();
+    std::vector<std::atomic<int>> played(games);
+    GameHost* hostPointer = nullptr;
+    GameHost host(options, [&](const GameHost::Reply& reply) {
+        size_t game = std::stoull(reply.game);
+        std::string error;
+        if (reply.result.empty() && ++played[game] < plies) {
+            hostPointer->go(reply.game, 0, error);
+        }
+    });
+    hostPointer = &host;
+
+    std::cout << "Hosting " << games << " games of " << plies << " plies, " << options.movetimeMs << " ms a move, "
+              << options.threads << " threads, "
+              << (options.sharedHash ? std::to_string(options.sharedHash) + " MB shared hash"
+                                     : std::to_string(options.hashPerGame) + " MB hash per game")
+              << std::endl;
+    std::string error;
+    for (size_t game = 0; game < games; game++) {
+        if (!host.newGame(std::to_string(game), positions[game % positions.size()], 0, error) ||
+            !host.go(std::to_string(game), 0, error)) {
+            std::cerr << "Error: game " << game << ": " << error << std::endl;
+            return 1;
+        }
+    }
+    host.wait();
+    printHostStats(host.stats(), std::cout);
+    return 0;
+}
+
+// "Lancer-bot suite --input suite.epd [--movetime ms | --nodes N | --depth N]
+//  [--threads T] [--hash MB] [--min-solved N]"
+// Searches the bm / am positions of a test suite and reports how many were
+// solved and how fast (test_suite.hpp). Exits with 1 when fewer than
+// --min-solved were solved, so a script can use it as a gate.
+int runSuite(int argc, char* argv[]) {
+    SuiteRunner::Options options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string inputPath;
+    size_t minSolved = 0;
+    try {
+        for (int i = 2; i + 1 < argc; i += 2) {
+            std::string flag = argv[i], value = argv[i + 1];
+            if (flag == "--input") inputPath = value;
+            else if (flag == "--movetime") options.limits.movetime = std::stoll(value);
+            else if (flag == "--nodes") options.limits.nodes = std::stoull(value);
+            else if (flag == "--depth") options.limits.depth = std::stoi(value);
+            else if (flag == "--threads") options.threads = static_cast<unsigned>(std::stoi(value));
+            else if (flag == "--hash") options.hashMegabytes = std::stoul(value);
+            else if (flag == "--min-solved") minSolved = std::stoull(value);
+            else {
+                std::cerr << "Unknown option " << flag << "\n";
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (inputPath.empty()) {
+        std::cerr << "Usage: Lancer-bot suite --input suite.epd [--movetime ms | --nodes N | --depth N] [--threads T]"
+                     " [--hash MB] [--min-solved N]\n";
+        return 1;
+    }
+    if (options.limits.movetime == 0 && options.limits.nodes == 0 && options.limits.depth == 0) {
+        options.limits.movetime = 1000;
+    }
+    options.limits.moveOverhead = 0;
+
+    EpdReader input(inputPath);
+    if (!input.isOpen()) {
+        std::cerr << "Error: cannot open " << inputPath << std::endl;
+        return 1;
+    }
+    Bitbases bitbases("database/bitbases");
+    SuiteRunner runner(options, &bitbases);
+    SuiteRunner::Summary summary = runner.run(input, std::cout);
+    std::cout << "\n";
+    SuiteRunner::report(summary, std::cout);
+    return summary.solved >= minSolved ? 0 : 1;
+}
+
+// "Lancer-bot datagen --output data.bin [--games N] [--threads T] [--nodes N]
+//  [--random-plies N] [--seed S] [--openings file.epd] [--hash MB]"
+// Self-play training data: searched positions with their game's result in
+// the 32 byte records of datagen.hpp, for tools/data_reader.cpp or a tuner.
+int generateData(int argc, char* argv[]) {
+    DataGenerator::Options options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string outputPath, openingsPath;
+    try {
+        for (int i = 2; i + 1 < argc; i += 2) {
+            std::string flag = argv[i], value = argv[i + 1];
+            if (flag == "--output") outputPath = value;
+            else if (flag == "--games") options.games = std::stoull(value);
+            else if (flag == "--threads") options.threads = static_cast<unsigned>(std::stoi(value));
+            else if (flag == "--nodes") options.nodes = std::stoull(value);
+            else if (flag == "--random-plies") options.randomPlies = std::stoi(value);
+            else if (flag == "--seed") options.seed = std::stoull(value);
+            else if (flag == "--openings") openingsPath = value;
+            else if (flag == "--hash") options.hashMegabytes = std::stoul(value);
+            else {
+                std::cerr << "Unknown option " << flag << "\n";
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (outputPath.empty()) {
+        std::cerr << "Usage: Lancer-bot datagen --output data.bin [--games N] [--threads T] [--nodes N]"
+                     " [--random-plies N] [--seed S] [--openings file.epd] [--hash MB]\n";
+        return 1;
+    }
+    if (!openingsPath.empty()) {
+        EpdReader openings(openingsPath);
+        if (!openings.isOpen()) {
+            std::cerr << "Error: cannot open " << openingsPath << std::endl;
+            return 1;
+        }
+        std::string_view line;
+        while (openings.next(line)) {
+            options.openings.emplace_back(line);
+        }
+    }
+
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        std::cerr << "Error: cannot write " << outputPath << std::endl;
+        return 1;
+    }
+    Bitbases bitbases("database/bitbases");
+    DataGenerator generator(options, output, &bitbases);
+    DataGenerator::Summary summary = generator.run(std::cout);
+    if (!output) {
+        std::cerr << "Error: writing " << outputPath << " failed" << std::endl;
+        return 1;
+    }
+    std::printf("%llu games, %llu positions in %.1f s, %.0f positions/s\n"
+                "White won %llu, drawn %llu, black won %llu\n",
+                static_cast<unsigned long long>(summary.games), static_cast<unsigned long long>(summary.positions),
+                summary.seconds, summary.positionsPerSecond(),
+                static_cast<unsigned long long>(summary.results[static_cast<int>(DataResult::WhiteWins)]),
+                static_cast<unsigned long long>(summary.results[static_cast<int>(DataResult::Draw)]),
+                static_cast<unsigned long long>(summary.results[static_cast<int>(DataResult::BlackWins)]));
+    return 0;
+}
+
+// "Lancer-bot tbcheck --syzygy dir [--bitbases dir]"
+// Probes real Syzygy files for positions with known results and compares
+// every 3 piece position with the bitbases, see syzygy_check.hpp. Exits 1 if
+// anything disagrees.
+int checkTablebases(int argc, char* argv[]) {
+    std::string syzygyPath, bitbasePath = "database/bitbases";
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--syzygy") syzygyPath = value;
+        else if (flag == "--bitbases") bitbasePath = value;
+        else {
+            std::cerr << "Unknown option " << flag << "\n";
+            return 1;
+        }
+    }
+    if (syzygyPath.empty()) {
+        std::cerr << "Usage: Lancer-bot tbcheck --syzygy dir [--bitbases dir]\n";
+        return 1;
+    }
+    SyzygyTablebases tables;
+    int count = tables.setPath(syzygyPath);
+    if (count == 0) {
+        std::cerr << "Error: no Syzygy files in " << syzygyPath << std::endl;
+        return 1;
+    }
+    std::cout << count << " Syzygy tables, up to " << tables.maxPieces() << " pieces\n\n";
+
+    SyzygyCheck::Summary known = SyzygyCheck::knownPositions(tables, std::cout);
+    std::cout << "\n";
+    Bitbases bitbases(bitbasePath);
+    SyzygyCheck::Summary compared = SyzygyCheck::compareWithBitbases(tables, bitbases, std::cout);
+
+    uint64_t mismatches = known.mismatches + compared.mismatches;
+    std::printf("\n%llu known positions, %llu against the bitbases, %llu skipped, %llu wrong\n",
+                static_cast<unsigned long long>(known.checked), static_cast<unsigned long long>(compared.checked),
+                static_cast<unsigned long long>(known.skipped + compared.skipped),
+                static_cast<unsigned long long>(mismatches));
+    return mismatches ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    // "Lancer-bot uci" talks UCI on stdin/stdout, for GUIs and match runners
+    if (argc > 1 && std::string(argv[1]) == "uci") {
+        UciEngine engine;
+        engine.loop(std::cin);
+        return 0;
+    }
+
+    // "Lancer-bot makebook [database] [book]"
+    if (argc > 1 && std::string(argv[1]) == "makebook") {
+        return buildBook(argc > 2 ? argv[2] : "database/chess_openings.db",
+                         argc > 3 ? argv[3] : "database/book.bin");
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "genbitbases") {
+        return generateBitbases(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "importpgn") {
+        return importPgn(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        return bench(argc > 2 ? std::stoi(argv[2]) : 4);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "analyse") {
+        return analysePositions(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "trace") {
+        return traceSearch(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "match") {
+        return playMatch(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "suite") {
+        return runSuite(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "datagen") {
+        return generateData(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "tbcheck") {
+        return checkTablebases(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "host") {
+        return hostGames(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "hostbench") {
+        return hostBench(argc, argv);
+    }
+
     try {
         // Initialize database connection
         ChessEngineDB db("database/chess_openings.db");
@@ -97,22 +757,28 @@ int main() {
         std::string complete_fen = db.getCompleteFEN(italian);
         std::cout << "\nComplete FEN: " << complete_fen << "\n\n";
 
+        // Openings are played from the book when it has been built
+        OpeningBook book("database/book.bin");
+
+        // Small endgames are looked up instead of evaluated, see genbitbases
+        Bitbases bitbases("database/bitbases");
+
         // Initialize board
         ChessBoard board(12, 0);
         
         // Unit test positions
         setPositionFromFEN(board, opening_fen1);
-        runPositions(board);                        // Best move should either be Nf6 or Bc5, eval +.2
+        runPositions(board, &book, &bitbases);     // Best move should either be Nf6 or Bc5, eval +.2
         setPositionFromFEN(board, opening_fen2);
-        runPositions(board);                        // Best move should either be e3 or Bg5, eval +.2
+        runPositions(board, &book, &bitbases);     // Best move should either be e3 or Bg5, eval +.2
         setPositionFromFEN(board, mid_fen1);
-        runPositions(board);                        // Best move should be Nxc5, eval +1.3
+        runPositions(board, &book, &bitbases);     // Best move should be Nxc5, eval +1.3
         setPositionFromFEN(board, mid_fen2);
-        runPositions(board);                        // Best move should be b4, eval -.6
+        runPositions(board, &book, &bitbases);     // Best move should be b4, eval -.6
         setPositionFromFEN(board, end_fen1);
-        runPositions(board);                        // Best move should be h4, eval +infinity
+        runPositions(board, &book, &bitbases);     // Best move should be h4, eval +infinity
         setPositionFromFEN(board, end_fen2);
-        runPositions(board);                        // Best move is Kf7, eval +infinity
+        runPositions(board, &book, &bitbases);     // Best move is Kf7, eval +infinity
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "../engine/movegen.hpp"
+#include "../utils/mapped_file.hpp"
+
+// Opening book in the Polyglot file layout: 16 byte big-endian entries
+//   key (8) | move (2) | weight (2) | learn (4)
+// sorted by key, several entries per key for several candidate moves.
+// The move packs to square in bits 0-5, from square in bits 6-11 and the
+// promotion piece in bits 12-14, which is our rank * 8 + file numbering and
+// our Move layout. The key is our own Zobrist hash rather than
+// Polyglot's Random64 table, so the layout matches but books from other tools
+// have to be rebuilt with makebook.
+
+// Book files and tables keep from, to and the promotion. Castling and en
+// passant are told apart by the board when the move is played.
+inline uint16_t packBookMove(const Move& move) {
+    return move.isPromotion() ? move.raw() : static_cast<uint16_t>(move.raw() & 0xFFF);
+}
+
+inline Move unpackBookMove(uint16_t packed) {
+    return Move::fromRaw(static_cast<uint16_t>(packed & 0x7FFF));
+}
+
+struct BookMove {
+    Move move;
+    uint16_t weight;
+};
+
+// Results of the games that went through a book position or move
+struct BookEntryStats {
+    uint32_t whiteWins{0};
+    uint32_t draws{0};
+    uint32_t blackWins{0};
+};
+
+// Anything the search can ask for book moves: the memory-mapped file below
+// or the SQLite opening database
+class BookSource {
+public:
+    virtual ~BookSource() = default;
+
+    // Copies up to capacity candidates for the position into out, heaviest
+    // first, and returns how many it copied
+    virtual int probe(uint64_t key, BookMove* out, int capacity) const = 0;
+};
+
+class OpeningBook : public BookSource {
+private:
+    static constexpr size_t ENTRY_SIZE = 16;
+
+    MappedFile m_file;
+    size_t m_count{0};
+
+    template <typename T>
+    static T readBigEndian(const uint8_t* bytes) {
+        T value = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value = static_cast<T>((value << 8) | bytes[i]);
+        }
+        return value;
+    }
+
+    uint64_t keyAt(size_t index) const {
+        return readBigEndian<uint64_t>(m_file.data() + index * ENTRY_SIZE);
+    }
+
+public:
+    OpeningBook() = default;
+
+    explicit OpeningBook(const std::string& path) {
+        open(path);
+    }
+
+    // A missing book just means every probe misses
+    bool open(const std::string& path) {
+        m_count = m_file.open(path) ? m_file.size() / ENTRY_SIZE : 0;
+        return m_count > 0;
+    }
+
+    void close() {
+        m_file.close();
+        m_count = 0;
+    }
+
+    bool isOpen() const { return m_count > 0; }
+    size_t entryCount() const { return m_count; }
+
+    // Binary search for the key, the entries of a key follow each other
+    // heaviest first, as the file is written
+    int probe(uint64_t key, BookMove* out, int capacity) const override {
+        size_t low = 0, high = m_count;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (keyAt(mid) < key) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        int found = 0;
+        for (size_t i = low; i < m_count && found < capacity && keyAt(i) == key; i++) {
+            const uint8_t* entry = m_file.data() + i * ENTRY_SIZE;
+            out[found].move = unpackBookMove(readBigEndian<uint16_t>(entry + 8));
+            out[found].weight = readBigEndian<uint16_t>(entry + 10);
+            found++;
+        }
+        return found;
+    }
+};
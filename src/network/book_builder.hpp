@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "book.hpp"
+#include "network.hpp"
+#include "../engine/board.hpp"
+#include "../engine/movegen.hpp"
+#include "../utils/zobrist.hpp"
+
+// Turns the opening positions stored in SQLite into book rows
+// (book_positions / book_moves) and exports those as the binary book file.
+// The opening tables only hold final positions, so for each one we look for
+// the line from the start position that reaches it. Only moves that put a
+// piece on a square where the target has that same piece are tried, which is
+// how quiet opening lines are played, so the search stays tiny.
+class OpeningBookBuilder {
+private:
+    static constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    static constexpr int MAX_LINE_PLIES = 16;
+
+    struct PositionEntry {
+        std::string fen;
+        std::map<uint16_t, uint32_t> moveWeights;  // packed move -> weight
+    };
+    std::map<uint64_t, PositionEntry> m_entries;
+
+    // Pieces of one side that still have to move to reach the target
+    static int misplaced(const ChessBoard& board, const ChessBoard& target, int first) {
+        int count = 0;
+        for (int piece = first; piece < first + 6; piece++) {
+            count += Cpu::popcount(target[piece] & ~board[piece]);
+        }
+        return count;
+    }
+
+    static bool findLine(ChessBoard& board, bool isWhite, const ChessBoard& target,
+                         int pliesLeft, std::vector<Move>& line) {
+        if (board == target) {
+            return true;
+        }
+
+        // Every move fixes at most one piece of the side that plays it
+        int white = misplaced(board, target, WP);
+        int black = misplaced(board, target, BP);
+        int needed = isWhite ? std::max(2 * white - 1, 2 * black) : std::max(2 * black - 1, 2 * white);
+        if (needed > pliesLeft) {
+            return false;
+        }
+
+        MoveGen moveGen(board);
+        std::vector<Move> moves = moveGen.GenerateMoves(isWhite);
+        int friendly = isWhite ? WP : BP;
+        uint64_t enemies = 0;
+        for (int piece = (isWhite ? BP : WP); piece < (isWhite ? BP : WP) + 6; piece++) {
+            enemies |= board[piece];
+        }
+
+        for (const Move& move : moves) {
+            uint64_t fromBit = 1ULL << move.from();
+            uint64_t toBit = 1ULL << move.to();
+            if (toBit & enemies) {
+                continue;
+            }
+            int piece = friendly;
+            while (!(board[piece] & fromBit)) {
+                piece++;
+            }
+            if (!(target[piece] & toBit) || (target[piece] & fromBit)) {
+                continue;
+            }
+
+            board[piece] ^= fromBit | toBit;
+            line.push_back(move);
+            bool found = findLine(board, !isWhite, target, pliesLeft - 1, line);
+            board[piece] ^= fromBit | toBit;
+            if (found) {
+                return true;
+            }
+            line.pop_back();
+        }
+        return false;
+    }
+
+public:
+    // Finds the line to the position and adds every (position, move) on it.
+    // Returns false if no quiet line of up to MAX_LINE_PLIES reaches it.
+    bool addPosition(const std::string& fen) {
+        ChessBoard target(12, 0), board(12, 0);
+        setPositionFromFEN(target, fen);
+        setPositionFromFEN(board, START_FEN);
+
+        std::vector<Move> line;
+        if (!findLine(board, true, target, MAX_LINE_PLIES, line)) {
+            return false;
+        }
+
+        bool isWhite = true;
+        for (const Move& move : line) {
+            PositionEntry& entry = m_entries[Zobrist::hash(board, isWhite)];
+            if (entry.fen.empty()) {
+                entry.fen = boardToFen(board, {isWhite, castlingFromPlacement(board)});
+            }
+            entry.moveWeights[packBookMove(move)]++;
+
+            for (auto& bitboard : board) {
+                if (bitboard & (1ULL << move.from())) {
+                    bitboard ^= (1ULL << move.from()) | (1ULL << move.to());
+                    break;
+                }
+            }
+            isWhite = !isWhite;
+        }
+        return true;
+    }
+
+    // Every opening the database knows about
+    int addDatabase(ChessEngineDB& db) {
+        int added = 0;
+        for (const auto& rows : {db.GetChessBoardPosition(), db.getItalianPosition(),
+                                 db.GetQueensGambitPosition(), db.GetRuyLopezPosition()}) {
+            if (rows.empty()) {
+                continue;
+            }
+            std::string fen = db.getCompleteFEN(rows);
+            if (addPosition(fen)) {
+                added++;
+            } else {
+                std::cerr << "No opening line found for " << fen << "\n";
+            }
+        }
+        return added;
+    }
+
+    size_t entryCount() const {
+        size_t count = 0;
+        for (const auto& [key, entry] : m_entries) {
+            count += entry.moveWeights.size();
+        }
+        return count;
+    }
+
+    // Adds everything collected to the book tables in one transaction
+    void store(ChessEngineDB& db) const {
+        db.BeginTransaction();
+        for (const auto& [key, entry] : m_entries) {
+            db.AddBookPosition(key, entry.fen, {});
+            for (const auto& [move, weight] : entry.moveWeights) {
+                db.AddBookMove(key, move, weight, {});
+            }
+        }
+        db.CommitTransaction();
+    }
+
+    // Writes the book tables as a binary book (see book.hpp): sorted by
+    // unsigned key, heaviest move first. Returns the number of entries.
+    static size_t exportBook(ChessEngineDB& db, const std::string& path) {
+        std::vector<ChessEngineDB::BookRow> rows;
+        db.ForEachBookMove([&rows](const ChessEngineDB::BookRow& row) { rows.push_back(row); });
+        std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return a.key != b.key ? a.key < b.key : a.move.weight > b.move.weight;
+        });
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Cannot write opening book " + path);
+        }
+
+        auto put = [&out](uint64_t value, int bytes) {
+            for (int i = bytes - 1; i >= 0; i--) {
+                out.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+            }
+        };
+
+        for (const auto& row : rows) {
+            put(row.key, 8);
+            put(packBookMove(row.move.move), 2);
+            put(row.move.weight, 2);
+            put(0, 4);  // learn, unused
+        }
+        return rows.size();
+    }
+};
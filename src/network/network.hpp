@@ -1,28 +1,95 @@
 #pragma once
 #include <sqlite3.h>
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <stdexcept>
+#include <string>
+#include <vector>
+#include "book.hpp"
 
 
 //All member variables contain m_ htis sohudl be the standard conention going forward
 
-class ChessEngineDB
+class ChessEngineDB : public BookSource
 {
 
     private:
-    sqlite3* m_db;
+    sqlite3* m_db{nullptr};
+
+    // Statements are prepared once and reset between uses, preparing is
+    // by far the most expensive part of a small query
+    std::map<std::string, sqlite3_stmt*> m_rowStatements;
+    sqlite3_stmt* m_probeStatement{nullptr};
+    sqlite3_stmt* m_batchStatement{nullptr};
+    sqlite3_stmt* m_positionStatement{nullptr};
+    sqlite3_stmt* m_upsertPositionStatement{nullptr};
+    sqlite3_stmt* m_upsertMoveStatement{nullptr};
 
 
     void CheckError(int result,const char* operation){
         if(result != SQLITE_OK){
             const char* error = sqlite3_errmsg(m_db);
-            
+
             throw std::runtime_error("ERROR " + std::string(operation) + " :" + error);
 
         }
     }
 
-    public: 
+    sqlite3_stmt* Prepare(const std::string& sql){
+        sqlite3_stmt* stmt = nullptr;
+        int result = sqlite3_prepare_v3(m_db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+        CheckError(result, "preparing statement");
+        return stmt;
+    }
+
+    void Execute(const char* sql, const char* operation){
+        CheckError(sqlite3_exec(m_db, sql, nullptr, nullptr, nullptr), operation);
+    }
+
+    void Close(){
+        for (auto& [table, stmt] : m_rowStatements) {
+            sqlite3_finalize(stmt);
+        }
+        sqlite3_finalize(m_probeStatement);
+        sqlite3_finalize(m_batchStatement);
+        sqlite3_finalize(m_positionStatement);
+        sqlite3_finalize(m_upsertPositionStatement);
+        sqlite3_finalize(m_upsertMoveStatement);
+        if (m_db) {
+            sqlite3_close(m_db);
+        }
+    }
+
+    bool HasTable(const char* table){
+        sqlite3_stmt* stmt = Prepare("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?1");
+        sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+        bool found = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+        return found;
+    }
+
+    static sqlite3_int64 ToSqlKey(uint64_t key){
+        return static_cast<sqlite3_int64>(key);  // SQLite integers are signed 64 bit
+    }
+
+    static BookMove ReadBookMove(sqlite3_stmt* stmt, int moveColumn){
+        sqlite3_int64 weight = sqlite3_column_int64(stmt, moveColumn + 1);
+        return {unpackBookMove(static_cast<uint16_t>(sqlite3_column_int(stmt, moveColumn))),
+                static_cast<uint16_t>(std::min(weight, sqlite3_int64{0xFFFF}))};
+    }
+
+    static BookEntryStats ReadStats(sqlite3_stmt* stmt, int firstColumn){
+        return {static_cast<uint32_t>(sqlite3_column_int64(stmt, firstColumn)),
+                static_cast<uint32_t>(sqlite3_column_int64(stmt, firstColumn + 1)),
+                static_cast<uint32_t>(sqlite3_column_int64(stmt, firstColumn + 2))};
+    }
+
+    public:
+
+    // Keys per query of ProbeBookBatch, the statement has this many parameters
+    static constexpr int BATCH_SIZE = 32;
 
     struct Position {
         int id;
@@ -30,27 +97,59 @@ class ChessEngineDB
         std::string fen_notation;
     };
 
-    ChessEngineDB(const std::string& filename){
-        int result = sqlite3_open(filename.c_str(),&m_db);
-        CheckError(result,"Opening database");
+    // One book move of a position, as stored in book_moves
+    struct BookRow {
+        uint64_t key;
+        BookMove move;
+        BookEntryStats stats;
+    };
+
+    // readOnly opens an existing database for probing only: it is never
+    // created or written to, and one without a book throws like a missing file
+    explicit ChessEngineDB(const std::string& filename, bool readOnly = false){
+        int flags = readOnly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+        int result = sqlite3_open_v2(filename.c_str(), &m_db, flags, nullptr);
+        if (result != SQLITE_OK) {
+            std::string error = m_db ? sqlite3_errmsg(m_db) : "out of memory";
+            sqlite3_close(m_db);
+            throw std::runtime_error("ERROR Opening database " + filename + " :" + error);
+        }
+
+        // WAL lets readers (engines probing the book) run alongside an import.
+        // A read-only database keeps its journal mode, which is fine for probing.
+        if (!readOnly) {
+            sqlite3_exec(m_db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
+        }
 
+        // Databases from before the book tables still serve the opening rows
+        try {
+            if (HasTable("book_moves")) {
+                PrepareBookStatements();
+            } else if (readOnly) {
+                throw std::runtime_error("ERROR " + filename + " has no book_moves table");
+            }
+        } catch (...) {
+            Close();  // the destructor does not run for a throwing constructor
+            throw;
+        }
     }
 
+    ChessEngineDB(const ChessEngineDB&) = delete;
+    ChessEngineDB& operator=(const ChessEngineDB&) = delete;
+
     ~ChessEngineDB() {
-        if (m_db) {
-            sqlite3_close(m_db);
-        }
+        Close();
     }
 
         std::string getCompleteFEN(const std::vector<Position>& positions) {
         std::string complete_fen;
         // Sort positions by row
         std::vector<std::string> rows(8);
-        
+
         for (const auto& pos : positions) {
             rows[pos.row - 1] = pos.fen_notation;
         }
-        
+
         // Join rows with slashes to create complete FEN
         for (size_t i = 0; i < rows.size(); ++i) {
             complete_fen += rows[i];
@@ -58,7 +157,7 @@ class ChessEngineDB
                 complete_fen += "/";
             }
         }
-        
+
         // Add additional FEN information (side to move, castling, etc.)
         complete_fen += " w KQkq - 0 1";
         return complete_fen;
@@ -74,16 +173,157 @@ class ChessEngineDB
     std::vector<Position> GetQueensGambitPosition(){
         return GetPosition("fen_queen_gambit","queengambitid");
     }
+    std::vector<Position> GetRuyLopezPosition(){
+        return GetPosition("fen_ruy_lopez","ruylopezid");
+    }
+
+    // Book moves of one position, heaviest first. This is the lookup done
+    // during play: one bound parameter on a cached statement, answered from
+    // the covering index without touching the table.
+    int probe(uint64_t key, BookMove* out, int capacity) const override {
+        sqlite3_stmt* stmt = m_probeStatement;
+        if (!stmt) {
+            return 0;
+        }
+        sqlite3_reset(stmt);
+        sqlite3_bind_int64(stmt, 1, ToSqlKey(key));
+
+        int found = 0;
+        while (found < capacity && sqlite3_step(stmt) == SQLITE_ROW) {
+            out[found++] = ReadBookMove(stmt, 0);
+        }
+        sqlite3_reset(stmt);
+        return found;
+    }
+
+    // Book moves of many positions with one query per BATCH_SIZE keys,
+    // appended to out in no particular order
+    void ProbeBookBatch(const std::vector<uint64_t>& keys, std::vector<BookRow>& out){
+        PrepareBookStatements();
+        for (size_t start = 0; start < keys.size(); start += BATCH_SIZE) {
+            sqlite3_reset(m_batchStatement);
+            for (int i = 0; i < BATCH_SIZE; i++) {
+                // Short last batch: repeat a key, IN () ignores duplicates
+                size_t index = std::min(start + i, keys.size() - 1);
+                sqlite3_bind_int64(m_batchStatement, i + 1, ToSqlKey(keys[index]));
+            }
+            while (sqlite3_step(m_batchStatement) == SQLITE_ROW) {
+                out.push_back({static_cast<uint64_t>(sqlite3_column_int64(m_batchStatement, 0)),
+                               ReadBookMove(m_batchStatement, 1), ReadStats(m_batchStatement, 3)});
+            }
+        }
+        sqlite3_reset(m_batchStatement);
+    }
+
+    // FEN and game statistics of a book position, false if it is not in the book
+    bool GetBookPosition(uint64_t key, std::string& fen, BookEntryStats& stats){
+        PrepareBookStatements();
+        sqlite3_reset(m_positionStatement);
+        sqlite3_bind_int64(m_positionStatement, 1, ToSqlKey(key));
+        bool found = sqlite3_step(m_positionStatement) == SQLITE_ROW;
+        if (found) {
+            fen = reinterpret_cast<const char*>(sqlite3_column_text(m_positionStatement, 0));
+            stats = ReadStats(m_positionStatement, 1);
+        }
+        sqlite3_reset(m_positionStatement);
+        return found;
+    }
+
+    // Adds to the counts of a position / move, creating the row if needed.
+    // Call between BeginTransaction and CommitTransaction when adding many.
+    void AddBookPosition(uint64_t key, const std::string& fen, const BookEntryStats& stats){
+        PrepareBookStatements();
+        sqlite3_stmt* stmt = m_upsertPositionStatement;
+        sqlite3_reset(stmt);
+        sqlite3_bind_int64(stmt, 1, ToSqlKey(key));
+        sqlite3_bind_text(stmt, 2, fen.c_str(), static_cast<int>(fen.size()), SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 3, stats.whiteWins);
+        sqlite3_bind_int64(stmt, 4, stats.draws);
+        sqlite3_bind_int64(stmt, 5, stats.blackWins);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            CheckError(sqlite3_errcode(m_db), "adding book position");
+        }
+    }
+
+    void AddBookMove(uint64_t key, uint16_t move, uint32_t weight, const BookEntryStats& stats){
+        PrepareBookStatements();
+        sqlite3_stmt* stmt = m_upsertMoveStatement;
+        sqlite3_reset(stmt);
+        sqlite3_bind_int64(stmt, 1, ToSqlKey(key));
+        sqlite3_bind_int(stmt, 2, move);
+        sqlite3_bind_int64(stmt, 3, weight);
+        sqlite3_bind_int64(stmt, 4, stats.whiteWins);
+        sqlite3_bind_int64(stmt, 5, stats.draws);
+        sqlite3_bind_int64(stmt, 6, stats.blackWins);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            CheckError(sqlite3_errcode(m_db), "adding book move");
+        }
+    }
+
+    void BeginTransaction(){
+        Execute("BEGIN IMMEDIATE", "beginning transaction");
+    }
+
+    void CommitTransaction(){
+        Execute("COMMIT", "committing transaction");
+    }
+
+    // Walks every book move, used to export the binary book
+    void ForEachBookMove(const std::function<void(const BookRow&)>& callback){
+        sqlite3_stmt* stmt = Prepare(
+            "SELECT position_key, move, weight, white_wins, draws, black_wins FROM book_moves");
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            callback({static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)),
+                      ReadBookMove(stmt, 1), ReadStats(stmt, 3)});
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    // Prepares the book statements, needs the book tables from chess_openings.sql
+    void PrepareBookStatements(){
+        if (m_probeStatement) {
+            return;
+        }
+        m_probeStatement = Prepare(
+            "SELECT move, weight FROM book_moves WHERE position_key = ?1 ORDER BY weight DESC");
+
+        std::string batch = "SELECT position_key, move, weight, white_wins, draws, black_wins "
+                            "FROM book_moves WHERE position_key IN (";
+        for (int i = 1; i <= BATCH_SIZE; i++) {
+            batch += "?" + std::to_string(i) + (i < BATCH_SIZE ? "," : ")");
+        }
+        m_batchStatement = Prepare(batch);
+
+        m_positionStatement = Prepare(
+            "SELECT fen, white_wins, draws, black_wins FROM book_positions WHERE position_key = ?1");
+        m_upsertPositionStatement = Prepare(
+            "INSERT INTO book_positions (position_key, fen, white_wins, draws, black_wins) "
+            "VALUES (?1, ?2, ?3, ?4, ?5) "
+            "ON CONFLICT(position_key) DO UPDATE SET "
+            "white_wins = white_wins + excluded.white_wins, "
+            "draws = draws + excluded.draws, "
+            "black_wins = black_wins + excluded.black_wins");
+        m_upsertMoveStatement = Prepare(
+            "INSERT INTO book_moves (position_key, move, weight, white_wins, draws, black_wins) "
+            "VALUES (?1, ?2, ?3, ?4, ?5, ?6) "
+            "ON CONFLICT(position_key, move) DO UPDATE SET "
+            "weight = weight + excluded.weight, "
+            "white_wins = white_wins + excluded.white_wins, "
+            "draws = draws + excluded.draws, "
+            "black_wins = black_wins + excluded.black_wins");
+    }
+
     private:
     std::vector<Position> GetPosition(const std::string& table, const std::string& id_column){
         std::vector<Position> position;
-        sqlite3_stmt* stmt;
-        
-        std::string sql = "SELECT " + id_column + ", row, fen_notation FROM " + table + 
-                         " ORDER BY row";
 
-        int result = sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr);
-        CheckError(result, "preparing statement");
+        // Table names cannot be bound, but they are our own constants
+        sqlite3_stmt*& stmt = m_rowStatements[table];
+        if (!stmt) {
+            stmt = Prepare("SELECT " + id_column + ", row, fen_notation FROM " + table +
+                           " ORDER BY row");
+        }
+        sqlite3_reset(stmt);
 
         while(sqlite3_step(stmt) == SQLITE_ROW){
             Position pos;
@@ -92,7 +332,7 @@ class ChessEngineDB
             pos.fen_notation = reinterpret_cast<const char*>(sqlite3_column_text(stmt,2));
             position.push_back(pos);
         }
-        sqlite3_finalize(stmt);
+        sqlite3_reset(stmt);
         return position;
     }
-};
\ No newline at end of file
+};
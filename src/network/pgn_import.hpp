@@ -0,0 +1,526 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "book.hpp"
+#include "network.hpp"
+#include "../engine/board.hpp"
+#include "../engine/movegen.hpp"
+#include "../utils/mapped_file.hpp"
+#include "../utils/zobrist.hpp"
+
+struct PgnImportOptions {
+    int maxPly{24};                 // positions deeper than this are not recorded
+    unsigned threads{std::max(1u, std::thread::hardware_concurrency())};
+    size_t rowsPerTransaction{100000};
+};
+
+struct PgnImportResult {
+    uint64_t games{0};
+    uint64_t skippedGames{0};       // unreadable SAN or unsupported start
+    uint64_t positions{0};
+    uint64_t moves{0};
+    double parseSeconds{0.0};
+    double writeSeconds{0.0};
+};
+
+// Streams a PGN file into the book tables. The file is memory-mapped and cut
+// into chunks at game boundaries; parser threads take chunks off a shared
+// counter and decode the SAN moves with MoveGen on their own board, counting
+// (position, move, result) in a thread-local table. The tables are merged and
+// written with large transactions at the end.
+class PgnImporter {
+private:
+    static constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024;
+    static constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    enum class Result { Unknown, WhiteWins, Draw, BlackWins };
+
+    struct MoveCounts {
+        uint32_t weight{0};
+        BookEntryStats stats;
+    };
+
+    struct PositionCounts {
+        std::string fen;
+        BookEntryStats stats;
+        std::unordered_map<uint16_t, MoveCounts> moves;
+    };
+
+    using PositionTable = std::unordered_map<uint64_t, PositionCounts>;
+
+    static void addResult(BookEntryStats& stats, Result result, uint32_t count = 1) {
+        if (result == Result::WhiteWins) stats.whiteWins += count;
+        else if (result == Result::Draw) stats.draws += count;
+        else if (result == Result::BlackWins) stats.blackWins += count;
+    }
+
+    static Result parseResult(std::string_view text) {
+        if (text == "1-0") return Result::WhiteWins;
+        if (text == "0-1") return Result::BlackWins;
+        if (text == "1/2-1/2") return Result::Draw;
+        return Result::Unknown;
+    }
+
+    // Decodes games on its own board, one per thread
+    class GameParser {
+    private:
+        ChessBoard m_board;
+        MoveGen m_moveGen;
+        bool m_whiteToMove{true};
+        int m_maxPly;
+        PositionTable& m_table;
+
+        struct PlyRecord {
+            uint64_t key;
+            uint16_t move;
+        };
+        std::vector<PlyRecord> m_line;
+
+        int pieceOn(int square, int first) const {
+            for (int piece = first; piece < first + 6; piece++) {
+                if (m_board[piece] & (1ULL << square)) {
+                    return piece;
+                }
+            }
+            return -1;
+        }
+
+        bool kingAttacked(bool isWhite) {
+            uint64_t king = m_board[isWhite ? WK : BK];
+            return king && m_moveGen.isSquareAttacked(getLSB(king), !isWhite);
+        }
+
+        // Plays from -> to, with the captured piece (if any) on captureSquare
+        void playOnBoard(int from, int to, int captureSquare, int promotion) {
+            int friendly = m_whiteToMove ? WP : BP;
+            int enemy = m_whiteToMove ? BP : WP;
+            int captured = pieceOn(captureSquare, enemy);
+            if (captured >= 0) {
+                m_board[captured] &= ~(1ULL << captureSquare);
+            }
+            int piece = pieceOn(from, friendly);
+            m_board[piece] &= ~(1ULL << from);
+            m_board[promotion >= 0 ? friendly + promotion : piece] |= 1ULL << to;
+        }
+
+        bool playCastle(bool kingSide) {
+            int rank = m_whiteToMove ? 0 : 56;
+            int king = m_whiteToMove ? WK : BK;
+            int rook = m_whiteToMove ? WR : BR;
+            int rookFrom = rank + (kingSide ? 7 : 0);
+            if (!(m_board[king] & (1ULL << (rank + 4))) || !(m_board[rook] & (1ULL << rookFrom))) {
+                return false;
+            }
+            m_board[king] ^= (1ULL << (rank + 4)) | (1ULL << (rank + (kingSide ? 6 : 2)));
+            m_board[rook] ^= (1ULL << rookFrom) | (1ULL << (rank + (kingSide ? 5 : 3)));
+            return true;
+        }
+
+        // Decodes one SAN move against the generated moves and plays it.
+        // Returns false if it does not match exactly one legal move.
+        bool playSan(std::string_view san, Move& played) {
+            while (!san.empty() && std::strchr("+#!?", san.back())) {
+                san.remove_suffix(1);
+            }
+            if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+                bool kingSide = san.size() == 3;
+                int rank = m_whiteToMove ? 0 : 56;
+                played = Move(rank + 4, rank + (kingSide ? 6 : 2), Move::Castling);
+                return playCastle(kingSide);
+            }
+
+            // Promotion, "e8=Q" or "e8Q"
+            int promotion = -1;
+            if (san.size() >= 3 && std::strchr("NBRQ", san.back())) {
+                promotion = static_cast<int>(std::strchr("PNBRQK", san.back()) - "PNBRQK");
+                san.remove_suffix(1);
+                if (!san.empty() && san.back() == '=') {
+                    san.remove_suffix(1);
+                }
+            }
+            if (san.size() < 2) {
+                return false;
+            }
+
+            int pieceType = 0;  // offset from WP / BP
+            if (std::strchr("NBRQK", san.front())) {
+                pieceType = static_cast<int>(std::strchr("PNBRQK", san.front()) - "PNBRQK");
+                san.remove_prefix(1);
+            }
+
+            char toFile = san[san.size() - 2], toRank = san[san.size() - 1];
+            if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8') {
+                return false;
+            }
+            int to = (toFile - 'a') + (toRank - '1') * 8;
+            san.remove_suffix(2);
+
+            int fromFile = -1, fromRank = -1;
+            bool capture = false;
+            for (char c : san) {
+                if (c >= 'a' && c <= 'h') fromFile = c - 'a';
+                else if (c >= '1' && c <= '8') fromRank = c - '1';
+                else if (c == 'x') capture = true;
+                else return false;
+            }
+
+            int friendly = m_whiteToMove ? WP : BP;
+            uint64_t occupied = 0;
+            for (const auto& bitboard : m_board) {
+                occupied |= bitboard;
+            }
+
+            // En passant: a pawn capturing onto an empty square, which MoveGen
+            // does not generate
+            if (pieceType == 0 && capture && !(occupied & (1ULL << to)) && fromFile >= 0) {
+                int from = fromFile + (toRank - '1' + (m_whiteToMove ? -1 : 1)) * 8;
+                int victim = to + (m_whiteToMove ? -8 : 8);
+                if (!(m_board[friendly] & (1ULL << from))) {
+                    return false;
+                }
+                playOnBoard(from, to, victim, -1);
+                played = Move(from, to, Move::EnPassant);
+                return true;
+            }
+
+            std::vector<Move> candidates;
+            for (const Move& move : m_moveGen.GenerateMoves(m_whiteToMove)) {
+                if (move.to() != to || !(m_board[friendly + pieceType] & (1ULL << move.from()))) continue;
+                if (fromFile >= 0 && move.from() % 8 != fromFile) continue;
+                if (fromRank >= 0 && move.from() / 8 != fromRank) continue;
+                if (move.isPromotion() && move.promotionType() != promotion) continue;
+                candidates.push_back(move);
+            }
+
+            // SAN leaves out the disambiguation when the other piece is
+            // pinned, so ambiguous moves are settled by legality
+            ChessBoard before = m_board;
+            int matches = 0;
+            for (const Move& move : candidates) {
+                m_board = before;
+                playOnBoard(move.from(), move.to(), move.to(), promotion);
+                if (candidates.size() == 1 || !kingAttacked(m_whiteToMove)) {
+                    played = move;
+                    matches++;
+                    if (candidates.size() == 1) break;
+                }
+            }
+            if (matches != 1) {
+                m_board = before;
+                return false;
+            }
+            if (candidates.size() > 1) {
+                m_board = before;
+                playOnBoard(played.from(), played.to(), played.to(), promotion);
+            }
+            if (promotion > 0) {
+                played = Move(played.from(), played.to(), static_cast<Move::Flag>(promotion));
+            }
+            return true;
+        }
+
+        void finishGame(Result result) {
+            for (const PlyRecord& ply : m_line) {
+                PositionCounts& position = m_table[ply.key];
+                addResult(position.stats, result);
+                MoveCounts& counts = position.moves[ply.move];
+                counts.weight++;
+                addResult(counts.stats, result);
+            }
+        }
+
+    public:
+        GameParser(int maxPly, PositionTable& table)
+            : m_board(12, 0), m_moveGen(m_board), m_maxPly(maxPly), m_table(table) {}
+
+        // Parses the games in [text, end), returns (games read, games skipped)
+        std::pair<uint64_t, uint64_t> parse(const char* text, const char* end) {
+            uint64_t games = 0, skipped = 0;
+            const char* p = text;
+
+            while (p < end) {
+                // Tag section
+                Result result = Result::Unknown;
+                std::string fen = START_FEN;
+                while (p < end && (*p == '[' || std::isspace(static_cast<unsigned char>(*p)))) {
+                    if (*p != '[') {
+                        p++;
+                        continue;
+                    }
+                    const char* lineEnd = std::find(p, end, '\n');
+                    std::string_view tag(p, static_cast<size_t>(lineEnd - p));
+                    size_t open = tag.find('"'), close = tag.rfind('"');
+                    if (open != std::string_view::npos && close > open) {
+                        std::string_view name = tag.substr(1, tag.find(' ') - 1);
+                        std::string_view value = tag.substr(open + 1, close - open - 1);
+                        if (name == "Result") result = parseResult(value);
+                        else if (name == "FEN") fen = std::string(value);
+                    }
+                    p = lineEnd;
+                }
+                if (p >= end) {
+                    break;
+                }
+
+                // Movetext, up to the next tag line
+                bool ok = true;
+                try {
+                    setPositionFromFEN(m_board, fen);
+                    m_whiteToMove = isWhiteturnFen(fen);
+                } catch (const std::exception&) {
+                    ok = false;
+                }
+                m_line.clear();
+                int ply = 0;
+                bool lineStart = false;
+                int variationDepth = 0;
+
+                while (p < end) {
+                    char c = *p;
+                    if (lineStart && c == '[' && variationDepth == 0) {
+                        break;
+                    }
+                    if (c == '\n') {
+                        lineStart = true;
+                        p++;
+                        continue;
+                    }
+                    lineStart = false;
+                    if (std::isspace(static_cast<unsigned char>(c))) {
+                        p++;
+                    } else if (c == '{') {
+                        p = std::find(p, end, '}');
+                        p = p < end ? p + 1 : end;
+                    } else if (c == ';') {
+                        p = std::find(p, end, '\n');
+                    } else if (c == '(') {
+                        variationDepth++;
+                        p++;
+                    } else if (c == ')') {
+                        variationDepth = std::max(0, variationDepth - 1);
+                        p++;
+                    } else {
+                        const char* tokenEnd = p;
+                        while (tokenEnd < end && !std::isspace(static_cast<unsigned char>(*tokenEnd)) &&
+                               !std::strchr("{}();", *tokenEnd)) {
+                            tokenEnd++;
+                        }
+                        std::string_view token(p, static_cast<size_t>(tokenEnd - p));
+                        p = tokenEnd;
+
+                        if (variationDepth > 0 || token[0] == '$') {
+                            continue;
+                        }
+                        // Move numbers, "12." or "12..." possibly glued to the move
+                        size_t skip = 0;
+                        while (skip < token.size() && std::isdigit(static_cast<unsigned char>(token[skip]))) skip++;
+                        if (skip < token.size() && token[skip] == '.') {
+                            while (skip < token.size() && token[skip] == '.') skip++;
+                            token.remove_prefix(skip);
+                        }
+                        if (token.empty()) {
+                            continue;
+                        }
+                        if (token == "*" || token == "1-0" || token == "0-1" || token == "1/2-1/2") {
+                            if (result == Result::Unknown) result = parseResult(token);
+                            continue;
+                        }
+                        if (!ok || ply >= m_maxPly) {
+                            continue;
+                        }
+
+                        uint64_t key = Zobrist::hash(m_board, m_whiteToMove);
+                        Move move;
+                        if (!playSan(token, move)) {
+                            ok = false;
+                            continue;
+                        }
+                        m_line.push_back({key, packBookMove(move)});
+                        m_whiteToMove = !m_whiteToMove;
+                        ply++;
+                    }
+                }
+
+                games++;
+                if (ok && !m_line.empty()) {
+                    finishGame(result);
+                } else {
+                    skipped++;
+                }
+            }
+            return {games, skipped};
+        }
+    };
+
+    // Chunk boundaries fall on the "[Event" that starts a game
+    static std::vector<const char*> splitChunks(const char* begin, const char* end) {
+        std::vector<const char*> cuts{begin};
+        const char* p = begin;
+        while (static_cast<size_t>(end - p) > CHUNK_SIZE) {
+            std::string_view rest(p + CHUNK_SIZE, static_cast<size_t>(end - p - CHUNK_SIZE));
+            size_t next = rest.find("\n[Event ");
+            if (next == std::string_view::npos) {
+                break;
+            }
+            p = rest.data() + next + 1;
+            cuts.push_back(p);
+        }
+        cuts.push_back(end);
+        return cuts;
+    }
+
+    static void merge(PositionTable& into, PositionTable& from) {
+        for (auto& [key, position] : from) {
+            PositionCounts& target = into[key];
+            target.stats.whiteWins += position.stats.whiteWins;
+            target.stats.draws += position.stats.draws;
+            target.stats.blackWins += position.stats.blackWins;
+            for (auto& [move, counts] : position.moves) {
+                MoveCounts& targetMove = target.moves[move];
+                targetMove.weight += counts.weight;
+                targetMove.stats.whiteWins += counts.stats.whiteWins;
+                targetMove.stats.draws += counts.stats.draws;
+                targetMove.stats.blackWins += counts.stats.blackWins;
+            }
+        }
+        from.clear();
+    }
+
+public:
+    static PgnImportResult import(const std::string& pgnPath, ChessEngineDB& db,
+                                  const PgnImportOptions& options = {}) {
+        MappedFile file(pgnPath);
+        if (!file.isOpen()) {
+            throw std::runtime_error("Cannot open PGN file " + pgnPath);
+        }
+
+        PgnImportResult result;
+        auto parseStart = std::chrono::steady_clock::now();
+
+        const char* begin = reinterpret_cast<const char*>(file.data());
+        std::vector<const char*> cuts = splitChunks(begin, begin + file.size());
+        size_t chunkCount = cuts.size() - 1;
+
+        unsigned threadCount = std::max(1u, std::min<unsigned>(options.threads, static_cast<unsigned>(chunkCount)));
+        std::vector<PositionTable> tables(threadCount);
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<uint64_t> games{0}, skipped{0};
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threadCount; t++) {
+            workers.emplace_back([&, t] {
+                GameParser parser(options.maxPly, tables[t]);
+                for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+                    auto [read, bad] = parser.parse(cuts[chunk], cuts[chunk + 1]);
+                    games += read;
+                    skipped += bad;
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (unsigned t = 1; t < threadCount; t++) {
+            merge(tables[0], tables[t]);
+        }
+        PositionTable& positions = tables[0];
+
+        result.games = games;
+        result.skippedGames = skipped;
+        result.parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+
+        auto writeStart = std::chrono::steady_clock::now();
+        std::unordered_map<uint64_t, std::string> fens;
+        collectFens(positions, fens);
+
+        size_t rows = 0;
+        db.BeginTransaction();
+        for (const auto& [key, position] : positions) {
+            auto fen = fens.find(key);
+            db.AddBookPosition(key, fen != fens.end() ? fen->second : std::string(), position.stats);
+            for (const auto& [move, counts] : position.moves) {
+                db.AddBookMove(key, move, counts.weight, counts.stats);
+                result.moves++;
+                if (++rows % options.rowsPerTransaction == 0) {
+                    db.CommitTransaction();
+                    db.BeginTransaction();
+                }
+            }
+            result.positions++;
+        }
+        db.CommitTransaction();
+        result.writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - writeStart).count();
+        return result;
+    }
+
+private:
+    // The parsers only carry keys, so the FEN of each position is rebuilt by
+    // walking the recorded moves from the start position. Positions only
+    // reached from a [FEN] start are stored without one.
+    static void collectFens(const PositionTable& positions, std::unordered_map<uint64_t, std::string>& fens) {
+        ChessBoard board(12, 0);
+        setPositionFromFEN(board, START_FEN);
+        std::vector<std::pair<ChessBoard, bool>> stack{{board, true}};
+        while (!stack.empty()) {
+            auto [current, isWhite] = std::move(stack.back());
+            stack.pop_back();
+            uint64_t key = Zobrist::hash(current, isWhite);
+            auto it = positions.find(key);
+            if (it == positions.end() || fens.count(key)) {
+                continue;
+            }
+            fens.emplace(key, boardToFen(current, {isWhite, castlingFromPlacement(current)}));
+
+            for (const auto& [packed, counts] : it->second.moves) {
+                Move move = unpackBookMove(packed);
+                ChessBoard next = current;
+                applyBookMove(next, move, isWhite);
+                stack.push_back({std::move(next), !isWhite});
+            }
+        }
+    }
+
+    // Plays a book move without MoveGen: captures, promotions, castling (king
+    // moving two files) and en passant (pawn moving diagonally to an empty
+    // square). Book moves do not keep the castling / en passant flags.
+    static void applyBookMove(ChessBoard& board, const Move& move, bool isWhite) {
+        uint64_t fromBit = 1ULL << move.from(), toBit = 1ULL << move.to();
+        int friendly = isWhite ? WP : BP, enemy = isWhite ? BP : WP;
+        uint64_t occupied = 0;
+        for (const auto& bitboard : board) {
+            occupied |= bitboard;
+        }
+        int piece = friendly;
+        while (piece < friendly + 6 && !(board[piece] & fromBit)) {
+            piece++;
+        }
+        if (piece == friendly + 6) {
+            return;
+        }
+
+        if (piece == friendly && (move.from() % 8) != (move.to() % 8) && !(occupied & toBit)) {
+            board[enemy] &= ~(1ULL << (move.to() + (isWhite ? -8 : 8)));
+        }
+        for (int victim = enemy; victim < enemy + 6; victim++) {
+            board[victim] &= ~toBit;
+        }
+        board[piece] &= ~fromBit;
+        board[move.isPromotion() ? friendly + move.promotionType() : piece] |= toBit;
+        if (piece == friendly + 5 && std::abs(move.to() - move.from()) == 2) {
+            int rank = move.from() & 56;
+            bool kingSide = move.to() > move.from();
+            board[friendly + 3] ^= (1ULL << (rank + (kingSide ? 7 : 0))) | (1ULL << (rank + (kingSide ? 5 : 3)));
+        }
+    }
+};
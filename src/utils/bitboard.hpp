@@ -0,0 +1,184 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+
+// Set-wise bitboard operations: everything here works on all the bits of a
+// board at once, without loops over squares or branches, so the evaluation
+// can ask "which of our pawns are passed" in a handful of instructions.
+// Squares are rank * 8 + file like everywhere else, so north is << 8 and
+// east is << 1. After the fills on the Chess Programming Wiki.
+namespace Bitboards {
+
+constexpr uint64_t FILE_A = 0x0101010101010101ULL;
+constexpr uint64_t FILE_H = FILE_A << 7;
+constexpr uint64_t NOT_FILE_A = ~FILE_A;
+constexpr uint64_t NOT_FILE_H = ~FILE_H;
+constexpr uint64_t RANK_1 = 0xFFULL;
+constexpr uint64_t RANK_8 = RANK_1 << 56;
+
+// One step in a direction. Bits that would wrap around to the other side of
+// the board are masked off, the ones that fall off the top or bottom are lost.
+constexpr uint64_t north(uint64_t b) { return b << 8; }
+constexpr uint64_t south(uint64_t b) { return b >> 8; }
+constexpr uint64_t east(uint64_t b) { return (b << 1) & NOT_FILE_A; }
+constexpr uint64_t west(uint64_t b) { return (b >> 1) & NOT_FILE_H; }
+constexpr uint64_t northEast(uint64_t b) { return (b << 9) & NOT_FILE_A; }
+constexpr uint64_t northWest(uint64_t b) { return (b << 7) & NOT_FILE_H; }
+constexpr uint64_t southEast(uint64_t b) { return (b >> 7) & NOT_FILE_A; }
+constexpr uint64_t southWest(uint64_t b) { return (b >> 9) & NOT_FILE_H; }
+
+// Forward for the side: north for white, south for black
+constexpr uint64_t forward(uint64_t b, bool white) { return white ? north(b) : south(b); }
+
+// Kogge-Stone occluded fills: the bits of gen spread in one direction
+// through the empty squares, gen included, in three doubling steps instead
+// of up to seven single ones. Shifted one step further they are the attacks
+// of sliders on gen. The east / west variants clear the wrap file from the
+// propagator once, which keeps every doubling step from wrapping.
+constexpr uint64_t northFill(uint64_t gen, uint64_t empty) {
+    gen |= empty & (gen << 8);
+    empty &= empty << 8;
+    gen |= empty & (gen << 16);
+    empty &= empty << 16;
+    return gen | (empty & (gen << 32));
+}
+
+constexpr uint64_t southFill(uint64_t gen, uint64_t empty) {
+    gen |= empty & (gen >> 8);
+    empty &= empty >> 8;
+    gen |= empty & (gen >> 16);
+    empty &= empty >> 16;
+    return gen | (empty & (gen >> 32));
+}
+
+constexpr uint64_t eastFill(uint64_t gen, uint64_t empty) {
+    empty &= NOT_FILE_A;
+    gen |= empty & (gen << 1);
+    empty &= empty << 1;
+    gen |= empty & (gen << 2);
+    empty &= empty << 2;
+    return gen | (empty & (gen << 4));
+}
+
+constexpr uint64_t westFill(uint64_t gen, uint64_t empty) {
+    empty &= NOT_FILE_H;
+    gen |= empty & (gen >> 1);
+    empty &= empty >> 1;
+    gen |= empty & (gen >> 2);
+    empty &= empty >> 2;
+    return gen | (empty & (gen >> 4));
+}
+
+constexpr uint64_t northEastFill(uint64_t gen, uint64_t empty) {
+    empty &= NOT_FILE_A;
+    gen |= empty & (gen << 9);
+    empty &= empty << 9;
+    gen |= empty & (gen << 18);
+    empty &= empty << 18;
+    return gen | (empty & (gen << 36));
+}
+
+constexpr uint64_t northWestFill(uint64_t gen, uint64_t empty) {
+    empty &= NOT_FILE_H;
+    gen |= empty & (gen << 7);
+    empty &= empty << 7;
+    gen |= empty & (gen << 14);
+    empty &= empty << 14;
+    return gen | (empty & (gen << 28));
+}
+
+constexpr uint64_t southEastFill(uint64_t gen, uint64_t empty) {
+    empty &= NOT_FILE_A;
+    gen |= empty & (gen >> 7);
+    empty &= empty >> 7;
+    gen |= empty & (gen >> 14);
+    empty &= empty >> 14;
+    return gen | (empty & (gen >> 28));
+}
+
+constexpr uint64_t southWestFill(uint64_t gen, uint64_t empty) {
+    empty &= NOT_FILE_H;
+    gen |= empty & (gen >> 9);
+    empty &= empty >> 9;
+    gen |= empty & (gen >> 18);
+    empty &= empty >> 18;
+    return gen | (empty & (gen >> 36));
+}
+
+// Sliding attacks of every rook / bishop in sliders at once
+constexpr uint64_t rookAttacks(uint64_t sliders, uint64_t empty) {
+    return north(northFill(sliders, empty)) | south(southFill(sliders, empty)) |
+           east(eastFill(sliders, empty)) | west(westFill(sliders, empty));
+}
+
+constexpr uint64_t bishopAttacks(uint64_t sliders, uint64_t empty) {
+    return northEast(northEastFill(sliders, empty)) | northWest(northWestFill(sliders, empty)) |
+           southEast(southEastFill(sliders, empty)) | southWest(southWestFill(sliders, empty));
+}
+
+// Unoccluded fills, nothing stops them: the bits of b smeared to the edge
+constexpr uint64_t northFill(uint64_t b) {
+    b |= b << 8;
+    b |= b << 16;
+    return b | (b << 32);
+}
+
+constexpr uint64_t southFill(uint64_t b) {
+    b |= b >> 8;
+    b |= b >> 16;
+    return b | (b >> 32);
+}
+
+// Every file that has a bit of b, all of it
+constexpr uint64_t fileFill(uint64_t b) { return northFill(b) | southFill(b); }
+
+// The files next to the files of b, those themselves not included unless
+// they are next to another one
+constexpr uint64_t adjacentFiles(uint64_t files) { return east(files) | west(files); }
+
+// Squares in front of / behind the pawns of a side on their own files, the
+// pawns' squares not included. Front is north for white, south for black.
+constexpr uint64_t frontSpan(uint64_t pawns, bool white) {
+    return white ? north(northFill(pawns)) : south(southFill(pawns));
+}
+
+constexpr uint64_t rearSpan(uint64_t pawns, bool white) {
+    return white ? south(southFill(pawns)) : north(northFill(pawns));
+}
+
+// Squares the pawns attack, and every square any of them could attack on
+// its way up the board
+constexpr uint64_t pawnAttacks(uint64_t pawns, bool white) {
+    return white ? northEast(pawns) | northWest(pawns) : southEast(pawns) | southWest(pawns);
+}
+
+constexpr uint64_t attackSpan(uint64_t pawns, bool white) {
+    return adjacentFiles(frontSpan(pawns, white));
+}
+
+// Pawns with no enemy pawn in front of them on their own or a next file.
+// The enemy's front spans and attack spans cover exactly the squares from
+// which such a pawn would be stopped or captured.
+constexpr uint64_t passedPawns(uint64_t pawns, uint64_t enemyPawns, bool white) {
+    uint64_t enemyFront = frontSpan(enemyPawns, !white);
+    return pawns & ~(enemyFront | adjacentFiles(enemyFront));
+}
+
+// Pawns without a friendly pawn on a next file
+constexpr uint64_t isolatedPawns(uint64_t pawns) {
+    return pawns & ~adjacentFiles(fileFill(pawns));
+}
+
+// Files without pawns of the given set, as full files
+constexpr uint64_t openFiles(uint64_t pawns) { return ~fileFill(pawns); }
+
+// Mirrors the ranks, rank 1 <-> rank 8, to look at black's pieces as white's
+inline uint64_t flipVertical(uint64_t b) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(b);
+#else
+    return __builtin_bswap64(b);
+#endif
+}
+
+}  // namespace Bitboards
@@ -0,0 +1,206 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LANCER_X86_64 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only let a function use AVX2 intrinsics when it says so,
+// MSVC always does
+#if defined(LANCER_X86_64) && !defined(_MSC_VER)
+#define LANCER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LANCER_TARGET_AVX2
+#endif
+
+// Bit kernels that have a faster instruction on newer x86 CPUs. The build
+// sets no -march, so one binary runs everywhere; which instructions it uses
+// is chosen once at startup from cpuid. The paths build on each other:
+//   generic  portable C++
+//   popcnt   hardware popcount
+//   bmi2     + PEXT indexed slider attacks (Attacks::rook / bishop)
+//   avx2     + AVX2 weighted popcount for the material key (material.hpp)
+// LANCER_CPU=generic|popcnt|bmi2|avx2 in the environment caps the choice, to
+// compare the paths with bench, or to keep AMD CPUs before Zen 3 (PEXT in
+// microcode, hundreds of cycles) off bmi2.
+//
+// Popcount and PEXT are a branch on the path plus an inline asm instruction,
+// so they inline into callers compiled for the baseline. A branch that always
+// goes the same way costs next to nothing next to a function pointer call.
+namespace Cpu {
+
+enum class Path : uint8_t { Generic, Popcnt, Bmi2, Avx2 };
+
+inline const char* name(Path path) {
+    switch (path) {
+        case Path::Popcnt: return "popcnt";
+        case Path::Bmi2: return "bmi2";
+        case Path::Avx2: return "avx2";
+        default: return "generic";
+    }
+}
+
+// Best path this CPU (and for AVX2, the OS saving ymm registers) supports
+inline Path detect() {
+#if defined(LANCER_X86_64)
+    unsigned int regs[4] = {0, 0, 0, 0};  // eax, ebx, ecx, edx
+    auto cpuid = [&regs](unsigned int leaf) {
+#if defined(_MSC_VER)
+        int out[4];
+        __cpuidex(out, static_cast<int>(leaf), 0);
+        for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(out[i]);
+#else
+        __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    };
+
+    cpuid(0);
+    unsigned int maxLeaf = regs[0];
+    cpuid(1);
+    bool popcnt = regs[2] & (1u << 23);
+    bool osSavesYmm = false;
+    if (regs[2] & (1u << 27)) {  // OSXSAVE, xgetbv is there
+#if defined(_MSC_VER)
+        uint64_t xcr0 = _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        uint64_t xcr0 = (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+        osSavesYmm = (xcr0 & 6) == 6;
+    }
+    bool bmi2 = false, avx2 = false;
+    if (maxLeaf >= 7) {
+        cpuid(7);
+        bmi2 = regs[1] & (1u << 8);
+        avx2 = (regs[1] & (1u << 5)) && osSavesYmm;
+    }
+
+    if (!popcnt) return Path::Generic;
+    if (!bmi2) return Path::Popcnt;
+    return avx2 ? Path::Avx2 : Path::Bmi2;
+#else
+    return Path::Generic;
+#endif
+}
+
+// detect(), capped by LANCER_CPU when that names a path
+inline Path initialPath() {
+    Path best = detect();
+    if (const char* wanted = std::getenv("LANCER_CPU")) {
+        for (Path path : {Path::Generic, Path::Popcnt, Path::Bmi2, Path::Avx2}) {
+            if (wanted == std::string(name(path)) && path < best) best = path;
+        }
+    }
+    return best;
+}
+
+// Set before main() and never changed, the tables built for a path
+// (Attacks::PEXT) depend on it
+inline const Path activePath = initialPath();
+
+inline Path path() { return activePath; }
+inline bool hasPopcnt() { return activePath >= Path::Popcnt; }
+inline bool hasPext() { return activePath >= Path::Bmi2; }
+inline bool hasAvx2() { return activePath >= Path::Avx2; }
+
+// Clears a bit per round. Our sets are sparse (a side's pieces of one type,
+// a piece's moves), so this beats the branchless SWAR version in practice.
+inline int popcountGeneric(uint64_t b) {
+    int count = 0;
+    for (; b; b &= b - 1) {
+        count++;
+    }
+    return count;
+}
+
+inline int popcount(uint64_t b) {
+#if defined(__POPCNT__)
+    return std::popcount(b);  // built with -mpopcnt or better anyway
+#elif defined(LANCER_X86_64) && defined(_MSC_VER)
+    if (hasPopcnt()) return static_cast<int>(__popcnt64(b));
+    return popcountGeneric(b);
+#elif defined(LANCER_X86_64)
+    if (hasPopcnt()) {
+        uint64_t count;
+        __asm__("popcntq %1, %0" : "=r"(count) : "rm"(b) : "cc");
+        return static_cast<int>(count);
+    }
+    return popcountGeneric(b);
+#else
+    return std::popcount(b);
+#endif
+}
+
+// The bits of b under mask, packed into the low bits. Only call with
+// hasPext(); depositGeneric is the way back, for building tables.
+inline uint64_t pext(uint64_t b, uint64_t mask) {
+#if defined(__BMI2__) || (defined(LANCER_X86_64) && defined(_MSC_VER))
+    return _pext_u64(b, mask);
+#elif defined(LANCER_X86_64)
+    uint64_t packed;
+    __asm__("pextq %2, %1, %0" : "=r"(packed) : "r"(b), "rm"(mask));
+    return packed;
+#else
+    (void)b, (void)mask;
+    return 0;
+#endif
+}
+
+// Spreads the low bits of index over the set bits of mask (PDEP)
+inline uint64_t depositGeneric(uint64_t index, uint64_t mask) {
+    uint64_t result = 0;
+    for (uint64_t bit = 1; mask; mask &= mask - 1, bit <<= 1) {
+        if (index & bit) result |= mask & -mask;
+    }
+    return result;
+}
+
+#if defined(LANCER_X86_64)
+// Four popcounts at a time: a nibble lookup with vpshufb, then vpsadbw adds
+// the bytes of each 64-bit lane. The weights are multiplied in per lane.
+LANCER_TARGET_AVX2 inline int weightedPopcountAvx2(const uint64_t* sets, const int32_t* weights, int count) {
+    const __m256i nibbleCounts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+    __m256i sum = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i bits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sets + i));
+        __m256i low = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(bits, lowNibbles));
+        __m256i high = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi16(bits, 4), lowNibbles));
+        __m256i counts = _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+        __m256i weight = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i)));
+        sum = _mm256_add_epi64(sum, _mm256_mul_epi32(counts, weight));
+    }
+    __m128i pairs = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    int64_t total = _mm_cvtsi128_si64(pairs) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(pairs, pairs));
+    for (; i < count; i++) {
+        total += weights[i] * popcount(sets[i]);
+    }
+    return static_cast<int>(total);
+}
+#endif
+
+// Sum of weights[i] * popcount(sets[i])
+inline int weightedPopcount(const uint64_t* sets, const int32_t* weights, int count) {
+#if defined(LANCER_X86_64)
+    if (hasAvx2()) return weightedPopcountAvx2(sets, weights, count);
+#endif
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        total += weights[i] * popcount(sets[i]);
+    }
+    return total;
+}
+
+}  // namespace Cpu
@@ -0,0 +1,281 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Memory mapping of a whole file, read-only unless opened with openWritable
+// or createWritable.
+// The OS pages data in on demand and shares the pages between processes, so
+// large tables cost nothing until used.
+class MappedFile {
+private:
+    const uint8_t* m_data{nullptr};
+    size_t m_size{0};
+    bool m_writable{false};
+    std::string m_tempPath;  // of a created file until it is published
+#if defined(_WIN32)
+    HANDLE m_file{INVALID_HANDLE_VALUE};
+    HANDLE m_mapping{nullptr};
+#endif
+
+#if defined(_WIN32)
+    bool mapWritable(size_t size) {
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        if (m_mapping) {
+            m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, 0));
+        }
+#else
+    bool mapWritable(int fd, size_t size) {
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);  // the mapping keeps the file alive
+        if (data != MAP_FAILED) {
+            m_data = static_cast<const uint8_t*>(data);
+        }
+#endif
+        if (!m_data) {
+            close();
+            return false;
+        }
+        m_size = size;
+        m_writable = true;
+        return true;
+    }
+
+    void discardTemporary() {
+        if (m_tempPath.empty()) {
+            return;
+        }
+#if defined(_WIN32)
+        DeleteFileA(m_tempPath.c_str());  // once the last handle is closed
+#else
+        unlink(m_tempPath.c_str());
+#endif
+        m_tempPath.clear();
+    }
+
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path) {
+        open(path);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_writable = other.m_writable;
+            m_tempPath = std::move(other.m_tempPath);
+            other.m_tempPath.clear();
+            other.m_data = nullptr;
+            other.m_size = 0;
+            other.m_writable = false;
+#if defined(_WIN32)
+            m_file = other.m_file;
+            m_mapping = other.m_mapping;
+            other.m_file = INVALID_HANDLE_VALUE;
+            other.m_mapping = nullptr;
+#endif
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    // Returns false if the file is missing or empty, a missing table is not an error
+    bool open(const std::string& path) {
+        close();
+#if defined(_WIN32)
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) {
+            close();
+            return false;
+        }
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        m_size = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);  // the mapping keeps the file alive
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = static_cast<size_t>(info.st_size);
+#endif
+        if (!m_data) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // Maps an existing file read-write at the size it has. Writes land in
+    // the shared pages, so every process mapping the file sees them and the
+    // OS writes them back. The file is never resized here: another process
+    // may have it mapped, and pages cut off under it kill it with SIGBUS.
+    bool openWritable(const std::string& path) {
+        close();
+#if defined(_WIN32)
+        m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        return mapWritable(static_cast<size_t>(size.QuadPart));
+#else
+        int fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        return mapWritable(fd, static_cast<size_t>(info.st_size));
+#endif
+    }
+
+    // Creates a zero-filled file of `size` bytes next to path under a
+    // temporary name and maps it read-write. Fill it in, then publish() it
+    // as path, so nobody ever maps a file that is only half set up.
+    bool createWritable(const std::string& path, size_t size) {
+        close();
+        if (size == 0) {
+            return false;
+        }
+#if defined(_WIN32)
+        m_tempPath = path + ".tmp" + std::to_string(GetCurrentProcessId()) + "." +
+                     std::to_string(GetCurrentThreadId());
+        m_file = CreateFileA(m_tempPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, CREATE_NEW,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            m_tempPath.clear();
+            return false;
+        }
+        LARGE_INTEGER wanted;
+        wanted.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(m_file, wanted, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file) ||
+            !mapWritable(size)) {
+            discardTemporary();
+            return false;
+        }
+#else
+        std::string name = path + ".XXXXXX";
+        int fd = mkstemp(name.data());
+        if (fd < 0) {
+            return false;
+        }
+        m_tempPath = name;
+        fchmod(fd, 0644);
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            discardTemporary();
+            return false;
+        }
+        if (!mapWritable(fd, size)) {
+            discardTemporary();
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    // Gives the file made by createWritable its real name. Fails, and keeps
+    // the existing file, when another process got there first; the mapping
+    // stays valid either way until close().
+    bool publish(const std::string& path) {
+        if (m_tempPath.empty()) {
+            return false;
+        }
+#if defined(_WIN32)
+        bool published = MoveFileExA(m_tempPath.c_str(), path.c_str(), 0) != 0;
+        if (published) {
+            m_tempPath.clear();
+        } else {
+            discardTemporary();
+        }
+#else
+        // link() unlike rename() does not replace an existing file
+        bool published = link(m_tempPath.c_str(), path.c_str()) == 0;
+        discardTemporary();
+#endif
+        return published;
+    }
+
+    void close() {
+        discardTemporary();
+#if defined(_WIN32)
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_writable = false;
+    }
+
+    // Tells the OS we read front to back, so it reads ahead further
+    void adviseSequential() const {
+#if !defined(_WIN32)
+        if (m_data) madvise(const_cast<uint8_t*>(m_data), m_size, MADV_SEQUENTIAL);
+#endif
+    }
+
+    bool isOpen() const { return m_data != nullptr; }
+    const uint8_t* data() const { return m_data; }
+    uint8_t* writableData() const { return m_writable ? const_cast<uint8_t*>(m_data) : nullptr; }
+    size_t size() const { return m_size; }
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include "../engine/board.hpp"
+#include "../engine/movegen.hpp"
+
+// Zobrist hashing: every (piece, square) pair and the side to move get a
+// random 64 bit key, a position's hash is the XOR of the keys that apply.
+// The keys are generated at compile time from a fixed seed so a hash means the
+// same thing in every build and every process.
+struct ZobristKeys {
+    uint64_t pieces[12][64];
+    uint64_t whiteToMove;
+};
+
+// SplitMix64, small and good enough for hashing keys
+constexpr uint64_t zobristNextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys generateZobristKeys() {
+    ZobristKeys keys{};
+    uint64_t state = 0x4C616E636572ULL;  // "Lancer"
+    for (int piece = 0; piece < 12; piece++) {
+        for (int square = 0; square < 64; square++) {
+            keys.pieces[piece][square] = zobristNextRandom(state);
+        }
+    }
+    keys.whiteToMove = zobristNextRandom(state);
+    return keys;
+}
+
+class Zobrist {
+private:
+    static constexpr ZobristKeys keys = generateZobristKeys();
+
+public:
+    static constexpr uint64_t piece(int piece, int square) {
+        return keys.pieces[piece][square];
+    }
+
+    static constexpr uint64_t sideToMove() {
+        return keys.whiteToMove;
+    }
+
+    // Full hash from scratch, the search keeps it up to date incrementally
+    static uint64_t hash(const ChessBoard& board, bool isWhite) {
+        uint64_t key = isWhite ? keys.whiteToMove : 0ULL;
+        for (int piece = 0; piece < 12; piece++) {
+            uint64_t bitboard = board[piece];
+            while (bitboard) {
+                key ^= keys.pieces[piece][getLSB(bitboard)];
+                bitboard &= bitboard - 1;
+            }
+        }
+        return key;
+    }
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+// Bare-bones checks for the test programs under tests/, run by ctest: a
+// failed CHECK prints where and the test exits with 1 at the end.
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            checkFailures()++;                                                            \
+        }                                                                                 \
+    } while (false)
+
+inline int checkResult() {
+    if (checkFailures()) {
+        std::fprintf(stderr, "%d checks failed\n", checkFailures());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <cstdio>
+#include "check.hpp"
+#include "../src/engine/bitbase.hpp"
+#include "../src/engine/board.hpp"
+#include "../src/engine/movegen.hpp"
+#include "../src/engine/search.hpp"
+#include "../src/eval/evaluation.hpp"
+
+// The search is pseudo-legal, so leaves where the side not to move is in
+// check are common. The bitbase has no value for those; they used to be
+// evaluated instead, and the score of a won KPK swung between a bitbase win
+// at odd depths and a pawn up at even ones.
+
+int main() {
+    Bitbases bitbases("database/bitbases");
+    if (!bitbases.has("KPK")) {
+        std::fprintf(stderr, "no KPK bitbase in database/bitbases, build the bitbases target first\n");
+        return 1;
+    }
+
+    ChessBoard board(12, 0);
+    MoveGen moveGen(board);
+    Evaluation evaluator(board, moveGen);
+    MinimaxSearch search(board, moveGen, evaluator);
+    search.setBitbases(&bitbases);
+
+    for (int depth = 1; depth <= 6; depth++) {
+        setPositionFromFEN(board, "3k4/8/4PK2/8/8/8/8/8 w - - 1 5");
+        search.clearHash();
+        SearchLimits limits;
+        limits.depth = depth;
+        search.search(true, limits);
+        double score = search.multiPVLines().at(0).score;
+        std::printf("depth %d: %.2f\n", depth, score);
+        // A bitbase win, and not a mate score from a king capture
+        CHECK(score >= MinimaxSearch::TB_WIN && score < MinimaxSearch::MATE_BOUND);
+    }
+    return checkResult();
+}
@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include "check.hpp"
+#include "../src/engine/transposition.hpp"
+
+// Two tables on one hash file, the second with another Hash size: it must
+// not attach, and above all not resize the file under the first one (whose
+// next access would then die with SIGBUS).
+
+static size_t fileSize(const std::string& path) {
+    std::error_code error;
+    size_t size = std::filesystem::file_size(path, error);
+    return error ? 0 : size;
+}
+
+int main() {
+    std::string path = "test_hash_file.tt";
+    std::remove(path.c_str());
+
+    TranspositionTable first(1);
+    CHECK(first.attachFile(path, 1));
+    CHECK(first.isPersistent());
+    size_t size = fileSize(path);
+    CHECK(size > 0);
+
+    uint64_t key = 0x123456789ABCDEFULL;
+    first.newSearch();
+    first.store(key, 7, 0.5, Bound::Exact, Move(12, 28));
+
+    // Smaller and larger than the file
+    for (size_t megabytes : {size_t(2), size_t(4)}) {
+        TranspositionTable second(1);
+        const char* error = nullptr;
+        CHECK(!second.attachFile(path, megabytes, &error));
+        CHECK(error != nullptr);
+        CHECK(!second.isPersistent());
+        CHECK(fileSize(path) == size);
+        // Still a working table, in memory
+        second.store(key, 3, 0.25, Bound::Exact, Move(12, 28));
+        TTEntry entry;
+        CHECK(second.probe(key, entry) && entry.depth == 3);
+    }
+
+    // Resizing an attached table must not touch the file either
+    TranspositionTable third(1);
+    CHECK(third.attachFile(path, 1));
+    CHECK(!third.resize(2));
+    CHECK(!third.isPersistent());
+    CHECK(fileSize(path) == size);
+
+    // The first mapping is intact and still shared with a same-size table
+    TTEntry entry;
+    CHECK(first.probe(key, entry) && entry.depth == 7);
+    TranspositionTable fourth(1);
+    CHECK(fourth.attachFile(path, 1));
+    CHECK(fourth.probe(key, entry) && entry.depth == 7);
+
+    // A file with a broken header is left as it is, not wiped
+    first.detachFile();
+    fourth.detachFile();
+    if (FILE* file = std::fopen(path.c_str(), "r+b")) {
+        std::fputc('X', file);
+        std::fclose(file);
+    }
+    TranspositionTable fifth(1);
+    CHECK(!fifth.attachFile(path, 1));
+    CHECK(fileSize(path) == size);
+
+    std::remove(path.c_str());
+    return checkResult();
+}
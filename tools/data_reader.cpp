@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "../src/engine/board.hpp"
+#include "../src/engine/datagen.hpp"
+
+// Reads training data written by "Lancer-bot datagen": counts the records
+// and their results, and prints the first few as FEN, score, move and result.
+//
+//   data_reader data.bin [--limit N]
+//
+// It goes through the whole file record by record the way a trainer would,
+// so it doubles as a check that the file is complete and unpacks cleanly.
+
+namespace {
+
+const char* resultName(DataResult result) {
+    switch (result) {
+        case DataResult::WhiteWins: return "1-0";
+        case DataResult::BlackWins: return "0-1";
+        default: return "1/2-1/2";
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: data_reader data.bin [--limit N]\n";
+        return 1;
+    }
+    size_t limit = 10;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--limit") limit = std::stoull(value);
+    }
+
+    DataReader reader;
+    if (!reader.open(argv[1])) {
+        std::cerr << argv[1] << " is not a training data file\n";
+        return 1;
+    }
+
+    ChessBoard board(12, 0);
+    uint64_t results[3] = {};
+    uint64_t broken = 0, printed = 0;
+    double scoreSum = 0.0;
+    while (const PackedPosition* record = reader.next()) {
+        record->unpack(board);
+        if (!board[WK] || !board[BK] || static_cast<int>(record->result()) > 2) {
+            broken++;
+            continue;
+        }
+        results[static_cast<int>(record->result())]++;
+        scoreSum += record->score;
+        if (printed++ < limit) {
+            FenState state;
+            state.whiteToMove = record->whiteToMove();
+            state.castling = castlingFromPlacement(board);
+            state.halfmoveClock = record->halfmoveClock;
+            state.fullmoveNumber = record->ply / 2 + 1;
+            char text[MAX_FEN_LENGTH + 64];
+            std::snprintf(text, sizeof(text), "%-72s %+6d  %-5s  %s", boardToFen(board, state).c_str(),
+                          record->score, moveToString(Move::fromRaw(record->move)).c_str(),
+                          resultName(record->result()));
+            std::cout << text << "\n";
+        }
+    }
+
+    uint64_t total = results[0] + results[1] + results[2];
+    std::printf("\n%zu records, %llu broken\n", reader.size(), static_cast<unsigned long long>(broken));
+    if (total) {
+        std::printf("White won %.1f%%, drawn %.1f%%, black won %.1f%%, mean score %+.0f cp\n",
+                    100.0 * results[static_cast<int>(DataResult::WhiteWins)] / total,
+                    100.0 * results[static_cast<int>(DataResult::Draw)] / total,
+                    100.0 * results[static_cast<int>(DataResult::BlackWins)] / total, scoreSum / total);
+    }
+    return broken ? 1 : 0;
+}
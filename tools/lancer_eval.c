@@ -0,0 +1,52 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lancer.h"
+
+/*
+ * Scores the FENs on stdin through liblancer, one line each, a batch at a
+ * time. Mostly there to show the C API and to keep lancer.h plain C.
+ *
+ *   lancer_eval [depth] < positions.fen    depth 0 = static evaluation
+ */
+
+#define BATCH 256
+#define LINE 256
+
+int main(int argc, char* argv[]) {
+    int depth = argc > 1 ? atoi(argv[1]) : 0;
+    lancer_limits limits = {depth, 0, 0};
+    lancer_engine* engine = lancer_create(16);
+    if (!engine) {
+        fprintf(stderr, "Cannot create an engine\n");
+        return 1;
+    }
+
+    static char lines[BATCH][LINE];
+    const char* fens[BATCH];
+    double scores[BATCH];
+    size_t count = 0, total = 0, scored = 0;
+    int done = 0;
+    while (!done) {
+        done = fgets(lines[count], LINE, stdin) == NULL;
+        if (!done) {
+            lines[count][strcspn(lines[count], "\r\n")] = '\0';
+            if (lines[count][0] == '\0') continue;
+            fens[count] = lines[count];
+            count++;
+        }
+        if (count == BATCH || (done && count > 0)) {
+            scored += lancer_evaluate_batch(engine, fens, count, depth > 0 ? &limits : NULL, scores);
+            for (size_t i = 0; i < count; i++) {
+                if (isnan(scores[i])) printf("%s | error\n", fens[i]);
+                else printf("%s | %+.2f\n", fens[i], scores[i]);
+            }
+            total += count;
+            count = 0;
+        }
+    }
+    fprintf(stderr, "%zu of %zu positions scored\n", scored, total);
+    lancer_destroy(engine);
+    return 0;
+}
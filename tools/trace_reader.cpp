@@ -0,0 +1,132 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../src/engine/search_trace.hpp"
+
+// Reads a search tree trace ("Lancer-bot trace", UCI "dumptrace") and prints
+// the nodes that match the filters, then what the search made of each root
+// move in the last iteration.
+//
+//   trace_reader search.trace [--ply N] [--max-ply N] [--move e2e4]
+//                [--root b7b5] [--kind cutoff] [--iteration N] [--limit N]
+//
+// --move matches the move into the node, --root the first move of its line.
+
+namespace {
+
+struct Filter {
+    int ply{-1};
+    int maxPly{-1};
+    int iteration{-1};
+    std::string move;
+    std::string rootMove;
+    std::string kind;
+    size_t limit{200};
+
+    bool matches(const TraceEvent& event) const {
+        return (ply < 0 || event.ply == ply) && (maxPly < 0 || event.ply <= maxPly) &&
+               (iteration < 0 || event.iteration == iteration) &&
+               (move.empty() || (event.ply > 0 && moveToString(Move::fromRaw(event.move)) == move)) &&
+               (rootMove.empty() || (event.ply > 0 && moveToString(Move::fromRaw(event.rootMove)) == rootMove)) &&
+               (kind.empty() || kind == traceKindName(event.kind));
+    }
+};
+
+std::string formatScore(float score) {
+    if (std::isinf(score)) {
+        return score > 0 ? "+inf" : "-inf";
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%+.2f", score);
+    return text;
+}
+
+void printEvent(const TraceEvent& event) {
+    std::string line = event.ply == 0 ? "(root)" : moveToString(Move::fromRaw(event.rootMove));
+    if (event.ply > 1) {
+        line += (event.ply > 2 ? " .. " : " ") + moveToString(Move::fromRaw(event.move));
+    }
+    char text[160];
+    std::snprintf(text, sizeof(text), "it %2d ply %2d depth %2d  %-18s [%s, %s] %7s  %-12s key %08x",
+                  event.iteration, event.ply, event.depth, line.c_str(), formatScore(event.alpha).c_str(),
+                  formatScore(event.beta).c_str(), formatScore(event.score).c_str(), traceKindName(event.kind),
+                  event.key);
+    std::cout << text << "\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: trace_reader file.trace [--ply N] [--max-ply N] [--move e2e4] [--root b7b5]"
+                     " [--kind cutoff] [--iteration N] [--limit N]\n";
+        return 1;
+    }
+    Filter filter;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "--ply") filter.ply = std::stoi(value);
+        else if (flag == "--max-ply") filter.maxPly = std::stoi(value);
+        else if (flag == "--iteration") filter.iteration = std::stoi(value);
+        else if (flag == "--move") filter.move = value;
+        else if (flag == "--root") filter.rootMove = value;
+        else if (flag == "--kind") filter.kind = value;
+        else if (flag == "--limit") filter.limit = std::stoull(value);
+    }
+
+    TraceFileHeader header;
+    std::vector<TraceEvent> events;
+    if (!SearchTracer::load(argv[1], header, events)) {
+        std::cerr << argv[1] << " is not a search trace\n";
+        return 1;
+    }
+    std::cout << "Root " << header.fen << "\n"
+              << events.size() << " nodes" << (header.dropped ? ", " + std::to_string(header.dropped) +
+                                                                      " older ones overwritten"
+                                                              : "")
+              << "\n\n";
+
+    size_t matched = 0;
+    std::map<std::string, size_t> kinds;
+    for (const TraceEvent& event : events) {
+        if (!filter.matches(event)) continue;
+        if (matched++ < filter.limit) {
+            printEvent(event);
+        }
+        kinds[traceKindName(event.kind)]++;
+    }
+    if (matched > filter.limit) {
+        std::cout << "... " << matched - filter.limit << " more (--limit)\n";
+    }
+    std::cout << "\n" << matched << " matching nodes:";
+    for (const auto& [kind, count] : kinds) {
+        std::cout << " " << kind << " " << count;
+    }
+    std::cout << "\n";
+
+    // Root moves of the last iteration, in the order they were searched,
+    // with the size of their subtree
+    if (events.empty()) {
+        return 0;
+    }
+    int lastIteration = events.back().iteration;
+    std::map<uint16_t, size_t> subtree;
+    for (const TraceEvent& event : events) {
+        if (event.iteration == lastIteration && event.ply > 0) subtree[event.rootMove]++;
+    }
+    std::cout << "\nRoot moves, iteration " << lastIteration << ":\n";
+    for (const TraceEvent& event : events) {
+        if (event.iteration != lastIteration || event.ply != 1) continue;
+        char text[128];
+        std::snprintf(text, sizeof(text), "  %-6s [%s, %s] %7s  %-12s %zu nodes",
+                      moveToString(Move::fromRaw(event.move)).c_str(), formatScore(event.alpha).c_str(),
+                      formatScore(event.beta).c_str(), formatScore(event.score).c_str(),
+                      traceKindName(event.kind), subtree[event.move]);
+        std::cout << text << "\n";
+    }
+    return 0;
+}